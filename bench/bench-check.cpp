@@ -0,0 +1,63 @@
+// Measures the cost of CHECK on the success path in tight loops. The policy
+// is only consulted on the failure path, so the checked and unchecked loops
+// should run at the same speed.
+
+#include <numeric>
+#include <vector>
+
+#include "ul/bench.h"
+#include "ul/check.h"
+
+namespace bench = ul::bench;
+
+const int c_size = 1 << 16;
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    options.parse_args(argc, argv);
+    bench::Runner runner(options);
+
+    std::vector<int> v(c_size);
+    std::iota(v.begin(), v.end(), 0);
+    std::vector<int> idx(c_size);
+    for (int i = 0; i < c_size; ++i)
+        idx[i] = (i * 7919) % c_size;
+
+    const int n = static_cast<int>(v.size());
+
+    runner.run(
+        "gather, unchecked",
+        [&]() {
+            int64_t s = 0;
+            for (int i = 0; i < c_size; ++i)
+                s += v[idx[i]];
+            bench::do_not_optimize(s);
+        },
+        c_size);
+    runner.run(
+        "gather, CHECK",
+        [&]() {
+            int64_t s = 0;
+            for (int i = 0; i < c_size; ++i) {
+                const int j = idx[i];
+                CHECK(0 <= j && j < n);
+                s += v[j];
+            }
+            bench::do_not_optimize(s);
+        },
+        c_size);
+    runner.run(
+        "gather, CHECK with message",
+        [&]() {
+            int64_t s = 0;
+            for (int i = 0; i < c_size; ++i) {
+                const int j = idx[i];
+                CHECK(0 <= j && j < n, "index %d out of range [0, %d)", j, n);
+                s += v[j];
+            }
+            bench::do_not_optimize(s);
+        },
+        c_size);
+    return runner.finish();
+}
@@ -0,0 +1,32 @@
+// Overhead of a single `now()` call for each clock usable with Stopwatch.
+
+#include "ul/bench.h"
+#include "ul/clock.h"
+
+namespace bench = ul::bench;
+
+template <class Clock>
+void bench_clock(bench::Runner& runner, const char* name)
+{
+    runner.run(name, []() {
+        auto t = Clock::now().time_since_epoch().count();
+        bench::do_not_optimize(t);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    options.parse_args(argc, argv);
+    bench::Runner runner(options);
+
+    ul::tsc_clock::calibrate();
+    bench_clock<std::chrono::high_resolution_clock>(runner,
+                                                    "high_resolution_clock");
+    bench_clock<std::chrono::steady_clock>(runner, "steady_clock");
+    bench_clock<ul::tsc_clock>(runner, "ul::tsc_clock");
+    bench_clock<ul::tsc_clock_fenced>(runner, "ul::tsc_clock_fenced");
+    bench_clock<ul::thread_cpu_clock>(runner, "ul::thread_cpu_clock");
+    bench_clock<ul::process_cpu_clock>(runner, "ul::process_cpu_clock");
+    return runner.finish();
+}
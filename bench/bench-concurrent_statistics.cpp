@@ -0,0 +1,64 @@
+// Contention: total throughput of `add` from 1 to 64 threads adding to one
+// shared accumulator. ns/item is per add across all threads, so a
+// scalable accumulator keeps items/s growing with the thread count (up to
+// the number of cores).
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ul/bench.h"
+#include "ul/concurrent_statistics.h"
+#include "ul/metrics.h"
+
+namespace bench = ul::bench;
+
+const int c_adds_per_thread = 1 << 16;
+
+// Each call starts `threads` threads which add c_adds_per_thread values.
+template <class Add>
+void bench_threads(bench::Runner& runner,
+                   const std::string& name,
+                   int threads,
+                   Add add)
+{
+    runner.run(
+        name + " threads=" + std::to_string(threads),
+        [&]() {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&add, t]() {
+                    for (int i = 0; i < c_adds_per_thread; ++i)
+                        add(double(t + i));
+                });
+            }
+            for (auto& w : workers)
+                w.join();
+        },
+        int64_t(threads) * c_adds_per_thread);
+}
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    options.parse_args(argc, argv);
+    bench::Runner runner(options);
+
+    ul::ConcurrentStatistics concurrent;
+    std::mutex mutex;
+    ul::Statistics locked;
+    ul::metrics::Timer timer;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        bench_threads(runner, "ConcurrentStatistics", threads,
+                      [&](double x) { concurrent.add(x); });
+        bench_threads(runner, "mutex Statistics", threads, [&](double x) {
+            std::lock_guard<std::mutex> lock(mutex);
+            locked.add(x);
+        });
+        bench_threads(runner, "metrics::Timer", threads,
+                      [&](double x) { timer.record(x); });
+    }
+    bench::do_not_optimize(concurrent.snapshot().count());
+    bench::do_not_optimize(locked.count());
+    return runner.finish();
+}
@@ -0,0 +1,46 @@
+// Overhead of a UL_PROFILE_ZONE, compiled with UL_PROFILE.
+
+#include <cstdio>
+
+#include "ul/profiler.h"
+#include "ul/stopwatch.h"
+
+using ul::Stopwatch;
+
+const int c_iterations = 1000000;
+const int c_repetitions = 10;
+
+volatile int g_sink;
+
+int main()
+{
+    ul::tsc_clock::calibrate();
+    double best_empty = 1e300, best_zone = 1e300, best_nested = 1e300;
+    for (int r = 0; r < c_repetitions; ++r) {
+        Stopwatch<std::chrono::steady_clock> sw(true);
+        for (int i = 0; i < c_iterations; ++i)
+            g_sink = i;
+        best_empty = std::min(best_empty, sw.restart());
+        for (int i = 0; i < c_iterations; ++i) {
+            UL_PROFILE_ZONE("zone");
+            g_sink = i;
+        }
+        best_zone = std::min(best_zone, sw.restart());
+        for (int i = 0; i < c_iterations; ++i) {
+            UL_PROFILE_ZONE("outer");
+            {
+                UL_PROFILE_ZONE("inner");
+                g_sink = i;
+            }
+        }
+        best_nested = std::min(best_nested, sw.stop());
+    }
+    printf("%-28s %8.2f ns/iteration\n", "empty loop",
+           best_empty * 1e9 / c_iterations);
+    printf("%-28s %8.2f ns/zone\n", "single zone",
+           (best_zone - best_empty) * 1e9 / c_iterations);
+    printf("%-28s %8.2f ns/zone\n", "nested zones",
+           (best_nested - best_empty) * 1e9 / c_iterations / 2);
+    ul::Profiler::print_report();
+    return 0;
+}
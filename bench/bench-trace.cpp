@@ -0,0 +1,64 @@
+// Cost of recording a trace event, compiled with UL_PROFILE.
+
+#include <cstdio>
+
+#include "ul/profiler.h"
+#include "ul/stopwatch.h"
+#include "ul/trace.h"
+
+using ul::Stopwatch;
+
+const int c_iterations = 1000000;
+const int c_repetitions = 10;
+
+volatile int g_sink;
+
+double best_time(void (*f)())
+{
+    double best = 1e300;
+    for (int r = 0; r < c_repetitions; ++r) {
+        ul::trace::start(2 * c_iterations);
+        Stopwatch<std::chrono::steady_clock> sw(true);
+        f();
+        best = std::min(best, sw.stop());
+        ul::trace::stop();
+    }
+    return best;
+}
+
+int main()
+{
+    ul::tsc_clock::calibrate();
+    const double empty = best_time([]() {
+        for (int i = 0; i < c_iterations; ++i)
+            g_sink = i;
+    });
+    const double scope = best_time([]() {
+        for (int i = 0; i < c_iterations; ++i) {
+            UL_TRACE_SCOPE("scope");
+            g_sink = i;
+        }
+    });
+    const double zone = best_time([]() {
+        for (int i = 0; i < c_iterations; ++i) {
+            UL_PROFILE_ZONE("zone");
+            g_sink = i;
+        }
+    });
+    ul::trace::stop();
+    Stopwatch<std::chrono::steady_clock> sw(true);
+    for (int i = 0; i < c_iterations; ++i) {
+        UL_TRACE_SCOPE("scope");
+        g_sink = i;
+    }
+    const double disabled = sw.stop();
+
+    printf("%-32s %8.2f ns/event\n", "UL_TRACE_SCOPE",
+           (scope - empty) * 1e9 / c_iterations / 2);
+    printf("%-32s %8.2f ns/zone\n", "UL_PROFILE_ZONE while tracing",
+           (zone - empty) * 1e9 / c_iterations);
+    printf("%-32s %8.2f ns/scope\n", "UL_TRACE_SCOPE, tracing off",
+           (disabled - empty) * 1e9 / c_iterations);
+    printf("dropped: %lld\n", (long long)ul::trace::dropped_count());
+    return 0;
+}
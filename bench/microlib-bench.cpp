@@ -0,0 +1,690 @@
+// Benchmark suite for the hot paths of microlib.
+//
+// Usage:
+//
+//     microlib-bench [--sizes=16,1024,65536] [--filter=conv] [--json=new.json]
+//                    [--baseline=old.json] [--threshold=0.05]
+//                    [--min-time=0.02] [--repetitions=10] [--perf]
+//
+// Save a run with --json= and pass it to a later run as --baseline= to list
+// regressions and improvements. The exit code is 1 if there was a regression.
+// --perf adds IPC and misses per item from hardware counters (Linux).
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ul/alg_scalar_eq_fun.h"
+#include "ul/bench.h"
+#include "ul/clock.h"
+#include "ul/container_math.h"
+#include "ul/ewma.h"
+#include "ul/inlinevector.h"
+#include "ul/math.h"
+#include "ul/math_special.h"
+#include "ul/metrics.h"
+#include "ul/percentiles.h"
+#include "ul/ml.h"
+#include "ul/quantile_sketch.h"
+#include "ul/statistics_n.h"
+#include "ul/string.h"
+#include "ul/stringf.h"
+#include "ul/to_string.h"
+#include "ul/windowed_statistics.h"
+
+namespace bench = ul::bench;
+using bench::do_not_optimize;
+using ul::stringf;
+using std::string;
+using std::vector;
+
+namespace {
+
+vector<double> random_doubles(int n, double lower = -1, double upper = 1)
+{
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<double> dist(lower, upper);
+    vector<double> v(n);
+    for (auto& x : v)
+        x = dist(rng);
+    return v;
+}
+
+void bench_string(bench::Runner& runner, int n)
+{
+    // n characters, the first half is the prefix.
+    const string s(n, 'a');
+    const string prefix(n / 2, 'a');
+    runner.run(
+        stringf("startswith n=%d", n),
+        [&]() { do_not_optimize(ul::startswith(s, prefix)); }, n / 2);
+
+    string padded = string(n / 4, ' ') + string(n / 2, 'x') +
+                    string(n - n / 4 - n / 2, ' ');
+    runner.run(
+        stringf("trim n=%d", n),
+        [&]() { do_not_optimize(ul::trim(ul::as_span(padded))); }, n);
+
+    // Words of 7 characters separated by a space or a comma.
+    string words;
+    for (int i = 0; i < n; ++i)
+        words += i % 8 == 7 ? (i % 16 == 15 ? ',' : ' ') : 'w';
+    vector<ul::span<const char>> parts;
+    runner.run(
+        stringf("split n=%d", n),
+        [&]() {
+            parts.clear();
+            ul::split(ul::as_span(words), " ,", parts);
+            do_not_optimize(parts.data());
+        },
+        n, n);
+}
+
+void bench_stringf_fixed(bench::Runner& runner)
+{
+    runner.run("stringf %d %s %.3f", []() {
+        do_not_optimize(stringf("%d %s %.3f", 12345, "abc", 3.14159));
+    });
+}
+
+void bench_stringf(bench::Runner& runner, int n)
+{
+    const string s(n, 'x');
+    runner.run(
+        stringf("stringf %%s n=%d", n),
+        [&]() { do_not_optimize(stringf("<%s>", s.c_str())); }, n, n);
+}
+
+void bench_to_string(bench::Runner& runner, int n)
+{
+    vector<int> v(n);
+    for (int i = 0; i < n; ++i)
+        v[i] = i * 37;
+    runner.run(
+        stringf("to_string vector<int> n=%d", n),
+        [&]() { do_not_optimize(ul::to_string(v)); }, n);
+}
+
+template <int N>
+void bench_inlinevector(bench::Runner& runner)
+{
+    runner.run(
+        stringf("InlineVector<double,%d> push_back", N),
+        []() {
+            ul::InlineVector<double, N> v;
+            for (int i = 0; i < N; ++i)
+                v.push_back(i);
+            do_not_optimize(v);
+        },
+        N);
+    ul::InlineVector<double, N> src;
+    for (int i = 0; i < N; ++i)
+        src.push_back(i);
+    runner.run(
+        stringf("InlineVector<double,%d> copy", N),
+        [&]() {
+            auto v = src;
+            do_not_optimize(v);
+        },
+        N, N * sizeof(double));
+}
+
+void bench_conv(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n);
+    for (int k : {4, 32}) {
+        const auto y = random_doubles(k);
+        runner.run(
+            stringf("conv vector n=%d k=%d", n, k),
+            [&]() { do_not_optimize(ul::conv(x, y)); }, int64_t(n) * k);
+    }
+    vector<double> result;
+    const auto y = random_doubles(32);
+    runner.run(
+        stringf("conv_into vector n=%d k=32", n),
+        [&]() {
+            ul::conv_into(x, y, result);
+            do_not_optimize(result.data());
+            bench::clobber_memory();
+        },
+        int64_t(n) * 32);
+    // The SIMD kernel of conv_direct against the generic loop
+    for (int k : {3, 8, 16, 64}) {
+        const auto yk = random_doubles(k);
+        vector<double> r(size_t(n + k - 1));
+        runner.run(
+            stringf("conv_into_nocheck vector n=%d k=%d", n, k),
+            [&]() {
+                std::fill(r.begin(), r.end(), 0.0);
+                ul::conv_into_nocheck(x, yk, r);
+                do_not_optimize(r.data());
+                bench::clobber_memory();
+            },
+            n);
+        const vector<float> xf(x.begin(), x.end()), ykf(yk.begin(), yk.end());
+        runner.run(
+            stringf("conv_direct float n=%d k=%d", n, k),
+            [&]() { do_not_optimize(ul::conv_direct(xf, ykf)); }, n);
+        runner.run(
+            stringf("conv_direct same n=%d k=%d", n, k),
+            [&]() {
+                do_not_optimize(ul::conv_direct(x, yk, ul::ConvShape::same));
+            },
+            n);
+    }
+    // Crossover of conv_direct and conv_fft, see detail::c_conv_fft_min_size.
+    for (int k : {8, 16, 32, 64, 128, 256, 512, 1024}) {
+        if (k > n)
+            break;
+        const auto yk = random_doubles(k);
+        runner.run(
+            stringf("conv_direct vector n=%d k=%d", n, k),
+            [&]() { do_not_optimize(ul::conv_direct(x, yk)); }, n);
+        runner.run(
+            stringf("conv_fft vector n=%d k=%d", n, k),
+            [&]() { do_not_optimize(ul::conv_fft(x, yk)); }, n);
+    }
+}
+
+void bench_conv_array(bench::Runner& runner)
+{
+    std::array<double, 4> x = {1, 2, 3, 4};
+    std::array<double, 3> y = {0.5, -1, 2};
+    runner.run("conv array<4> array<3>", [&]() {
+        do_not_optimize(x);
+        do_not_optimize(ul::conv(x, y));
+    });
+}
+
+void bench_polyval(bench::Runner& runner, int n)
+{
+    const auto xs = random_doubles(n);
+    const vector<float> xs_float(xs.begin(), xs.end());
+    vector<double> out(xs.size());
+    vector<float> out_float(xs.size());
+    for (int degree : {3, 8, 16, 32}) {
+        const auto p = random_doubles(degree + 1);
+        runner.run(
+            stringf("polyval deg=%d n=%d", degree, n),
+            [&]() {
+                double s = 0;
+                for (double x : xs)
+                    s += ul::polyval(p, x);
+                do_not_optimize(s);
+            },
+            n);
+        runner.run(
+            stringf("polyval batch deg=%d n=%d", degree, n),
+            [&]() {
+                ul::polyval(p, ul::as_span(xs),
+                            ul::make_span(out.data(), out.size()));
+                do_not_optimize(out.data());
+                bench::clobber_memory();
+            },
+            n);
+        runner.run(
+            stringf("polyval batch float deg=%d n=%d", degree, n),
+            [&]() {
+                ul::polyval(p, ul::as_span(xs_float),
+                            ul::make_span(out_float.data(), out_float.size()));
+                do_not_optimize(out_float.data());
+                bench::clobber_memory();
+            },
+            n);
+    }
+}
+
+// Cubic fits to windows of 32 values of a series of n values.
+void bench_polyfit(bench::Runner& runner, int n)
+{
+    const int c_window = 32;
+    if (n < c_window)
+        return;
+    const auto x = random_doubles(c_window);
+    const auto y = random_doubles(n);
+    const vector<float> y_float(y.begin(), y.end());
+    const ul::Polyfit<3> fit(x);
+    const ul::Polyfit<3, float> fit_float(x);
+    const size_t sliding = size_t(n - c_window + 1);
+    vector<std::array<double, 4>> out(sliding);
+    vector<std::array<float, 4>> out_float(sliding);
+    runner.run(stringf("polyfit<3> n=%d", c_window), [&]() {
+        do_not_optimize(ul::polyfit<3>(x, ul::make_span(y.data(), c_window)));
+    });
+    runner.run(
+        stringf("polyfit<3> fit per window n=%d", n),
+        [&]() {
+            for (size_t w = 0; w < sliding; ++w)
+                out[w] = fit.fit(ul::make_span(y.data() + w, c_window));
+            do_not_optimize(out.data());
+            bench::clobber_memory();
+        },
+        int64_t(sliding));
+    runner.run(
+        stringf("polyfit<3> fit_windows stride=1 n=%d", n),
+        [&]() {
+            fit.fit_windows(ul::as_span(y), 1,
+                            ul::make_span(out.data(), sliding));
+            do_not_optimize(out.data());
+            bench::clobber_memory();
+        },
+        int64_t(sliding));
+    runner.run(
+        stringf("polyfit<3> fit_windows float stride=1 n=%d", n),
+        [&]() {
+            fit_float.fit_windows(ul::as_span(y_float), 1,
+                                  ul::make_span(out_float.data(), sliding));
+            do_not_optimize(out_float.data());
+            bench::clobber_memory();
+        },
+        int64_t(sliding));
+    const size_t disjoint = size_t(n / c_window);
+    runner.run(
+        stringf("polyfit<3> fit_windows stride=%d n=%d", c_window, n),
+        [&]() {
+            fit.fit_windows(ul::as_span(y), c_window,
+                            ul::make_span(out.data(), disjoint));
+            do_not_optimize(out.data());
+            bench::clobber_memory();
+        },
+        int64_t(disjoint));
+}
+
+// Roots of n random polynomials.
+void bench_roots(bench::Runner& runner, int n)
+{
+    for (int degree : {2, 3, 5, 8}) {
+        const auto ps = random_doubles(n * (degree + 1));
+        vector<std::complex<double>> out(size_t(n * degree));
+        vector<double> real_out(out.size());
+        vector<int> counts(static_cast<size_t>(n));
+        runner.run(
+            stringf("roots deg=%d n=%d", degree, n),
+            [&]() {
+                for (int k = 0; k < n; ++k) {
+                    do_not_optimize(ul::roots(
+                        ul::make_span(ps.data() + k * (degree + 1),
+                                      size_t(degree + 1))));
+                }
+            },
+            n);
+        runner.run(
+            stringf("roots_batch deg=%d n=%d", degree, n),
+            [&]() {
+                ul::roots_batch(ul::as_span(ps), degree,
+                                ul::make_span(out.data(), out.size()));
+                do_not_optimize(out.data());
+                bench::clobber_memory();
+            },
+            n);
+        runner.run(
+            stringf("real_roots_in_batch deg=%d n=%d", degree, n),
+            [&]() {
+                ul::real_roots_in_batch(
+                    ul::as_span(ps), degree, -1, 1,
+                    ul::make_span(real_out.data(), real_out.size()),
+                    ul::make_span(counts.data(), counts.size()));
+                do_not_optimize(real_out.data());
+                bench::clobber_memory();
+            },
+            n);
+    }
+}
+
+void bench_polycompose(bench::Runner& runner)
+{
+    std::array<double, 5> pa = {1, -2, 3, -4, 5};
+    std::array<double, 4> qa = {0.5, 1, -1, 2};
+    runner.run("polycompose array<5> array<4>", [&]() {
+        do_not_optimize(pa);
+        do_not_optimize(ul::polycompose(pa, qa));
+    });
+    vector<double> pv(BE(pa)), qv(BE(qa));
+    runner.run("polycompose vector 5 4", [&]() {
+        do_not_optimize(ul::polycompose(pv, qv));
+    });
+}
+
+void bench_vector_math(bench::Runner& runner, int n)
+{
+    using namespace ul::vector_math;
+    const auto x = random_doubles(n);
+    const auto y = random_doubles(n);
+    const int64_t bytes = int64_t(n) * sizeof(double);
+    runner.run(
+        stringf("vector_math x - y n=%d", n),
+        [&]() { do_not_optimize((x - y).data()); }, n, 3 * bytes);
+    runner.run(
+        stringf("vector_math x * 2 n=%d", n),
+        [&]() { do_not_optimize((x * 2.0).data()); }, n, 2 * bytes);
+    runner.run(
+        stringf("vector_math times n=%d", n),
+        [&]() { do_not_optimize(times(x, y).data()); }, n, 3 * bytes);
+    runner.run(
+        stringf("vector_math sum n=%d", n),
+        [&]() { do_not_optimize(ul::vector_math::sum(x)); }, n, bytes);
+}
+
+void bench_array_math(bench::Runner& runner)
+{
+    using namespace ul::array_math;
+    std::array<double, 16> x, y;
+    for (int i = 0; i < 16; ++i) {
+        x[i] = i + 1;
+        y[i] = 16 - i;
+    }
+    runner.run(
+        "array_math times+sum array<16>",
+        [&]() {
+            do_not_optimize(x);
+            do_not_optimize(ul::array_math::sum(times(x, y)));
+        },
+        16);
+    runner.run(
+        "array_math log array<16>",
+        [&]() {
+            do_not_optimize(x);
+            do_not_optimize(ul::array_math::log(x));
+        },
+        16);
+}
+
+void bench_reductions(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n, 0.5, 1.5);
+    const int64_t bytes = int64_t(n) * sizeof(double);
+    runner.run(
+        stringf("sum n=%d", n),
+        [&]() { do_not_optimize(ul::sum(x)); }, n, bytes);
+    runner.run(
+        stringf("prod n=%d", n),
+        [&]() { do_not_optimize(ul::prod(x)); }, n, bytes);
+    runner.run(
+        stringf("min n=%d", n),
+        [&]() { do_not_optimize(ul::min(x)); }, n, bytes);
+    runner.run(
+        stringf("max n=%d", n),
+        [&]() { do_not_optimize(ul::max(x)); }, n, bytes);
+    runner.run(
+        stringf("norm n=%d", n),
+        [&]() { do_not_optimize(ul::norm(x)); }, n, bytes);
+}
+
+void bench_percentiles(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n);
+    const int64_t bytes = int64_t(n) * sizeof(double);
+    vector<double> scratch(n);
+    runner.run(
+        stringf("median by sort n=%d", n),
+        [&]() {
+            std::copy(BE(x), scratch.begin());
+            std::sort(BE(scratch));
+            do_not_optimize(scratch[n / 2]);
+        },
+        n, bytes);
+    runner.run(
+        stringf("median n=%d", n),
+        [&]() {
+            do_not_optimize(
+                ul::median(x, ul::make_span(scratch.data(), scratch.size())));
+        },
+        n, bytes);
+    const vector<double> ps = {1, 25, 50, 75, 99};
+    vector<double> out(ps.size());
+    runner.run(
+        stringf("percentiles 5 ranks n=%d", n),
+        [&]() {
+            ul::percentiles(ul::as_span(x), ul::as_span(ps),
+                            ul::make_span(out.data(), out.size()),
+                            ul::make_span(scratch.data(), scratch.size()));
+            do_not_optimize(out.data());
+        },
+        n, bytes);
+    runner.run(
+        stringf("percentiles_parallel 5 ranks n=%d", n),
+        [&]() {
+            ul::percentiles_parallel(ul::as_span(x), ul::as_span(ps),
+                                     ul::make_span(out.data(), out.size()));
+            do_not_optimize(out.data());
+        },
+        n, bytes);
+}
+
+void bench_statistics(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n);
+    runner.run(
+        stringf("Statistics::add n=%d", n),
+        [&]() {
+            ul::Statistics s;
+            for (double d : x)
+                s.add(d);
+            do_not_optimize(s);
+        },
+        n, int64_t(n) * sizeof(double));
+    runner.run(
+        stringf("Statistics::add(span<double>) n=%d", n),
+        [&]() {
+            ul::Statistics s;
+            s.add(ul::as_span(x));
+            do_not_optimize(s);
+        },
+        n, int64_t(n) * sizeof(double));
+    const vector<float> xf(BE(x));
+    runner.run(
+        stringf("Statistics::add(span<float>) n=%d", n),
+        [&]() {
+            ul::Statistics s;
+            s.add(ul::as_span(xf));
+            do_not_optimize(s);
+        },
+        n, int64_t(n) * sizeof(float));
+}
+
+void bench_statistics_merge(bench::Runner& runner)
+{
+    vector<ul::Statistics> shards(64);
+    for (int i = 0; i < 64; ++i) {
+        for (double x : random_doubles(i + 1))
+            shards[i].add(x);
+    }
+    runner.run(
+        "Statistics::merge 64 shards",
+        [&]() {
+            ul::Statistics total;
+            for (auto& s : shards)
+                total.merge(s);
+            do_not_optimize(total);
+        },
+        64);
+}
+
+void bench_statistics_n(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(3 * n);
+    vector<std::array<double, 3>> aos(n);
+    vector<double> soa[3];
+    for (int k = 0; k < n; ++k) {
+        for (int i = 0; i < 3; ++i) {
+            aos[k][i] = x[3 * k + i];
+            soa[i].push_back(x[3 * k + i]);
+        }
+    }
+    const int64_t bytes = int64_t(n) * 3 * sizeof(double);
+    runner.run(
+        stringf("StatisticsN<3>::add n=%d", n),
+        [&]() {
+            ul::StatisticsN<3> s;
+            for (auto& a : aos)
+                s.add(a);
+            do_not_optimize(s);
+        },
+        n, bytes);
+    runner.run(
+        stringf("StatisticsN<3>::add(span<AD3>) n=%d", n),
+        [&]() {
+            ul::StatisticsN<3> s;
+            s.add(ul::as_span(aos));
+            do_not_optimize(s);
+        },
+        n, bytes);
+    const std::array<ul::span<const double>, 3> columns{
+        {ul::as_span(soa[0]), ul::as_span(soa[1]), ul::as_span(soa[2])}};
+    runner.run(
+        stringf("StatisticsN<3>::add(columns) n=%d", n),
+        [&]() {
+            ul::StatisticsN<3> s;
+            s.add(columns);
+            do_not_optimize(s);
+        },
+        n, bytes);
+}
+
+void bench_metrics(bench::Runner& runner)
+{
+    ul::metrics::Registry registry;
+    auto& counter = registry.counter("bench_total");
+    runner.run("metrics Counter::add", [&]() { counter.add(1); });
+    auto& timer = registry.timer("bench_seconds");
+    runner.run("metrics Timer::record", [&]() { timer.record(1e-6); });
+    runner.run("metrics Timer::Scope",
+               [&]() { ul::metrics::Timer::Scope scope(timer); });
+}
+
+void bench_quantile_sketch(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n);
+    runner.run(
+        stringf("QuantileSketch::add n=%d", n),
+        [&]() {
+            ul::QuantileSketch s;
+            for (double d : x)
+                s.add(d);
+            do_not_optimize(s.quantile(0.5));
+        },
+        n, int64_t(n) * sizeof(double));
+    ul::QuantileSketch s;
+    s.add(ul::as_span(x));
+    runner.run("QuantileSketch::quantile", [&]() {
+        do_not_optimize(s.quantile(0.95));
+    });
+}
+
+void bench_windowed_statistics(bench::Runner& runner, int n)
+{
+    const auto x = random_doubles(n);
+    const int64_t bytes = int64_t(n) * sizeof(double);
+    ul::WindowedStatistics<64> fixed;
+    runner.run(
+        stringf("WindowedStatistics<64>::add n=%d", n),
+        [&]() {
+            for (double d : x)
+                fixed.add(d);
+            do_not_optimize(fixed.mean());
+        },
+        n, bytes);
+    ul::WindowedStatistics<> runtime(1000);
+    runner.run(
+        stringf("WindowedStatistics<>(1000)::add n=%d", n),
+        [&]() {
+            for (double d : x)
+                runtime.add(d);
+            do_not_optimize(runtime.mean());
+        },
+        n, bytes);
+    vector<double> out(x.size());
+    runner.run(
+        stringf("moving_mean window=64 n=%d", n),
+        [&]() {
+            ul::moving_mean(ul::as_span(x), 64, ul::as_span(out));
+            do_not_optimize(out.data());
+        },
+        n, bytes);
+    runner.run(
+        stringf("moving_max window=64 n=%d", n),
+        [&]() {
+            ul::moving_max(ul::as_span(x), 64, ul::as_span(out));
+            do_not_optimize(out.data());
+        },
+        n, bytes);
+}
+
+void bench_ewma(bench::Runner& runner)
+{
+    ul::EwmaStatistics ewma(100);
+    double x = 0;
+    runner.run("EwmaStatistics::add", [&]() {
+        ewma.add(x);
+        x += 1;
+    });
+    do_not_optimize(ewma.mean());
+    ul::RateMeter<ul::tsc_clock> meter;
+    runner.run("RateMeter<tsc_clock>::mark", [&]() { meter.mark(); });
+    const auto now = ul::tsc_clock::now();
+    runner.run("RateMeter::mark(n, now)", [&]() { meter.mark(1, now); });
+    runner.run("RateMeter::rate_1m",
+               [&]() { do_not_optimize(meter.rate_1m()); });
+}
+
+vector<int> parse_sizes(const string& s)
+{
+    vector<int> sizes;
+    for (auto part : ul::split(ul::as_span(s), ","))
+        sizes.push_back(atoi(string(BE(part)).c_str()));
+    return sizes;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    vector<string> unparsed;
+    options.parse_args(argc, argv, &unparsed);
+    vector<int> sizes = {16, 1024, 65536};
+    for (auto& arg : unparsed) {
+        if (ul::startswith(arg, "--sizes="))
+            sizes = parse_sizes(arg.substr(8));
+        else {
+            fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench::Runner runner(options);
+
+    for (int n : sizes) {
+        bench_string(runner, n);
+        bench_stringf(runner, n);
+        bench_to_string(runner, n);
+        bench_conv(runner, n);
+        bench_polyval(runner, n);
+        bench_polyfit(runner, n);
+        bench_roots(runner, n);
+        bench_vector_math(runner, n);
+        bench_reductions(runner, n);
+        bench_statistics(runner, n);
+        bench_percentiles(runner, n);
+        bench_statistics_n(runner, n);
+        bench_quantile_sketch(runner, n);
+        bench_windowed_statistics(runner, n);
+    }
+    bench_stringf_fixed(runner);
+    bench_inlinevector<4>(runner);
+    bench_inlinevector<16>(runner);
+    bench_conv_array(runner);
+    bench_polycompose(runner);
+    bench_array_math(runner);
+    bench_metrics(runner);
+    bench_statistics_merge(runner);
+    bench_ewma(runner);
+
+    return runner.finish();
+}
@@ -0,0 +1,187 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ul/bench.h"
+
+namespace bench = ul::bench;
+
+void test_median_mad()
+{
+    std::vector<double> odd = {5, 1, 3, 2, 100};
+    assert(bench::median(ul::as_span(odd)) == 3);
+    // Deviations: 2, 2, 0, 1, 97
+    assert(bench::mad(ul::as_span(odd)) == 2);
+
+    std::vector<double> even = {4, 1, 3, 2};
+    assert(bench::median(ul::as_span(even)) == 2.5);
+    assert(bench::mad(ul::as_span(even)) == 1);
+
+    assert(std::isnan(bench::median(ul::span<const double>())));
+}
+
+void test_parse_args()
+{
+    const char* argv[] = {"prog", "--min-time=0.5", "--repetitions=3",
+                          "--filter=abc", "--unknown"};
+    bench::Options o;
+    std::vector<std::string> unparsed;
+    assert(!o.parse_args(5, argv, &unparsed));
+    assert(o.min_time == 0.5);
+    assert(o.repetitions == 3);
+    assert(o.filter == "abc");
+    assert(unparsed.size() == 1 && unparsed[0] == "--unknown");
+}
+
+void test_run()
+{
+    bench::Options o;
+    o.min_time = 0.002;
+    o.warmup_time = 0.001;
+    o.repetitions = 5;
+    o.filter = "sum";
+    o.print_progress = false;
+    bench::Runner runner(o);
+
+    std::vector<double> v(1000, 1.0);
+    auto r = runner.run(
+        "sum \"1000\"",
+        [&]() {
+            double s = 0;
+            for (double x : v)
+                s += x;
+            bench::do_not_optimize(s);
+        },
+        int64_t(v.size()), int64_t(v.size() * sizeof(double)));
+    assert(r);
+    assert(!runner.run("skipped", []() {}));
+    assert(runner.results().size() == 1);
+
+    assert(r->stats.count() == 5);
+    assert(r->ns_per_call.size() == 5);
+    assert(r->calls_per_repetition > 0);
+    // Only the ordering, the times themselves depend on the load.
+    assert(r->min_ns > 0 && r->min_ns <= r->median_ns);
+    assert(r->mad_ns >= 0);
+    assert(fabs(r->ns_per_item() * 1000 - r->median_ns) < 1e-6 * r->median_ns);
+    assert(fabs(r->bytes_per_second() - 8 * r->items_per_second()) <
+           1e-6 * r->bytes_per_second());
+
+    auto json = r->to_json();
+    assert(json.find("\"name\":\"sum \\\"1000\\\"\"") != std::string::npos);
+    assert(json.find("\"median_ns\":") != std::string::npos);
+    assert(json.find("\"repetitions\":5") != std::string::npos);
+    assert(json.find("nan") == std::string::npos);
+
+    runner.print_table(stdout);
+    runner.print_json_lines(stdout);
+}
+
+void test_no_throughput()
+{
+    bench::Options o;
+    o.min_time = 0.001;
+    o.warmup_time = 0;
+    o.repetitions = 3;
+    o.print_progress = false;
+    bench::Runner runner(o);
+    int x = 0;
+    auto r = runner.run(
+        "increment",
+        [&]() {
+            ++x;
+            bench::clobber_memory();
+        },
+        0);
+    assert(std::isnan(r->items_per_second()));
+    assert(std::isnan(r->bytes_per_second()));
+    assert(r->to_json().find("\"bytes_per_second\":null") != std::string::npos);
+}
+
+void test_compare()
+{
+    bench::Result r;
+    r.name = "a \"b\" c";
+    r.ns_per_call = {10, 11, 12};
+    for (double x : r.ns_per_call)
+        r.stats.add(x);
+    r.median_ns = 11;
+    r.mad_ns = 1;
+    r.min_ns = 10;
+
+    bench::Result parsed;
+    assert(bench::parse_json_line(r.to_json(), parsed));
+    assert(parsed.name == r.name);
+    assert(parsed.median_ns == 11 && parsed.mad_ns == 1 && parsed.min_ns == 10);
+    assert(!bench::parse_json_line("{\"name\":\"x\"}", parsed));
+    r.name = "a\nb\tc\x01";
+    assert(r.to_json().find("\"a\\nb\\tc\\u0001\"") != std::string::npos);
+    assert(bench::parse_json_line(r.to_json(), parsed));
+    assert(parsed.name == r.name);
+
+    auto make = [](const char* name, double median, double mad) {
+        bench::Result x;
+        x.name = name;
+        x.median_ns = median;
+        x.mad_ns = mad;
+        return x;
+    };
+    std::vector<bench::Result> baseline = {
+        make("same", 100, 1), make("slower", 100, 1), make("noisy", 100, 10),
+        make("faster", 100, 1), make("only in baseline", 100, 1)};
+    std::vector<bench::Result> current = {
+        make("same", 102, 1), make("slower", 120, 1), make("noisy", 120, 10),
+        make("faster", 80, 1), make("only in current", 100, 1)};
+    auto cs = bench::compare(baseline, current, 0.05);
+    assert(cs.size() == 4);
+    assert(cs[0].name == "same" && !cs[0].regression && !cs[0].improvement);
+    assert(cs[1].name == "slower" && cs[1].regression);
+    assert(fabs(cs[1].ratio - 1.2) < 1e-12);
+    // Within 3 MADs
+    assert(cs[2].name == "noisy" && !cs[2].regression);
+    assert(cs[3].name == "faster" && cs[3].improvement && !cs[3].regression);
+    bench::print_comparison(stdout, cs);
+}
+
+void test_files()
+{
+    const char* path = "test-bench.json";
+    bench::Options o;
+    o.min_time = 0.001;
+    o.warmup_time = 0;
+    o.repetitions = 3;
+    o.json_path = path;
+    bench::Runner runner(o);
+    runner.run("noop", []() { bench::clobber_memory(); });
+    assert(runner.finish() == 0);
+    std::vector<bench::Result> results;
+    assert(bench::read_json_lines(path, results));
+    assert(results.size() == 1 && results[0].name == "noop");
+    remove(path);
+
+    // Missing or unwritable files are errors, not CHECK failures.
+    assert(!bench::read_json_lines("no/such/file.json", results));
+    bench::Options bad_json = o;
+    bad_json.json_path = "no/such/dir/out.json";
+    assert(bench::Runner(bad_json).finish() == 1);
+    bench::Options bad_baseline = o;
+    bad_baseline.json_path.clear();
+    bad_baseline.baseline_path = "no/such/file.json";
+    assert(bench::Runner(bad_baseline).finish() == 1);
+}
+
+int main()
+{
+    test_median_mad();
+    test_parse_args();
+    test_run();
+    test_no_throughput();
+    test_compare();
+    test_files();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
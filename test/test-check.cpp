@@ -0,0 +1,117 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cstring>
+
+#include "ul/check.h"
+
+using ul::check_failed_count;
+using ul::check_failed_policy_log;
+using ul::check_failed_policy_terminate;
+using ul::check_failed_policy_throw;
+using ul::check_failed_suppressed_count;
+using ul::check_failure;
+using ul::set_check_failed_log_rate_limit;
+using ul::set_check_failed_policy;
+
+int checked_identity(int x)
+{
+    CHECK_ALWAYS(x >= 0, "x = %d", x);
+    return x;
+}
+
+void test_default_policy()
+{
+    assert(ul::check_failed_policy() ==
+           (check_failed_policy_log | check_failed_policy_terminate));
+}
+
+void test_throw()
+{
+    auto prev_policy = set_check_failed_policy(check_failed_policy_throw);
+    auto c0 = check_failed_count();
+    bool thrown = false;
+    int expected_line = 0;
+    try {
+        expected_line = __LINE__ + 1;
+        CHECK_ALWAYS(1 + 1 == 3);
+    } catch (const check_failure& e) {
+        thrown = true;
+        assert(strcmp(e.condition(), "1 + 1 == 3") == 0);
+        assert(e.line() == expected_line);
+        assert(strstr(e.what(), "CHECK failed") != nullptr);
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+        checked_identity(-2);
+    } catch (const check_failure& e) {
+        thrown = true;
+        assert(strstr(e.what(), "x = -2") != nullptr);
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+        UL_FAIL("failing %s", "unconditionally");
+    } catch (const check_failure& e) {
+        thrown = true;
+        assert(e.condition() == nullptr);
+        assert(strstr(e.what(), "failing unconditionally") != nullptr);
+    }
+    assert(thrown);
+
+    // The library's checks, which never continue, also throw.
+    thrown = false;
+    try {
+        UL_CHECK_ALWAYS(1 + 1 == 3, "library %s", "check");
+    } catch (const check_failure& e) {
+        thrown = true;
+        assert(strstr(e.what(), "library check") != nullptr);
+    }
+    assert(thrown);
+    assert(check_failed_count() == c0 + 4);
+
+    set_check_failed_policy(prev_policy);
+}
+
+void test_log_and_continue()
+{
+    auto prev_policy = set_check_failed_policy(check_failed_policy_log);
+    auto c0 = check_failed_count();
+    assert(checked_identity(-3) == -3);
+    assert(checked_identity(3) == 3);
+    assert(check_failed_count() == c0 + 1);
+
+    // Silent, continue.
+    set_check_failed_policy(0);
+    assert(checked_identity(-4) == -4);
+    assert(check_failed_count() == c0 + 2);
+
+    set_check_failed_policy(prev_policy);
+}
+
+void test_rate_limit()
+{
+    auto prev_policy = set_check_failed_policy(check_failed_policy_log);
+    set_check_failed_log_rate_limit(2);
+    auto s0 = check_failed_suppressed_count();
+    for (int i = 0; i < 10; ++i)
+        checked_identity(-i - 1);
+    // At most 2 messages in each 1-second window, at most 2 windows.
+    auto suppressed = check_failed_suppressed_count() - s0;
+    assert(6 <= suppressed && suppressed <= 8);
+    set_check_failed_log_rate_limit(0);
+    set_check_failed_policy(prev_policy);
+}
+
+int main()
+{
+    test_default_policy();
+    test_throw();
+    test_log_and_continue();
+    test_rate_limit();
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Compiled with UL_CHECK_LEVEL=1 and UL_CHECK_COUNTERS, see CMakeLists.txt
+
+#undef NDEBUG
+
+#include <cassert>
+#include <cstring>
+
+#include "ul/check.h"
+
+static_assert(UL_CHECK_LEVEL == 1, "Test expects UL_CHECK_LEVEL == 1");
+
+int g_evaluated = 0;
+
+bool evaluate(bool b)
+{
+    ++g_evaluated;
+    return b;
+}
+
+template <class T>
+void checked_in_template(T x)
+{
+    CHECK(x >= 0);
+}
+
+bool throws(void (*f)())
+{
+    try {
+        f();
+    } catch (const ul::check_failure&) {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    auto prev_policy =
+        ul::set_check_failed_policy(ul::check_failed_policy_throw);
+
+    // DCHECK is compiled out and does not evaluate its argument.
+    DCHECK(evaluate(false));
+    UL_DCHECK(evaluate(false), "message %d", 1);
+    assert(g_evaluated == 0);
+
+    CHECK(evaluate(true));
+    CHECK_ALWAYS(evaluate(true));
+    assert(g_evaluated == 2);
+
+    assert(throws([]() { CHECK(evaluate(false)); }));
+    assert(throws([]() { CHECK_ALWAYS(evaluate(false), "%s", "message"); }));
+    assert(g_evaluated == 4);
+
+    for (int i = 0; i < 100; ++i)
+        CHECK(i < 100);
+    for (int i = 0; i < 10; ++i) {
+        checked_in_template(i);
+        checked_in_template(double(i));
+    }
+
+    auto counts = ul::check_site_counts();
+    assert(counts.size() == 6);
+    // Sorted by decreasing count.
+    assert(strcmp(counts[0].condition, "i < 100") == 0);
+    assert(counts[0].count == 100);
+    // Two instantiations merged.
+    assert(strcmp(counts[1].condition, "x >= 0") == 0);
+    assert(counts[1].count == 20);
+    for (auto& c : counts)
+        assert(strstr(c.file, "test-check_levels.cpp") != nullptr);
+    ul::print_check_site_counts(stdout);
+
+    ul::set_check_failed_policy(prev_policy);
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "ul/clock.h"
+#include "ul/stopwatch.h"
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::this_thread::sleep_for;
+
+using ul::process_cpu_clock;
+using ul::Stopwatch;
+using ul::thread_cpu_clock;
+using ul::tsc_clock;
+using ul::tsc_clock_fenced;
+
+const milliseconds waitms(100);
+const double waitsec(.1);
+const double tol(.03);
+
+volatile double g_sink;
+
+void busy_wait(double seconds)
+{
+    auto t0 = steady_clock::now();
+    double x = 0;
+    while (std::chrono::duration<double>(steady_clock::now() - t0).count() <
+           seconds)
+        x += sqrt(x + 1);
+    g_sink = x;
+}
+
+template <class Clock>
+void test_monotonic()
+{
+    auto t = Clock::now();
+    for (int i = 0; i < 10000; ++i) {
+        auto u = Clock::now();
+        assert(t <= u);
+        t = u;
+    }
+}
+
+template <class Clock>
+void test_wall_clock()
+{
+    test_monotonic<Clock>();
+
+    // Bracket the readings of Clock with steady_clock readings.
+    auto s0a = steady_clock::now();
+    auto t0 = Clock::now();
+    auto s0b = steady_clock::now();
+    sleep_for(waitms);
+    auto s1a = steady_clock::now();
+    auto t1 = Clock::now();
+    auto s1b = steady_clock::now();
+    double ds_min = std::chrono::duration<double>(s1a - s0b).count();
+    double ds_max = std::chrono::duration<double>(s1b - s0a).count();
+    double dt = std::chrono::duration<double>(t1 - t0).count();
+    assert(ds_min * (1 - 1e-3) - 1e-5 <= dt);
+    assert(dt <= ds_max * (1 + 1e-3) + 1e-5);
+
+    // Sleeps can be much longer on a loaded machine, the bracketing above
+    // checks the accuracy.
+    Stopwatch<Clock> sw(true);
+    sleep_for(waitms);
+    assert(sw.stop() >= waitsec * (1 - 1e-3));
+
+    auto t2 = ul::tic<Clock>();
+    sleep_for(waitms);
+    assert(ul::toc(t2) >= waitsec * (1 - 1e-3));
+}
+
+template <class Clock>
+void test_cpu_clock()
+{
+    test_monotonic<Clock>();
+
+    auto wall0 = steady_clock::now();
+    Stopwatch<Clock> sw(true);
+    sleep_for(waitms);
+    assert(sw.elapsed() < waitsec / 2);  // sleeping doesn't consume cpu
+    busy_wait(waitsec);
+    // Less than the wall time, much less if the thread has been preempted
+    // (parallel tests on few CPUs).
+    double e = sw.stop();
+    double wall =
+        std::chrono::duration<double>(steady_clock::now() - wall0).count();
+    assert(0 < e && e < wall + tol);
+}
+
+int main()
+{
+    tsc_clock::calibrate();
+    printf("TSC frequency: %.1f MHz\n", tsc_clock::ticks_per_second() / 1e6);
+    test_wall_clock<tsc_clock>();
+    test_wall_clock<tsc_clock_fenced>();
+#if defined UL_TSC_X86
+    // lfence + rdtsc, as on CPUs without rdtscp
+    const bool has_rdtscp = ul::detail::g_tsc_has_rdtscp;
+    ul::detail::g_tsc_has_rdtscp = false;
+    test_wall_clock<tsc_clock_fenced>();
+    ul::detail::g_tsc_has_rdtscp = has_rdtscp;
+#endif
+    test_cpu_clock<thread_cpu_clock>();
+    test_cpu_clock<process_cpu_clock>();
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ul/concurrent_statistics.h"
+
+void test_single_thread()
+{
+    ul::ConcurrentStatistics cs;
+    assert(cs.snapshot().count() == 0);
+    assert(std::isnan(cs.snapshot().mean()));
+    assert(cs.num_shards() == 0);
+
+    ul::Statistics expected;
+    for (int i = 0; i < 1000; ++i) {
+        const double x = sin(i) * 100 + 1e6;
+        cs.add(x);
+        expected.add(x);
+    }
+    cs.add(NAN);
+    assert(cs.num_shards() == 1);
+    auto s = cs.snapshot();
+    assert(s.count() == expected.count());
+    assert(s.lower() == expected.lower() && s.upper() == expected.upper());
+    assert(fabs(s.mean() - expected.mean()) < 1e-9);
+    assert(fabs(s.std() - expected.std()) < 1e-9);
+
+    cs.reset();
+    assert(cs.snapshot().count() == 0);
+    cs.add(2);
+    assert(cs.snapshot().count() == 1 && cs.snapshot().mean() == 2);
+}
+
+void test_interleaved_objects()
+{
+    // Alternating between objects, and objects created at the address of
+    // destroyed ones, must not mix up shards.
+    ul::ConcurrentStatistics a, b;
+    for (int i = 0; i < 100; ++i) {
+        a.add(1);
+        b.add(2);
+    }
+    assert(a.snapshot().count() == 100 && a.snapshot().mean() == 1);
+    assert(b.snapshot().count() == 100 && b.snapshot().mean() == 2);
+    for (int i = 0; i < 10; ++i) {
+        std::unique_ptr<ul::ConcurrentStatistics> c(
+            new ul::ConcurrentStatistics);
+        assert(c->snapshot().count() == 0);
+        c->add(i);
+        assert(c->snapshot().count() == 1 && c->snapshot().mean() == i);
+    }
+}
+
+void test_threads()
+{
+    ul::ConcurrentStatistics cs;
+    const int c_threads = 8, c_values = 100000;
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        // Snapshots taken while writing are consistent and monotonic.
+        int64_t previous = 0;
+        while (!done.load()) {
+            auto s = cs.snapshot();
+            assert(s.count64() >= previous);
+            previous = s.count64();
+            if (s.count64() > 0) {
+                assert(s.lower() >= 0 && s.upper() < c_threads * c_values);
+                assert(s.lower() <= s.mean() && s.mean() <= s.upper());
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < c_threads; ++t) {
+        writers.emplace_back([&cs, t]() {
+            for (int i = 0; i < c_values; ++i)
+                cs.add(t * c_values + i);
+        });
+    }
+    for (auto& w : writers)
+        w.join();
+    done = true;
+    reader.join();
+
+    // The values of exited threads are kept, their shards are freed.
+    assert(cs.num_shards() == 0);
+    auto s = cs.snapshot();
+    const double n = double(c_threads) * c_values;
+    assert(s.count64() == c_threads * c_values);
+    assert(s.lower() == 0 && s.upper() == n - 1);
+    assert(fabs(s.mean() - (n - 1) / 2) < 1e-6);
+    // Population variance of 0..n-1: (n^2 - 1) / 12
+    assert(fabs(s.var() / ((n * n - 1) / 12) - 1) < 1e-9);
+}
+
+void test_thread_churn()
+{
+    // Short-lived threads and objects don't accumulate shards.
+    ul::ConcurrentStatistics cs;
+    for (int t = 0; t < 100; ++t) {
+        std::thread([&cs, t]() {
+            ul::ConcurrentStatistics temporary;
+            temporary.add(t);
+            cs.add(t);
+            assert(cs.num_shards() == 1);
+        }).join();
+        ul::ConcurrentStatistics temporary;
+        temporary.add(t);
+    }
+    assert(cs.num_shards() == 0);
+    auto s = cs.snapshot();
+    assert(s.count() == 100 && s.lower() == 0 && s.upper() == 99);
+    assert(fabs(s.mean() - 49.5) < 1e-12);
+    cs.reset();
+    assert(cs.snapshot().count() == 0);
+}
+
+int main()
+{
+    test_single_thread();
+    test_interleaved_objects();
+    test_threads();
+    test_thread_churn();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/conv.h"
+#include "ul/ml.h"
+
+using std::vector;
+using ul::ConvShape;
+
+const ConvShape c_shapes[] = {ConvShape::full, ConvShape::same,
+                              ConvShape::valid};
+
+template <class T>
+vector<T> random_values(std::mt19937& rng, size_t n)
+{
+    std::uniform_real_distribution<double> d(-1, 1);
+    vector<T> x(n);
+    for (auto& v : x)
+        v = T(d(rng));
+    return x;
+}
+
+// The full convolution in double by definition, then the part of `shape`.
+template <class T>
+vector<double> reference(const vector<T>& x,
+                         const vector<T>& y,
+                         ConvShape shape)
+{
+    const size_t n = x.size(), m = y.size();
+    vector<double> full(n + m - 1);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j)
+            full[i + j] += double(x[i]) * double(y[j]);
+    }
+    const size_t offset = ul::conv_result_offset(n, m, shape);
+    const size_t size = ul::conv_result_size(n, m, shape);
+    return vector<double>(full.begin() + long(offset),
+                          full.begin() + long(offset + size));
+}
+
+template <class T>
+bool close(const vector<T>& actual, const vector<double>& expected, double eps)
+{
+    if (actual.size() != expected.size())
+        return false;
+    double largest = 1;
+    for (double e : expected)
+        largest = std::max(largest, fabs(e));
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (!(fabs(double(actual[i]) - expected[i]) <= eps * largest))
+            return false;
+    }
+    return true;
+}
+
+void test_shapes()
+{
+    // matlab: conv([1 2 3 4 5], [1 1 1], 'same') etc.
+    const vector<double> x{1, 2, 3, 4, 5}, y{1, 1, 1};
+    assert(ul::conv(x, y, ConvShape::full) ==
+           (vector<double>{1, 3, 6, 9, 12, 9, 5}));
+    assert(ul::conv(x, y, ConvShape::same) ==
+           (vector<double>{3, 6, 9, 12, 9}));
+    assert(ul::conv(x, y, ConvShape::valid) == (vector<double>{6, 9, 12}));
+    // Even filter: 'same' starts at m / 2.
+    const vector<double> y2{1, 10};
+    assert(ul::conv(x, y2, ConvShape::same) ==
+           (vector<double>{12, 23, 34, 45, 50}));
+    // Filter longer than x
+    assert(ul::conv(y, x, ConvShape::same) == (vector<double>{6, 9, 12}));
+    assert(ul::conv(y, x, ConvShape::valid).empty());
+    assert(ul::conv(vector<double>(), x, ConvShape::full).empty());
+
+    // Integers and arrays use the generic loop.
+    const std::array<int, 5> xi{{1, 2, 3, 4, 5}};
+    const vector<int> yi{1, 1, 1};
+    assert(ul::conv(xi, yi, ConvShape::same) ==
+           (vector<int>{3, 6, 9, 12, 9}));
+    assert(ul::conv_direct(xi, yi, ConvShape::valid) ==
+           (vector<int>{6, 9, 12}));
+
+    vector<double> r;
+    ul::conv_into(x, y, r, ConvShape::valid);
+    assert(r == (vector<double>{6, 9, 12}));
+    double out[5];
+    ul::conv_into(x, y, ul::make_span(out, 5), ConvShape::same);
+    assert(out[0] == 3 && out[4] == 9);
+
+    bool thrown = false;
+    try {
+        ul::conv_into(x, y, ul::make_span(out, 4), ConvShape::same);
+    } catch (const ul::check_failure&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+template <class T>
+void test_against_reference(double eps)
+{
+    std::mt19937 rng{3};
+    for (size_t n : {1, 2, 3, 7, 16, 31, 64, 100, 1000, 3000}) {
+        for (size_t m : {1, 2, 3, 5, 8, 17, 64, 65, 600, 1500}) {
+            const auto x = random_values<T>(rng, n);
+            const auto y = random_values<T>(rng, m);
+            for (ConvShape shape : c_shapes) {
+                const auto expected = reference(x, y, shape);
+                vector<T> r(ul::conv_result_size(n, m, shape));
+                const auto rs = ul::make_span(r.data(), r.size());
+                ul::conv_direct_into(ul::as_span(x), ul::as_span(y), rs,
+                                     shape);
+                assert(close(r, expected, eps));
+                ul::detail::conv_direct_into_portable(
+                    ul::as_span(x), ul::as_span(y), rs, shape);
+                assert(close(r, expected, eps));
+                assert(close(ul::conv_direct(x, y, shape), expected, eps));
+                assert(close(ul::conv_fft(x, y, shape), expected, eps));
+                assert(close(ul::conv(x, y, shape), expected, eps));
+            }
+        }
+    }
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_shapes();
+    test_against_reference<double>(1e-12);
+    test_against_reference<float>(1e-5);
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
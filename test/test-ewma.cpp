@@ -0,0 +1,145 @@
+#undef NDEBUG
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "ul/check.h"
+#include "ul/ewma.h"
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+// Clock advanced by the test.
+struct manual_clock
+{
+    using rep = int64_t;
+    using period = std::milli;
+    using duration = std::chrono::milliseconds;
+    using time_point = std::chrono::time_point<manual_clock>;
+    static constexpr bool is_steady = true;
+
+    static time_point t;
+    static time_point now() noexcept { return t; }
+};
+
+manual_clock::time_point manual_clock::t;
+
+bool close(double a, double b, double tolerance)
+{
+    return fabs(a - b) <= tolerance * std::max(1.0, fabs(b));
+}
+
+void test_ewma_statistics()
+{
+    ul::EwmaStatistics s(10);
+    assert(std::isnan(s.mean()) && std::isnan(s.var()));
+    s.add(NAN);
+    s.add(3);
+    assert(s.count64() == 1 && s.mean() == 3 && s.var() == 0);
+
+    // Weights halve every 10 values.
+    assert(close(s.weight(), 1 - pow(0.5, 0.1), 1e-15));
+    for (int i = 0; i < 10; ++i)
+        s.add(5);
+    assert(close(s.mean(), 4, 1e-12));
+
+    // Converges to the mean and variance of a stationary sequence.
+    s.reset();
+    assert(s.count64() == 0);
+    ul::EwmaStatistics slow(1000);
+    for (int i = 0; i < 100000; ++i) {
+        const double x = (i % 2) ? 11 : 9;  // mean 10, var 1
+        s.add(x);
+        slow.add(x);
+    }
+    assert(close(slow.mean(), 10, 1e-3));
+    assert(close(slow.var(), 1, 1e-2));
+    assert(close(s.mean(), 10, 0.05));
+
+    // Follows a level shift within a few half-lives.
+    for (int i = 0; i < 100; ++i)
+        s.add(20);
+    assert(close(s.mean(), 20, 1e-3));
+    assert(s.var() < 0.15);
+
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    bool threw = false;
+    try {
+        ul::EwmaStatistics bad(0);
+    } catch (const ul::check_failure&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_rate_meter()
+{
+    manual_clock::t = manual_clock::time_point(seconds(1000));
+    ul::RateMeter<manual_clock> m;
+    assert(m.count() == 0 && m.rate_1m() == 0 && m.mean_rate() == 0);
+
+    // 10 events/s for 5 minutes, marked every 100 ms.
+    for (int i = 0; i < 3000; ++i) {
+        manual_clock::t += milliseconds(100);
+        m.mark();
+    }
+    assert(m.count() == 3000);
+    assert(close(m.mean_rate(), 10, 1e-12));
+    assert(close(m.rate_1m(), 10, 1e-9));
+    assert(close(m.rate_5m(), 10, 1e-9));
+    assert(close(m.rate_15m(), 10, 1e-9));
+
+    // Nothing for a minute: rate_1m decays by 1/e, also without marks.
+    manual_clock::t += seconds(60);
+    assert(close(m.rate_1m(), 10 * exp(-1), 1e-9));
+    assert(close(m.rate_5m(), 10 * exp(-0.2), 1e-9));
+    assert(close(m.rate_15m(), 10 * exp(-1.0 / 15), 1e-9));
+    m.mark(0);  // ticks, same rates
+    assert(close(m.rate_1m(), 10 * exp(-1), 1e-9));
+
+    // 100 events/s: the 1 minute rate follows faster.
+    for (int i = 0; i < 600; ++i) {
+        manual_clock::t += milliseconds(100);
+        m.mark(10);
+    }
+    assert(m.rate_1m() > 60 && m.rate_1m() < 100);
+    assert(m.rate_5m() < m.rate_1m() && m.rate_15m() < m.rate_5m());
+
+    // The first tick starts at the instant rate.
+    ul::RateMeter<manual_clock> first;
+    first.mark(50);
+    manual_clock::t += seconds(5);
+    first.mark(0);
+    assert(close(first.rate_15m(), 10, 1e-12));
+}
+
+void test_concurrent_readers()
+{
+    ul::RateMeter<> m;
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        while (!done.load()) {
+            const double r = m.rate_1m();
+            assert(r >= 0 && std::isfinite(r));
+            assert(m.mean_rate() >= 0);
+        }
+    });
+    for (int i = 0; i < 1000000; ++i)
+        m.mark();
+    done = true;
+    reader.join();
+    assert(m.count() == 1000000);
+}
+
+int main()
+{
+    test_ewma_statistics();
+    test_rate_meter();
+    test_concurrent_readers();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
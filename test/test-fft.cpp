@@ -0,0 +1,147 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/fft.h"
+#include "ul/ml.h"
+
+using std::vector;
+using complex = std::complex<double>;
+
+template <class T = double>
+vector<T> random_values(std::mt19937& rng, size_t n)
+{
+    std::uniform_real_distribution<double> d(-1, 1);
+    vector<T> x(n);
+    for (auto& v : x)
+        v = T(d(rng));
+    return x;
+}
+
+// Largest absolute difference relative to the largest value of `expected`.
+template <class T>
+double max_error(const vector<T>& actual, const vector<T>& expected)
+{
+    assert(actual.size() == expected.size());
+    double largest = 0, error = 0;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        largest = std::max(largest, fabs(double(expected[i])));
+        error = std::max(error, fabs(double(actual[i]) - double(expected[i])));
+    }
+    return largest > 0 ? error / largest : error;
+}
+
+void test_fft()
+{
+    std::mt19937 rng{1};
+    for (size_t n : {1, 2, 4, 8, 64, 1024}) {
+        const auto re = random_values(rng, n), im = random_values(rng, n);
+        vector<complex> x(n);
+        for (size_t i = 0; i < n; ++i)
+            x[i] = complex(re[i], im[i]);
+        // DFT by definition
+        vector<complex> expected(n);
+        for (size_t k = 0; k < n; ++k) {
+            for (size_t i = 0; i < n; ++i) {
+                const double a = -2 * M_PI * double(i * k % n) / double(n);
+                expected[k] += x[i] * std::polar(1.0, a);
+            }
+        }
+        ul::Fft fft(n);
+        assert(fft.size() == n);
+        auto yr = re, yi = im;
+        fft.forward(yr.data(), yi.data());
+        for (size_t k = 0; k < n; ++k)
+            assert(std::abs(complex(yr[k], yi[k]) - expected[k]) <
+                   1e-12 * double(n));
+        fft.inverse(yr.data(), yi.data());
+        for (size_t i = 0; i < n; ++i)
+            assert(std::abs(complex(yr[i], yi[i]) - x[i]) < 1e-14 * double(n));
+
+        // Bit-reversed spectrum: same values, inverse without permutation.
+        auto zr = re, zi = im;
+        fft.forward_bitreversed(zr.data(), zi.data());
+        for (size_t k = 0; k < n; ++k) {
+            size_t r = 0;
+            for (size_t b = 1, c = n / 2; b < n; b *= 2, c /= 2)
+                r |= (k & b) ? c : 0;
+            assert(std::abs(complex(zr[k], zi[k]) - expected[r]) <
+                   1e-12 * double(n));
+        }
+        fft.inverse_bitreversed(zr.data(), zi.data());
+        for (size_t i = 0; i < n; ++i)
+            assert(std::abs(complex(zr[i], zi[i]) - x[i]) < 1e-14 * double(n));
+    }
+
+    bool thrown = false;
+    try {
+        ul::Fft fft(12);
+    } catch (const ul::check_failure&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_conv_fft()
+{
+    std::mt19937 rng{2};
+    for (size_t n : {1, 2, 3, 7, 64, 100, 1000, 5000}) {
+        for (size_t m : {1, 2, 5, 63, 64, 65, 300, 2000}) {
+            const auto x = random_values(rng, n), y = random_values(rng, m);
+            const auto expected = ul::conv_direct(x, y);
+            assert(expected.size() == n + m - 1);
+            assert(max_error(ul::conv_fft(x, y), expected) < 1e-12);
+            assert(max_error(ul::conv_fft(y, x), expected) < 1e-12);
+            assert(max_error(ul::conv(x, y), expected) < 1e-12);
+            vector<double> r(3, 1.0);
+            ul::conv_into(x, y, r);
+            assert(max_error(r, expected) < 1e-12);
+
+            const auto xf = random_values<float>(rng, n);
+            const auto yf = random_values<float>(rng, m);
+            assert(max_error(ul::conv_fft(xf, yf), ul::conv_direct(xf, yf)) <
+                   1e-5);
+        }
+    }
+
+    // Integers are exact after rounding.
+    vector<double> x(1000), y(200);
+    for (size_t i = 0; i < x.size(); ++i)
+        x[i] = double(i % 17);
+    for (size_t i = 0; i < y.size(); ++i)
+        y[i] = double(i % 5) - 2;
+    const auto expected = ul::conv_direct(x, y);
+    const auto r = ul::conv(x, y);
+    for (size_t i = 0; i < r.size(); ++i)
+        assert(round(r[i]) == expected[i]);
+
+    // Empty arguments are like conv_direct.
+    assert(ul::conv_fft(vector<double>(), vector<double>(3, 1.0)) ==
+           vector<double>(2, 0.0));
+
+    bool thrown = false;
+    try {
+        double out[4];
+        const double a[3] = {1, 2, 3};
+        ul::conv_fft_into(ul::make_span(a, 3), ul::make_span(a, 3),
+                          ul::make_span(out, 4));
+    } catch (const ul::check_failure&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_fft();
+    test_conv_fft();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
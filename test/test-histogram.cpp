@@ -0,0 +1,126 @@
+#undef NDEBUG
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/histogram.h"
+#include "ul/stopwatch.h"
+
+using ul::LatencyHistogram;
+
+// Relative error of a percentile compared to the exact one.
+double relative_error(int64_t approximate, int64_t exact)
+{
+    return fabs(double(approximate - exact)) /
+           double(std::max<int64_t>(exact, 1));
+}
+
+int64_t exact_percentile(std::vector<int64_t> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    size_t rank = size_t(std::max(1.0, ceil(p / 100 * v.size())));
+    return v[rank - 1];
+}
+
+void test_footprint()
+{
+    LatencyHistogram h;  // 1 ns .. 100 s, 2 digits
+    assert(h.memory_footprint() < 64 * 1024);
+    assert(h.count() == 0);
+    assert(h.percentile(50) == 0);
+    assert(std::isnan(h.mean()));
+}
+
+void test_equivalent_values()
+{
+    LatencyHistogram h(1, 100000000000, 2);
+    // Exact below 256 (sub-bucket count for 2 digits)
+    for (int64_t v = 0; v < 256; ++v) {
+        assert(h.lowest_equivalent_value(v) == v);
+        assert(h.highest_equivalent_value(v) == v);
+    }
+    for (int64_t v = 1; v < 100000000000; v = v * 3 + 1) {
+        const auto lo = h.lowest_equivalent_value(v);
+        const auto hi = h.highest_equivalent_value(v);
+        assert(lo <= v && v <= hi);
+        assert(double(hi - lo) <= 0.01 * double(v));
+    }
+}
+
+void test_percentiles()
+{
+    std::mt19937_64 rng(123);
+    std::lognormal_distribution<double> dist(10, 2);
+    std::vector<int64_t> values;
+    LatencyHistogram h;
+    for (int i = 0; i < 100000; ++i) {
+        auto v = int64_t(dist(rng));
+        values.push_back(v);
+        h.record(v);
+    }
+    assert(h.count() == 100000);
+    assert(h.min() == *std::min_element(values.begin(), values.end()));
+    assert(h.max() == *std::max_element(values.begin(), values.end()));
+    for (double p : {1.0, 10.0, 50.0, 90.0, 99.0, 99.9, 99.99, 100.0}) {
+        assert(relative_error(h.percentile(p), exact_percentile(values, p)) <=
+               0.01);
+    }
+    assert(h.percentile(100) == h.max());
+    auto cdf = h.cdf();
+    assert(!cdf.empty());
+    assert(cdf.back().second == 1.0);
+    for (size_t i = 1; i < cdf.size(); ++i) {
+        assert(cdf[i - 1].first < cdf[i].first);
+        assert(cdf[i - 1].second < cdf[i].second);
+    }
+}
+
+void test_merge()
+{
+    LatencyHistogram a, b, c;
+    for (int64_t v = 1; v < 1000000; v += 7) {
+        (v % 2 ? a : b).record(v);
+        c.record(v);
+    }
+    a.merge(b);
+    assert(a.count() == c.count());
+    assert(a.min() == c.min());
+    assert(a.max() == c.max());
+    for (double p : {0.0, 25.0, 50.0, 75.0, 99.0, 100.0})
+        assert(a.percentile(p) == c.percentile(p));
+    a.reset();
+    assert(a.count() == 0);
+}
+
+void test_saturation_and_durations()
+{
+    LatencyHistogram h(1, 1000000, 3);
+    h.record(2000000);
+    assert(h.saturated_count() == 1);
+    assert(h.max() == 1000000);
+
+    LatencyHistogram d;
+    d.record(std::chrono::microseconds(15));
+    d.record_seconds(0.000015);
+    ul::Stopwatch<> sw(true);
+    d.record_seconds(sw.elapsed());
+    assert(d.count() == 3);
+    assert(d.percentile(100) >= 15000 && d.percentile(100) <= 15000 * 1.01);
+    d.print_cdf(stdout, 1e-3);
+}
+
+int main()
+{
+    test_footprint();
+    test_equivalent_values();
+    test_percentiles();
+    test_merge();
+    test_saturation_and_durations();
+    printf("Done.\n");
+    return 0;
+}
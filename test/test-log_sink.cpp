@@ -0,0 +1,109 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ul/log_sink.h"
+#include "ul/stringf.h"
+
+using ul::LogSink;
+
+std::vector<std::string> read_lines(FILE* f)
+{
+    std::vector<std::string> lines;
+    rewind(f);
+    char buf[4096];
+    while (fgets(buf, sizeof(buf), f)) {
+        auto len = strlen(buf);
+        assert(len > 0 && buf[len - 1] == '\n');
+        lines.emplace_back(buf, len - 1);
+    }
+    return lines;
+}
+
+void test_single_thread()
+{
+    FILE* f = tmpfile();
+    {
+        LogSink sink(f, 16, 16);
+        assert(sink.write("abc"));
+        assert(sink.printf("x = %d", 42));
+        assert(sink.write(ul::stringf("%s-%s", "de", "f")));
+        assert(sink.write("0123456789abcdefghij"));  // truncated
+        sink.flush();
+        auto lines = read_lines(f);
+        assert(lines.size() == 4);
+        assert(lines[0] == "abc");
+        assert(lines[1] == "x = 42");
+        assert(lines[2] == "de-f");
+        assert(lines[3] == "0123456789ab...");
+        assert(sink.dropped_count() == 0);
+    }
+    fclose(f);
+}
+
+void test_multiple_threads()
+{
+    FILE* f = tmpfile();
+    const int c_threads = 8;
+    const int c_messages = 2000;
+    int64_t dropped = 0;
+    {
+        LogSink sink(f, 64);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < c_threads; ++t) {
+            threads.emplace_back([&sink, t]() {
+                for (int i = 0; i < c_messages; ++i)
+                    sink.printf("thread %d message %d", t, i);
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        dropped = sink.dropped_count();
+    }  // destructor flushes
+
+    auto lines = read_lines(f);
+    assert(lines.size() + dropped == c_threads * c_messages);
+    // Messages of a single thread keep their order.
+    std::vector<int> last(c_threads, -1);
+    for (auto& l : lines) {
+        int t, i;
+        assert(sscanf(l.c_str(), "thread %d message %d", &t, &i) == 2);
+        assert(0 <= t && t < c_threads);
+        assert(i > last[t]);
+        last[t] = i;
+    }
+    fclose(f);
+}
+
+void test_drop_when_full()
+{
+    FILE* f = tmpfile();
+    const int c_messages = 10000;
+    int64_t dropped = 0;
+    int accepted = 0;
+    {
+        LogSink sink(f, 2);
+        for (int i = 0; i < c_messages; ++i)
+            accepted += sink.printf("%d", i) ? 1 : 0;
+        dropped = sink.dropped_count();
+    }
+    assert(dropped > 0);
+    assert(accepted + dropped == c_messages);
+    assert(read_lines(f).size() == accepted);
+    fclose(f);
+}
+
+int main()
+{
+    test_single_thread();
+    test_multiple_threads();
+    test_drop_when_full();
+    assert(ul::logf("test-log_sink: %s", "logf works"));
+    printf("Done.\n");
+    return 0;
+}
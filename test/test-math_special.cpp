@@ -109,6 +109,11 @@ void test_polycompose(P& p, Q& q)
 
 template <size_t N>
 using A = std::array<int, N>;
+
+// 1 + (1 + x)^3, at compile time.
+constexpr auto c_composed = polycompose(A<4>{{1, 0, 0, 1}}, A<2>{{1, 1}});
+static_assert(c_composed[0] == 2 && c_composed[1] == 3 &&
+              c_composed[2] == 3 && c_composed[3] == 1);
 template <int N>
 using IV = ul::InlineVector<int, N>;
 using V = std::vector<int>;
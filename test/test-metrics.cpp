@@ -0,0 +1,150 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/metrics.h"
+
+namespace metrics = ul::metrics;
+
+bool contains(const std::string& s, const char* x)
+{
+    return s.find(x) != std::string::npos;
+}
+
+void test_handles()
+{
+    metrics::Registry r;
+    auto& c = r.counter("requests_total", "Requests");
+    assert(&r.counter("requests_total") == &c);
+    c.increment();
+    c.add(41);
+    assert(c.value() == 42);
+
+    auto& g = r.gauge("queue_length");
+    g.set(3);
+    g.add(-1.5);
+    assert(g.value() == 1.5);
+
+    auto& t = r.timer("parse_seconds");
+    t.record(1.0);
+    t.record(std::chrono::milliseconds(500));
+    {
+        metrics::Timer::Scope scope(t);
+    }
+    auto stats = t.statistics();
+    assert(stats.count() == 3);
+    assert(stats.upper() == 1.0);
+    assert(stats.lower() >= 0 && stats.lower() < 0.5);
+
+    bool threw = false;
+    try {
+        r.gauge("requests_total");
+    } catch (const ul::check_failure&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        r.counter("bad name");
+    } catch (const ul::check_failure&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_concurrent_snapshot()
+{
+    metrics::Registry r;
+    auto& c = r.counter("ops_total");
+    auto& t = r.timer("op_seconds");
+    const int c_threads = 4, c_ops = 100000;
+    std::atomic<bool> done{false};
+    int64_t previous = 0;
+    std::thread reader([&]() {
+        // Snapshots taken while writing are monotonic.
+        while (!done.load()) {
+            auto s = r.snapshot();
+            assert(s.counters.size() == 1);
+            assert(s.counters[0].value >= previous);
+            previous = s.counters[0].value;
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int i = 0; i < c_threads; ++i) {
+        writers.emplace_back([&]() {
+            for (int j = 0; j < c_ops; ++j) {
+                c.increment();
+                if (j % 100 == 0)
+                    t.record(1e-6);
+            }
+        });
+    }
+    for (auto& w : writers)
+        w.join();
+    done = true;
+    reader.join();
+
+    auto s = r.snapshot();
+    assert(s.counters[0].value == int64_t(c_threads) * c_ops);
+    assert(s.timers[0].stats.count() == c_threads * c_ops / 100);
+    assert(fabs(s.timers[0].stats.mean() - 1e-6) < 1e-12);
+}
+
+void test_text()
+{
+    metrics::Registry r;
+    r.counter("tokens_split_total", "Tokens produced\nby split").add(7);
+    r.gauge("temperature").set(21.5);
+    r.gauge_fn("check_failures", []() { return 3.0; });
+    r.timer("latency_seconds").record(2);
+    r.timer("latency_seconds").record(4);
+    r.timer("unused_seconds");
+
+    auto text = r.snapshot().to_text();
+    printf("%s", text.c_str());
+    assert(contains(text, "# HELP tokens_split_total Tokens produced\\nby "
+                          "split\n# TYPE tokens_split_total counter\n"
+                          "tokens_split_total 7\n"));
+    assert(contains(text, "# TYPE temperature gauge\ntemperature 21.5\n"));
+    assert(contains(text, "check_failures 3\n"));
+    assert(contains(text, "# TYPE latency_seconds summary\n"));
+    assert(contains(text, "latency_seconds_count 2\n"));
+    assert(contains(text, "latency_seconds_sum 6\n"));
+    assert(contains(text, "# TYPE latency_seconds_mean gauge\n"
+                          "latency_seconds_mean 3\n"));
+    assert(contains(text, "# TYPE latency_seconds_max gauge\n"
+                          "latency_seconds_max 4\n"));
+    assert(contains(text, "unused_seconds_mean NaN\n"));
+    assert(contains(text, "unused_seconds_std NaN\n"));
+
+    const std::string path = "test-metrics.txt";
+    assert(r.write_text_file(path));
+    FILE* f = fopen(path.c_str(), "r");
+    assert(f);
+    std::string read_back;
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        read_back.append(buf, n);
+    fclose(f);
+    remove(path.c_str());
+    assert(read_back == text);
+    assert(!r.write_text_file("nonexistent_dir/x/metrics.txt"));
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_handles();
+    test_concurrent_snapshot();
+    test_text();
+    assert(&metrics::default_registry() == &metrics::default_registry());
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
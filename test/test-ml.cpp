@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cmath>
 #include <numeric>
+#include <random>
 
 #include "ul/ml.h"
 #include "ul/span.h"
@@ -70,8 +72,118 @@ void test_conv()
     test_conv<Z>(x, y);
 }
 
+// Moving window by definition, see moving_mean.
+template <class F>
+vector<double> moving_reference(const vector<double>& x, int window, F f)
+{
+    vector<double> out;
+    const int n = int(x.size());
+    for (int i = 0; i < n; ++i) {
+        const int lo = std::max(0, i - window / 2);
+        const int hi = std::min(n, i + (window - 1) / 2 + 1);
+        out.push_back(f(x.begin() + lo, x.begin() + hi));
+    }
+    return out;
+}
+
+void test_moving()
+{
+    // matlab: movmean([4 8 6 -1 -2 -3 -1 3 4 5], 3), movmax(..., 4)
+    vector<double> x{4, 8, 6, -1, -2, -3, -1, 3, 4, 5};
+    vector<double> out(x.size());
+    ul::moving_mean(ul::as_span(x), 3, ul::as_span(out));
+    vector<double> expected{6, 6, 13 / 3.0, 1, -2, -2, -1 / 3.0, 2, 4, 4.5};
+    for (size_t i = 0; i < x.size(); ++i)
+        assert(fabs(out[i] - expected[i]) < 1e-12);
+    ul::moving_max(ul::as_span(x), 4, ul::as_span(out));
+    assert((out == vector<double>{8, 8, 8, 8, 6, -1, 3, 4, 5, 5}));
+
+    auto mean = [](auto b, auto e) {
+        return std::accumulate(b, e, 0.0) / (e - b);
+    };
+    auto lowest = [](auto b, auto e) { return *std::min_element(b, e); };
+    auto highest = [](auto b, auto e) { return *std::max_element(b, e); };
+    vector<double> y;
+    for (int i = 0; i < 1000; ++i)
+        y.push_back(1e6 + sin(i * 0.1) * 100 + (i % 7));
+    out.resize(y.size());
+    for (int window : {1, 2, 3, 10, 51, 999, 1000, 5000}) {
+        ul::moving_mean(ul::as_span(y), window, ul::as_span(out));
+        auto e = moving_reference(y, window, mean);
+        for (size_t i = 0; i < y.size(); ++i)
+            assert(fabs(out[i] - e[i]) < 1e-8);
+        ul::moving_min(ul::as_span(y), window, ul::as_span(out));
+        assert(out == moving_reference(y, window, lowest));
+        ul::moving_max(ul::as_span(y), window, ul::as_span(out));
+        assert(out == moving_reference(y, window, highest));
+    }
+
+    vector<double> empty;
+    ul::moving_mean(ul::as_span(empty), 3, ul::as_span(empty));
+}
+
+// Coefficients manipulated at compile time.
+constexpr array<double, 3> c_p{{1, 2, 3}};
+constexpr array<double, 2> c_q{{-1, 0.5}};
+constexpr auto c_pq = conv(c_p, c_q);
+constexpr auto c_dpq = polyder(conv(c_p, c_q));
+static_assert(std::is_same<decltype(c_dpq), const array<double, 3>>::value);
+static_assert(c_pq[0] == -1 && c_pq[1] == -1.5 && c_pq[2] == -2 &&
+              c_pq[3] == 1.5);
+static_assert(c_dpq[0] == -1.5 && c_dpq[1] == -4 && c_dpq[2] == 4.5);
+constexpr auto c_ipq = polyint(c_dpq, -1.0);
+static_assert(c_ipq[0] == -1 && c_ipq[1] == -1.5 && c_ipq[2] == -2 &&
+              c_ipq[3] == 1.5);
+static_assert(polyval(c_p, 2.0) == 17 && polyval(c_pq, 2) == 0);
+static_assert(polyval(polyder(array<int, 4>{{4, 3, 2, 1}}), 1) == 10);
+
+template <class T>
+void test_polyval_batch(double eps)
+{
+    std::mt19937 rng{4};
+    std::uniform_real_distribution<double> d(-1.5, 1.5);
+    for (int n : {0, 1, 2, 3, 4, 7, 11, 12, 13, 16, 21, 40}) {
+        vector<double> p(static_cast<size_t>(n));
+        for (auto& c : p)
+            c = d(rng);
+        for (size_t count : {0, 1, 5, 8, 31, 32, 33, 100, 1000}) {
+            vector<T> xs(count), out(count, T(99)), portable(count);
+            for (auto& x : xs)
+                x = T(d(rng));
+            polyval(p, ul::as_span(xs), make_span(out.data(), count));
+            vector<T> pt(p.begin(), p.end());
+            if (n > 0) {
+                ul::detail::polyval_batch_portable(pt.data(), n, xs.data(),
+                                                   portable.data(), count);
+            }
+            double scale = 1;
+            for (double c : p)
+                scale += fabs(c) * pow(1.5, n);
+            for (size_t i = 0; i < count; ++i) {
+                const double expected = polyval(p, double(xs[i]));
+                assert(fabs(double(out[i]) - expected) <= eps * scale);
+                if (n > 0)
+                    assert(fabs(double(portable[i]) - expected) <= eps * scale);
+            }
+        }
+    }
+    vector<T> xs{1, 2}, out(3);
+    bool thrown = false;
+    try {
+        polyval(vector<double>{1, 2}, ul::as_span(xs),
+                make_span(out.data(), out.size()));
+    } catch (const ul::check_failure&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
 int main()
 {
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_polyval_batch<double>(1e-14);
+    test_polyval_batch<float>(1e-6);
+
     array<int, 5> c{{2, -3, -4, 5, 6}};
     for (int x = -3; x <= 3; ++x) {
         auto ya = polyval(make_span(c.data(), 1), x);
@@ -145,6 +257,8 @@ int main()
         assert(fabs(db2mag(20) - 10) < 1e-12);
     }
 
+    test_moving();
+
     printf("Done.\n");
     return 0;
 }
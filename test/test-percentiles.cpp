@@ -0,0 +1,158 @@
+#undef NDEBUG
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/percentiles.h"
+
+using std::vector;
+
+// matlab's prctile, by sorting
+template <class T>
+double reference(vector<T> x, double p)
+{
+    x.erase(std::remove_if(x.begin(), x.end(), [](T v) { return v != v; }),
+            x.end());
+    if (x.empty())
+        return NAN;
+    std::sort(x.begin(), x.end());
+    const size_t n = x.size();
+    double pos = n * p / 100 - 0.5;
+    pos = std::min(std::max(pos, 0.0), double(n - 1));
+    const size_t lo = size_t(pos);
+    const double frac = pos - lo;
+    return frac > 0 ? x[lo] + frac * (double(x[lo + 1]) - x[lo]) : x[lo];
+}
+
+bool same(double a, double b)
+{
+    return a == b || fabs(a - b) <= 1e-12 * fabs(b) ||
+           (std::isnan(a) && std::isnan(b));
+}
+
+const vector<double> c_ps = {0,  0.1, 1,  10, 25,   33.3,
+                             50, 50,  75, 99, 99.9, 100};
+
+vector<double> random_values(size_t n, int distinct)
+{
+    std::mt19937 rng{unsigned(n)};
+    std::uniform_int_distribution<int> dist(0, distinct - 1);
+    vector<double> x(n);
+    for (auto& v : x)
+        v = dist(rng) * 0.25 - 100;
+    return x;
+}
+
+void test_small()
+{
+    // matlab: median([3 1 4 1 5]) = 3, median([3 1 4 1]) = 2
+    assert(ul::median(vector<double>{3, 1, 4, 1, 5}) == 3);
+    assert(ul::median(vector<double>{3, 1, 4, 1}) == 2);
+    assert(ul::median(std::array<int, 4>{{3, 1, 4, 1}}) == 2);
+    assert(ul::median(vector<double>{7}) == 7);
+    assert(std::isnan(ul::median(vector<double>{})));
+    assert(std::isnan(ul::median(vector<double>{NAN, NAN})));
+    assert(ul::median(vector<double>{NAN, 2, 1, NAN, 3}) == 2);
+    // matlab: prctile(1:10, [0 25 50 90 100]) = [1 3 5.5 9.5 10]
+    vector<int> v{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    assert(ul::prctile(v, 0) == 1);
+    assert(ul::prctile(v, 25) == 3);
+    assert(ul::prctile(v, 50) == 5.5);
+    assert(ul::prctile(v, 90) == 9.5);
+    assert(ul::prctile(v, 100) == 10);
+
+    bool threw = false;
+    try {
+        ul::prctile(v, 101);
+    } catch (const ul::check_failure&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_against_sorting()
+{
+    for (size_t n : {1, 2, 3, 10, 100, 1001}) {
+        for (int distinct : {1, 3, 1000000}) {
+            auto x = random_values(n, distinct);
+            if (n > 5)
+                x[n / 3] = NAN;
+            auto r = ul::percentiles(ul::as_span(x), ul::as_span(c_ps));
+            for (size_t j = 0; j < c_ps.size(); ++j)
+                assert(same(r[j], reference(x, c_ps[j])));
+
+            // Scratch versions, and float.
+            vector<double> scratch(n), out(c_ps.size());
+            ul::percentiles(ul::as_span(x), ul::as_span(c_ps),
+                            ul::make_span(out.data(), out.size()),
+                            ul::make_span(scratch.data(), scratch.size()));
+            assert(out == r);
+            assert(same(ul::median(x, ul::make_span(scratch.data(), n)),
+                        reference(x, 50)));
+            assert(same(ul::prctile(ul::as_span(x), 90), reference(x, 90)));
+            vector<float> xf(x.begin(), x.end());
+            assert(same(ul::median(xf), reference(xf, 50)));
+        }
+    }
+}
+
+void test_parallel()
+{
+    const size_t n = ul::detail::c_percentiles_parallel_min_size * 3 + 7;
+    for (int distinct : {1, 5, 1000000}) {
+        auto x = random_values(n, distinct);
+        x[12345] = NAN;
+        const auto expected =
+            ul::percentiles(ul::as_span(x), ul::as_span(c_ps));
+        for (int threads : {1, 3, 0}) {
+            vector<double> out(c_ps.size());
+            ul::percentiles_parallel(ul::as_span(x), ul::as_span(c_ps),
+                                     ul::make_span(out.data(), out.size()),
+                                     threads);
+            for (size_t j = 0; j < c_ps.size(); ++j)
+                assert(same(out[j], expected[j]));
+        }
+        vector<float> xf(x.begin(), x.end());
+        const auto expected_f =
+            ul::percentiles(ul::as_span(xf), ul::as_span(c_ps));
+        vector<double> out(c_ps.size());
+        ul::percentiles_parallel(ul::as_span(xf), ul::as_span(c_ps),
+                                 ul::make_span(out.data(), out.size()), 2);
+        assert(out == expected_f);
+    }
+
+    // Sorted input: the sample still brackets the ranks.
+    vector<double> sorted(n);
+    for (size_t i = 0; i < n; ++i)
+        sorted[i] = double(i);
+    const double p50 = 50;
+    double out;
+    ul::percentiles_parallel(ul::as_span(sorted), ul::make_span(&p50, 1),
+                             ul::make_span(&out, 1), 4);
+    assert(out == ul::median(sorted));
+
+    // All NANs, small input.
+    vector<double> nans(n, NAN);
+    ul::percentiles_parallel(ul::as_span(nans), ul::make_span(&p50, 1),
+                             ul::make_span(&out, 1), 2);
+    assert(std::isnan(out));
+    vector<double> small{1, 2, 3};
+    ul::percentiles_parallel(ul::as_span(small), ul::make_span(&p50, 1),
+                             ul::make_span(&out, 1));
+    assert(out == 2);
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_small();
+    test_against_sorting();
+    test_parallel();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
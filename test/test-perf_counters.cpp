@@ -0,0 +1,121 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "ul/bench.h"
+#include "ul/perf_counters.h"
+
+using ul::PerfCounters;
+using ul::PerfCounts;
+
+double work(int n)
+{
+    std::vector<double> v(n, 1.0);
+    double s = 0;
+    for (int i = 0; i < n; ++i)
+        s += v[i] * v[(i * 7) % n];
+    ul::bench::do_not_optimize(s);
+    return s;
+}
+
+void test_counts_struct()
+{
+    PerfCounts c;
+    for (double x : c.values)
+        assert(std::isnan(x));
+    assert(std::isnan(c.ipc()));
+    assert(c.to_string() == "(no counters)");
+
+    c[ul::perf_cycles] = 200;
+    c[ul::perf_instructions] = 500;
+    assert(c.ipc() == 2.5);
+    auto per_item = c.per_item(100);
+    assert(per_item[ul::perf_cycles] == 2);
+    assert(per_item.ipc() == 2.5);
+    c += c;
+    assert(c[ul::perf_instructions] == 1000);
+    auto s = c.to_string();
+    assert(s.find("cycles=400") != std::string::npos);
+    assert(s.find("IPC=2.500") != std::string::npos);
+    assert(s.find("l1d_misses") == std::string::npos);
+}
+
+void test_counters()
+{
+    PerfCounters pc;
+    printf("available: %d, rdpmc: %d, reason: %s\n", int(pc.available()),
+           int(pc.uses_rdpmc()), pc.unavailable_reason().c_str());
+    assert(pc.available() || !pc.unavailable_reason().empty());
+
+    assert(!pc.running());
+    pc.start();
+    assert(pc.running());
+    work(100000);
+    auto c1 = pc.stop();
+    assert(!pc.running());
+    printf("%s\n", c1.to_string().c_str());
+
+    for (int e = 0; e < ul::c_num_perf_events; ++e) {
+        auto event = ul::PerfEvent(e);
+        if (!pc.available(event)) {
+            assert(std::isnan(c1[event]));
+            continue;
+        }
+        // A counter may be opened but never get scheduled in a VM.
+        if (!std::isnan(c1[event]))
+            assert(c1[event] >= 0);
+    }
+    if (pc.available(ul::perf_instructions) &&
+        !std::isnan(c1[ul::perf_instructions]))
+        assert(c1[ul::perf_instructions] > 100000);
+
+    // Stopped counters don't change, start() resumes.
+    work(100000);
+    auto c2 = pc.counts();
+    for (int e = 0; e < ul::c_num_perf_events; ++e)
+        assert(c2.values[e] == c1.values[e] ||
+               (std::isnan(c2.values[e]) && std::isnan(c1.values[e])));
+    pc.start();
+    work(100000);
+    auto c3 = pc.stop();
+    if (!std::isnan(c3[ul::perf_instructions]))
+        assert(c3[ul::perf_instructions] > c1[ul::perf_instructions]);
+
+    auto c4 = pc.restart();
+    assert(pc.running());
+    assert(c4.values == c3.values || std::isnan(c4[ul::perf_cycles]) ||
+           std::isnan(c3[ul::perf_cycles]) ||
+           c4[ul::perf_cycles] == c3[ul::perf_cycles]);
+    pc.reset();
+    assert(!pc.running());
+    auto c5 = pc.counts();
+    for (int e = 0; e < ul::c_num_perf_events; ++e) {
+        if (pc.available(ul::PerfEvent(e)))
+            assert(c5.values[e] == 0);
+    }
+}
+
+void test_bench_integration()
+{
+    ul::bench::Options o;
+    o.min_time = 0.001;
+    o.warmup_time = 0;
+    o.repetitions = 3;
+    o.perf_counters = true;
+    ul::bench::Runner runner(o);
+    auto r = runner.run("work", []() { work(1000); }, 1000);
+    const bool have_ipc = !std::isnan(r->perf_per_call.ipc());
+    assert(have_ipc == (r->to_json().find("\"ipc\":") != std::string::npos));
+}
+
+int main()
+{
+    test_counts_struct();
+    test_counters();
+    test_bench_integration();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
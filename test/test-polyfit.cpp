@@ -0,0 +1,167 @@
+#undef NDEBUG
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/ml.h"
+#include "ul/polyfit.h"
+
+using std::array;
+using std::vector;
+
+template <class F>
+bool throws(F f)
+{
+    try {
+        f();
+    } catch (const ul::check_failure&) {
+        return true;
+    }
+    return false;
+}
+
+template <int Deg>
+void test_exact(double x0, double dx, double eps)
+{
+    array<double, Deg + 1> p;
+    for (int j = 0; j <= Deg; ++j)
+        p[j] = 1.5 - 0.75 * j;
+    for (int n : {Deg + 1, Deg + 2, 50}) {
+        vector<double> x(n), y(n);
+        for (int i = 0; i < n; ++i) {
+            x[i] = x0 + dx * (i * i % 7 + 1.5 * i);
+            y[i] = ul::polyval(p, x[i]);
+        }
+        const auto q = ul::polyfit<Deg>(x, y);
+        static_assert(
+            std::is_same<decltype(q), const array<double, Deg + 1>>::value);
+        for (int i = 0; i < n; ++i)
+            assert(fabs(ul::polyval(q, x[i]) - y[i]) <= eps * (1 + fabs(y[i])));
+        if (x0 == 0) {
+            for (int j = 0; j <= Deg; ++j)
+                assert(fabs(q[j] - p[j]) <= eps);
+        }
+    }
+}
+
+void test_least_squares()
+{
+    // matlab: polyfit([1 2 3], [2 4 7], 1) = [2.5 -0.6667]
+    const auto p = ul::polyfit<1>(vector<int>{1, 2, 3}, vector<int>{2, 4, 7});
+    assert(fabs(p[0] + 2.0 / 3) < 1e-14 && fabs(p[1] - 2.5) < 1e-14);
+    const auto pf = ul::polyfit<1>(vector<float>{1, 2, 3},
+                                   vector<float>{2, 4, 7});
+    static_assert(std::is_same<decltype(pf), const array<float, 2>>::value);
+    assert(fabs(pf[0] + 2.0 / 3) < 1e-6 && fabs(pf[1] - 2.5) < 1e-6);
+    assert(fabs(ul::polyfit<0>(vector<double>{5, 5},
+                               vector<double>{1, 2})[0] - 1.5) < 1e-15);
+
+    // The residual is orthogonal to the powers of x.
+    std::mt19937 rng{5};
+    std::normal_distribution<double> noise;
+    vector<double> x(40), y(40);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = 0.1 * double(i) - 1;
+        y[i] = cos(x[i]) + noise(rng);
+    }
+    const auto q = ul::polyfit<3>(x, y);
+    for (int j = 0; j <= 3; ++j) {
+        double dot = 0;
+        for (size_t i = 0; i < x.size(); ++i)
+            dot += (y[i] - ul::polyval(q, x[i])) * pow(x[i], j);
+        assert(fabs(dot) < 1e-12);
+    }
+}
+
+template <class T, int Deg>
+void test_windows(double eps)
+{
+    const size_t n = 9;
+    vector<T> x(n);
+    for (size_t i = 0; i < n; ++i)
+        x[i] = T(0.25 * double(i) - 1);
+    ul::Polyfit<Deg, T> fit(x);
+    assert(fit.size() == n);
+
+    std::mt19937 rng{6};
+    std::uniform_real_distribution<double> d(-2, 2);
+    vector<T> y(5000 * 9 + n);
+    for (auto& v : y)
+        v = T(d(rng));
+    using C = array<T, Deg + 1>;
+    for (size_t stride : {1, 2, 3, 9}) {
+        for (size_t count : {0, 1, 7, 8, 21, 5000}) {
+            vector<C> out(count);
+            fit.fit_windows(ul::as_span(y), stride,
+                            ul::make_span(out.data(), count));
+            for (size_t w = 0; w < count; ++w) {
+                const auto expected =
+                    fit.fit(ul::make_span(y.data() + w * stride, n));
+                for (int j = 0; j <= Deg; ++j)
+                    assert(fabs(out[w][j] - expected[j]) <= eps);
+            }
+        }
+    }
+
+    // Back to back.
+    vector<C> out(4);
+    fit.fit_windows(ul::make_span(y.data(), 4 * n),
+                    ul::make_span(out.data(), out.size()));
+    for (size_t w = 0; w < out.size(); ++w) {
+        const auto expected = ul::polyfit<Deg>(
+            x, vector<T>(y.begin() + w * n, y.begin() + (w + 1) * n));
+        for (int j = 0; j <= Deg; ++j)
+            assert(fabs(out[w][j] - expected[j]) <= eps);
+    }
+
+    assert(throws([&] {
+        fit.fit_windows(ul::make_span(y.data(), 4 * n + 1),
+                        ul::make_span(out.data(), out.size()));
+    }));
+    assert(throws([&] {
+        fit.fit_windows(ul::make_span(y.data(), 3 * 2 + n - 1), 2,
+                        ul::make_span(out.data(), out.size()));
+    }));
+    assert(throws([&] {
+        fit.fit_windows(ul::as_span(y), 0,
+                        ul::make_span(out.data(), out.size()));
+    }));
+}
+
+void test_errors()
+{
+    assert(throws([] {
+        ul::polyfit<2>(vector<double>{1, 2}, vector<double>{1, 2});
+    }));
+    assert(throws([] {
+        ul::polyfit<2>(vector<double>{1, 2, 1, 2}, vector<double>{1, 2, 3, 4});
+    }));
+    assert(throws([] {
+        ul::polyfit<1>(vector<double>{1, 2, 3}, vector<double>{1, 2});
+    }));
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_exact<0>(0, 1, 1e-14);
+    test_exact<1>(0, 0.1, 1e-13);
+    test_exact<2>(0, 0.1, 1e-12);
+    test_exact<3>(0, 0.1, 1e-12);
+    test_exact<5>(0, 0.1, 1e-10);
+    // Ill conditioned in the powers of x.
+    test_exact<2>(1e4, 1, 1e-8);
+    test_exact<3>(-5, 0.1, 1e-9);
+    test_least_squares();
+    test_windows<double, 1>(1e-12);
+    test_windows<double, 3>(1e-12);
+    test_windows<float, 2>(1e-4);
+    test_errors();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+// Compiled with UL_PROFILE, see CMakeLists.txt
+
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "ul/profiler.h"
+
+using std::chrono::milliseconds;
+using std::this_thread::sleep_for;
+
+using ul::ProfileZoneReport;
+using ul::Profiler;
+
+const ProfileZoneReport& find_zone(const std::vector<ProfileZoneReport>& r,
+                                   const char* name)
+{
+    for (auto& z : r) {
+        if (strcmp(z.name, name) == 0)
+            return z;
+    }
+    assert(false);
+    return r.front();
+}
+
+void inner()
+{
+    UL_PROFILE_ZONE("inner");
+    sleep_for(milliseconds(10));
+}
+
+void outer()
+{
+    UL_PROFILE_ZONE("outer");
+    sleep_for(milliseconds(10));
+    inner();
+    inner();
+}
+
+void test_nested()
+{
+    Profiler::reset();
+    outer();
+    auto r = Profiler::report();
+    auto& o = find_zone(r, "outer");
+    auto& i = find_zone(r, "inner");
+    assert(o.inclusive.count() == 1);
+    assert(i.inclusive.count() == 2);
+    assert(i.exclusive.count() == 2);
+    // Sleeps last at least as long as asked, maybe much longer on a loaded
+    // machine.
+    assert(o.inclusive.sum() >= 0.030);
+    assert(o.exclusive.sum() >= 0.010);
+    assert(fabs(o.inclusive.sum() -
+                (o.exclusive.sum() + i.inclusive.sum())) < 1e-6);
+    // inner has no children
+    assert(fabs(i.inclusive.sum() - i.exclusive.sum()) < 1e-9);
+    assert(i.inclusive.lower() >= 0.010);
+    assert(o.inclusive.sum() > i.inclusive.sum());
+    // sorted by decreasing inclusive time
+    assert(&r[0] == &o);
+}
+
+void test_threads()
+{
+    Profiler::reset();
+    const int c_threads = 4;
+    const int c_iterations = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < c_threads; ++t) {
+        threads.emplace_back([]() {
+            for (int k = 0; k < c_iterations; ++k) {
+                UL_PROFILE_ZONE("thread loop");
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    auto r = Profiler::report();
+    auto& z = find_zone(r, "thread loop");
+    assert(z.inclusive.count() == c_threads * c_iterations);
+    assert(z.inclusive.lower() >= 0);
+    // Finished threads are still reported.
+    assert(find_zone(Profiler::report(), "thread loop").inclusive.count() ==
+           c_threads * c_iterations);
+    Profiler::reset();
+    for (auto& z : Profiler::report())
+        assert(strcmp(z.name, "thread loop") != 0);
+}
+
+void test_accumulator_variance()
+{
+    // Long zones with a small spread: the sum of squares would be ~1e24 and
+    // cancel the variance of ~1 tick^2 completely.
+    const int64_t base = int64_t(1e12);
+    ul::detail::ProfileAccumulator a, b, total;
+    for (int k = 0; k < 1000; ++k)
+        (k % 2 ? a : b).add(base + k % 3);
+    a.merge_into(total);
+    b.merge_into(total);
+    auto s = total.to_statistics(1);
+    assert(s.count() == 1000);
+    assert(fabs(s.mean() - double(base) - 0.999) < 1e-3);
+    assert(fabs(s.var() - 0.667) < 1e-3);
+    assert(s.lower() == double(base) && s.upper() == double(base + 2));
+}
+
+int main()
+{
+    test_accumulator_variance();
+    test_nested();
+    test_threads();
+    outer();
+    Profiler::print_report();
+    printf("Done.\n");
+    return 0;
+}
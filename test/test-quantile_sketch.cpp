@@ -0,0 +1,276 @@
+#undef NDEBUG
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ul/math.h"
+#include "ul/quantile_sketch.h"
+
+using ul::QuantileSketch;
+
+// Rank of `x` in sorted `v`, in [0, 1].
+double exact_rank(const std::vector<double>& sorted, double x)
+{
+    auto lo = std::lower_bound(sorted.begin(), sorted.end(), x);
+    auto hi = std::upper_bound(sorted.begin(), sorted.end(), x);
+    return (double(lo - sorted.begin()) + double(hi - sorted.begin())) / 2 /
+           double(sorted.size());
+}
+
+// Worst rank error of the quantiles, relative to the allowed q(1-q) scale.
+void check_accuracy(const QuantileSketch& s,
+                    std::vector<double> xs,
+                    double compression)
+{
+    std::sort(xs.begin(), xs.end());
+    assert(s.lower() == xs.front() && s.upper() == xs.back());
+    for (double q : {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999}) {
+        const double rank = exact_rank(xs, s.quantile(q));
+        const double error = fabs(rank - q);
+        // Generous bound on the error of the arcsine scale.
+        const double allowed = 4 * sqrt(q * (1 - q)) / compression + 1e-4;
+        if (error > allowed)
+            printf("q=%g rank=%g error=%g allowed=%g\n", q, rank, error,
+                   allowed);
+        assert(error <= allowed);
+
+        const double c = s.cdf(xs[size_t(q * xs.size())]);
+        assert(fabs(c - q) <= allowed + 1.0 / xs.size());
+    }
+}
+
+std::vector<double> make_data(int n, int distribution, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<double> xs(n);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::lognormal_distribution<double> lognormal(0, 1);
+    std::exponential_distribution<double> exponential(1);
+    for (auto& x : xs) {
+        switch (distribution) {
+            case 0:
+                x = uniform(rng);
+                break;
+            case 1:
+                x = 1e6 * lognormal(rng);  // latency-like, heavy tail
+                break;
+            default:
+                x = exponential(rng);
+        }
+    }
+    return xs;
+}
+
+void test_empty_and_small()
+{
+    QuantileSketch s;
+    assert(s.count() == 0);
+    assert(std::isnan(s.quantile(0.5)) && std::isnan(s.cdf(0)));
+    assert(std::isnan(s.lower()) && std::isnan(s.upper()));
+
+    s.add(3);
+    s.add(NAN);
+    assert(s.count() == 1);
+    assert(s.quantile(0) == 3 && s.quantile(0.5) == 3 && s.quantile(1) == 3);
+    assert(s.cdf(2.9) == 0 && s.cdf(3) == 1);
+
+    for (double x : {1, 2, 4, 5})
+        s.add(x);
+    assert(s.count() == 5);
+    assert(s.quantile(0) == 1 && s.quantile(1) == 5);
+    assert(s.quantile(0.5) == 3);
+    assert(s.cdf(0) == 0 && s.cdf(5) == 1);
+    double previous = 0;
+    for (double x = 1; x <= 5; x += 0.25) {
+        const double c = s.cdf(x);
+        assert(c >= previous);
+        previous = c;
+    }
+
+    s.reset();
+    assert(s.count() == 0 && std::isnan(s.quantile(0.5)));
+}
+
+void test_accuracy()
+{
+    const double compression = 100;
+    for (int distribution = 0; distribution < 3; ++distribution) {
+        auto xs = make_data(200000, distribution, distribution + 1);
+        QuantileSketch s(compression);
+        for (double x : xs)
+            s.add(x);
+        assert(s.count() == 200000);
+        printf("distribution %d: %d centroids\n", distribution,
+               int(s.centroids().size()));
+        assert(s.centroids().size() <= size_t(compression));
+        check_accuracy(s, xs, compression);
+
+        // Quantiles are monotonic
+        double previous = -INFINITY;
+        for (double q = 0; q <= 1; q += 0.001) {
+            const double x = s.quantile(q);
+            assert(x >= previous);
+            previous = x;
+        }
+    }
+}
+
+void test_sorted_input()
+{
+    std::vector<double> xs(100000);
+    for (size_t i = 0; i < xs.size(); ++i)
+        xs[i] = double(i);
+    QuantileSketch s;
+    s.add(ul::as_span(xs));
+    check_accuracy(s, xs, 100);
+    std::reverse(xs.begin(), xs.end());
+    QuantileSketch r;
+    r.add(ul::as_span(xs));
+    check_accuracy(r, xs, 100);
+}
+
+void test_merge()
+{
+    auto xs = make_data(100000, 1, 7);
+    std::vector<QuantileSketch> shards(8);
+    for (size_t i = 0; i < xs.size(); ++i)
+        shards[i % 8].add(xs[i]);
+    QuantileSketch total;
+    for (auto& s : shards)
+        total.merge(s);
+    total.merge(QuantileSketch());
+    assert(total.count() == 100000);
+    check_accuracy(total, xs, 100);
+
+    // Merging into a sketch with buffered values
+    QuantileSketch partial;
+    partial.add(xs[0]);
+    QuantileSketch rest;
+    rest.add(ul::span<const double>(xs.data() + 1, xs.size() - 1));
+    partial.merge(rest);
+    check_accuracy(partial, xs, 100);
+}
+
+// Overwrites the little-endian double at bytes[pos].
+void put_f64_at(std::vector<uint8_t>& bytes, size_t pos, double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof u);
+    for (int i = 0; i < 8; ++i)
+        bytes[pos + size_t(i)] = uint8_t(u >> (8 * i));
+}
+
+void test_serialize()
+{
+    auto xs = make_data(50000, 2, 11);
+    QuantileSketch s(200);
+    std::vector<float> xf(xs.begin(), xs.end());
+    s.add(ul::as_span(xf));
+    auto bytes = s.serialize();
+    printf("serialized %d centroids in %d bytes\n", int(s.centroids().size()),
+           int(bytes.size()));
+    assert(bytes.size() < 12 * s.centroids().size() + 64);
+
+    QuantileSketch t;
+    assert(QuantileSketch::deserialize(ul::as_span(bytes), t));
+    assert(t.count() == s.count() && t.compression() == 200);
+    assert(t.lower() == s.lower() && t.upper() == s.upper());
+    for (double q : {0.01, 0.5, 0.99})
+        assert(t.quantile(q) == s.quantile(q));
+    assert(t.serialize() == bytes);
+
+    // Corrupt input
+    for (size_t n : {size_t(0), size_t(4), size_t(20), bytes.size() - 1}) {
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + n);
+        assert(!QuantileSketch::deserialize(ul::as_span(truncated), t));
+    }
+    auto bad_magic = bytes;
+    bad_magic[0] = 'X';
+    assert(!QuantileSketch::deserialize(ul::as_span(bad_magic), t));
+    // Compression out of range, as a double after the version byte.
+    auto with_compression = [&](double compression) {
+        auto b = bytes;
+        put_f64_at(b, 5, compression);
+        return b;
+    };
+    assert(QuantileSketch::deserialize(
+        ul::as_span(with_compression(QuantileSketch::c_max_compression)), t));
+    for (double c : {1e300, double(INFINITY), double(NAN), 9.0}) {
+        assert(!QuantileSketch::deserialize(ul::as_span(with_compression(c)),
+                                            t));
+    }
+    // Bounds: min and max swapped, or the centroids outside.
+    auto with_bounds = [&](double lower, double upper) {
+        auto b = bytes;
+        put_f64_at(b, 5 + 16, lower);
+        put_f64_at(b, 5 + 24, upper);
+        return b;
+    };
+    assert(!QuantileSketch::deserialize(
+        ul::as_span(with_bounds(s.upper(), s.lower())), t));
+    const double first = s.centroids().front().mean;
+    const double last = s.centroids().back().mean;
+    assert(!QuantileSketch::deserialize(
+        ul::as_span(with_bounds(std::nextafter(first, INFINITY), s.upper())),
+        t));
+    assert(!QuantileSketch::deserialize(
+        ul::as_span(with_bounds(s.lower(), std::nextafter(last, -INFINITY))),
+        t));
+    assert(!QuantileSketch::deserialize(ul::as_span(with_bounds(NAN, NAN)),
+                                        t));
+    assert(t.count() == s.count());  // unchanged on failure
+    // Weights that overflow the total: two centroids of weight 2^63 - 1 and
+    // count 2^63 - 1.
+    QuantileSketch two;
+    two.add(1.0);
+    two.add(2.0);
+    auto two_bytes = two.serialize();
+    assert(two.centroids().size() == 2 && two_bytes.size() == 56);
+    auto put_huge = [](std::vector<uint8_t>& b) {
+        for (int i = 0; i < 8; ++i)
+            b.push_back(0xff);
+        b.push_back(0x7f);
+    };
+    std::vector<uint8_t> huge(two_bytes.begin(), two_bytes.begin() + 46);
+    for (int i = 0; i < 8; ++i)
+        huge[13 + size_t(i)] = i < 7 ? 0xff : 0x7f;
+    put_huge(huge);
+    huge.insert(huge.end(), two_bytes.begin() + 47, two_bytes.begin() + 55);
+    put_huge(huge);
+    assert(!QuantileSketch::deserialize(ul::as_span(huge), t));
+
+    // Empty sketch
+    QuantileSketch empty;
+    QuantileSketch u;
+    assert(QuantileSketch::deserialize(ul::as_span(empty.serialize()), u));
+    assert(u.count() == 0 && std::isnan(u.lower()));
+}
+
+void test_with_statistics()
+{
+    // Same add() interface
+    auto xs = make_data(1000, 0, 5);
+    ul::Statistics stats;
+    QuantileSketch sketch;
+    stats.add(ul::as_span(xs));
+    sketch.add(ul::as_span(xs));
+    assert(stats.count64() == sketch.count64());
+    assert(stats.lower() == sketch.lower() && stats.upper() == sketch.upper());
+}
+
+int main()
+{
+    test_empty_and_small();
+    test_accuracy();
+    test_sorted_input();
+    test_merge();
+    test_serialize();
+    test_with_statistics();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,278 @@
+#undef NDEBUG
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/ml.h"
+#include "ul/roots.h"
+
+using std::vector;
+using complex = std::complex<double>;
+
+// Coefficients of prod (x - r), ascending, real for conjugate pairs.
+vector<double> poly_from_roots(const vector<complex>& rs)
+{
+    vector<complex> p{1};
+    for (const complex r : rs) {
+        vector<complex> q(p.size() + 1);
+        for (size_t i = 0; i < p.size(); ++i) {
+            q[i] -= r * p[i];
+            q[i + 1] += p[i];
+        }
+        p = q;
+    }
+    vector<double> result;
+    for (const complex c : p)
+        result.push_back(c.real());
+    return result;
+}
+
+// Each expected root matches a different found one within tol.
+bool same_roots(vector<complex> found, const vector<complex>& expected,
+                double tol)
+{
+    if (found.size() != expected.size())
+        return false;
+    for (const complex e : expected) {
+        auto best = std::min_element(
+            found.begin(), found.end(), [e](complex a, complex b) {
+                return std::abs(a - e) < std::abs(b - e);
+            });
+        if (!(std::abs(*best - e) <= tol * (1 + std::abs(e))))
+            return false;
+        found.erase(best);
+    }
+    return true;
+}
+
+void test_closed_forms()
+{
+    assert(same_roots(ul::roots(vector<double>{-4, 2}), {2}, 0));
+    assert(same_roots(ul::roots(vector<double>{2, -3, 1}), {1, 2}, 1e-15));
+    assert(same_roots(ul::roots(vector<double>{1, 0, 1}),
+                      {complex(0, 1), complex(0, -1)}, 1e-15));
+    assert(ul::roots(vector<double>{1, -2, 1}) == (vector<complex>{1, 1}));
+    // The example of roots.h.
+    assert(same_roots(ul::roots(std::array<int, 4>{{-6, 11, -6, 1}}),
+                      {1, 2, 3}, 1e-15));
+    const double h = sqrt(3) / 2;
+    assert(same_roots(ul::roots(vector<double>{-1, 0, 0, 1}),
+                      {1, complex(-0.5, h), complex(-0.5, -h)}, 1e-15));
+    assert(same_roots(ul::roots(poly_from_roots({2, 2, 2})), {2, 2, 2},
+                      1e-15));
+    assert(same_roots(ul::roots(poly_from_roots({1, 1, -3})), {1, 1, -3},
+                      1e-15));
+    assert(same_roots(ul::roots(poly_from_roots({1e-3, 1, 1e3})),
+                      {1e-3, 1, 1e3}, 1e-14));
+    assert(same_roots(ul::roots(vector<float>{2, -3, 1}), {1, 2}, 1e-15));
+
+    // Zero roots and leading zeros.
+    assert(same_roots(ul::roots(vector<double>{0, 0, 2, 1, 0}), {0, 0, -2},
+                      0));
+    assert(ul::roots(vector<double>{0, 0, 0}).empty());
+    assert(ul::roots(vector<double>{5}).empty());
+    assert(ul::roots(vector<double>{}).empty());
+}
+
+vector<complex> random_roots(std::mt19937& rng, int degree)
+{
+    std::uniform_real_distribution<double> d(-3, 3);
+    vector<complex> rs;
+    while (int(rs.size()) + 2 <= degree && d(rng) > 0) {
+        const complex z(d(rng), d(rng) / 2 + 0.5);
+        rs.push_back(z);
+        rs.push_back(std::conj(z));
+    }
+    while (int(rs.size()) < degree)
+        rs.push_back(d(rng));
+    return rs;
+}
+
+void test_aberth()
+{
+    std::mt19937 rng{7};
+    for (int degree = 4; degree <= 12; ++degree) {
+        for (int rep = 0; rep < 20; ++rep) {
+            const auto rs = random_roots(rng, degree);
+            const auto p = poly_from_roots(rs);
+            assert(same_roots(ul::roots(p), rs, 1e-7));
+            // Scaled, with zero roots.
+            vector<double> q(2, 0.0);
+            for (double c : p)
+                q.push_back(c * 1e3);
+            auto rs0 = rs;
+            rs0.push_back(0);
+            rs0.push_back(0);
+            assert(same_roots(ul::roots(q), rs0, 1e-7));
+        }
+    }
+    // Multiple roots converge linearly, to about sqrt(DBL_EPSILON).
+    assert(same_roots(ul::roots(poly_from_roots({1, 1, -2, 3, complex(0, 1),
+                                                 complex(0, -1)})),
+                      {1, 1, -2, 3, complex(0, 1), complex(0, -1)}, 1e-6));
+    // Real roots come out real.
+    for (const complex z : ul::roots(poly_from_roots({1, 2, 3, 4, 5})))
+        assert(z.imag() == 0);
+    // Wide range of magnitudes.
+    assert(same_roots(ul::roots(poly_from_roots({1e-4, 1e-2, 1, 1e2, 1e4})),
+                      {1e-4, 1e-2, 1, 1e2, 1e4}, 1e-10));
+}
+
+void test_real_roots_in()
+{
+    // Extrema of (x^2 - 1)(x^2 - 4) = 4 - 5 x^2 + x^4.
+    const std::array<double, 5> p = {{4, 0, -5, 0, 1}};
+    const auto extrema = ul::real_roots_in(ul::polyder(p), -10, 10);
+    assert(extrema.size() == 3);
+    assert(fabs(extrema[0] + sqrt(2.5)) < 1e-15 && extrema[1] == 0 &&
+           fabs(extrema[2] - sqrt(2.5)) < 1e-15);
+
+    // Sturm sequences from degree 4, the ends of the interval are included.
+    assert(ul::real_roots_in(p, -1.5, 3) == (vector<double>{-1, 1, 2}));
+    assert(ul::real_roots_in(p, 1, 2) == (vector<double>{1, 2}));
+    assert(ul::real_roots_in(p, 2, 2) == (vector<double>{2}));
+    assert(ul::real_roots_in(p, -0.5, 0.5).empty());
+    assert(ul::real_roots_in(vector<double>{1, 0, 1, 0, 1}, -9, 9).empty());
+
+    // Multiple roots are found once.
+    auto r = ul::real_roots_in(
+        poly_from_roots({1, 1, -2, 3, complex(0, 1), complex(0, -1)}), -5, 5);
+    assert(r.size() == 3);
+    assert(fabs(r[0] + 2) < 1e-12 && fabs(r[1] - 1) < 1e-7 &&
+           fabs(r[2] - 3) < 1e-12);
+    r = ul::real_roots_in(poly_from_roots({0.5, 0.5, 0.5, -1, 2}), -5, 5);
+    assert(r.size() == 3 && fabs(r[1] - 0.5) < 1e-5);
+    r = ul::real_roots_in(poly_from_roots({1, 1, -3}), -5, 5);
+    assert(r == (vector<double>{-3, 1}));
+    r = ul::real_roots_in(vector<double>{0, 0, 1, 1}, -5, 5);
+    assert(r == (vector<double>{-1, 0}));
+
+    // Integer roots on the ends and on the bisection midpoints, where p
+    // doesn't evaluate exactly to 0.
+    const auto q = poly_from_roots({-1, 0.5, 2, 3, 7});
+    assert(ul::real_roots_in(q, 0, 4) == (vector<double>{0.5, 2, 3}));
+    assert(ul::real_roots_in(q, -2, 8) == (vector<double>{-1, 0.5, 2, 3, 7}));
+    assert(ul::real_roots_in(q, -1, 7) == (vector<double>{-1, 0.5, 2, 3, 7}));
+    assert(ul::real_roots_in(q, 2.375, 3) == (vector<double>{3}));
+    assert(ul::real_roots_in(q, 1.75, 3) == (vector<double>{2, 3}));
+    assert(ul::real_roots_in(q, 3, 3) == (vector<double>{3}));
+    assert(ul::real_roots_in(q, 3.5, 6).empty());
+    std::mt19937 int_rng{10};
+    std::uniform_int_distribution<int> int_root(-6, 6);
+    for (int rep = 0; rep < 200; ++rep) {
+        vector<complex> rs;
+        vector<double> expected;
+        while (rs.size() < 6) {
+            const int r = int_root(int_rng);
+            if (std::find(expected.begin(), expected.end(), r) ==
+                expected.end()) {
+                rs.push_back(r);
+                expected.push_back(r);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        const double lo = expected[1], hi = expected[4];
+        const vector<double> inside(expected.begin() + 1,
+                                    expected.begin() + 5);
+        // Exact on the ends, within rounding inside.
+        const auto found = ul::real_roots_in(poly_from_roots(rs), lo, hi);
+        assert(found.size() == 4 && found[0] == lo && found[3] == hi);
+        assert(fabs(found[1] - inside[1]) < 1e-12 &&
+               fabs(found[2] - inside[2]) < 1e-12);
+        const auto all = ul::real_roots_in(poly_from_roots(rs), -8, 8);
+        assert(all.size() == expected.size());
+        for (size_t i = 0; i < all.size(); ++i)
+            assert(fabs(all[i] - expected[i]) < 1e-12);
+    }
+
+    // Against the roots of random polynomials.
+    std::mt19937 rng{8};
+    for (int degree = 1; degree <= 10; ++degree) {
+        for (int rep = 0; rep < 50; ++rep) {
+            const auto rs = random_roots(rng, degree);
+            vector<double> expected;
+            for (const complex z : rs) {
+                if (z.imag() == 0 && fabs(z.real()) <= 2)
+                    expected.push_back(z.real());
+            }
+            std::sort(expected.begin(), expected.end());
+            bool separated = true;
+            for (const complex z : rs) {
+                separated = separated && fabs(fabs(z.real()) - 2) > 1e-3;
+                for (const complex w : rs)
+                    separated =
+                        separated && (z == w || std::abs(z - w) > 1e-3);
+            }
+            if (!separated)
+                continue;
+            const auto found = ul::real_roots_in(poly_from_roots(rs), -2, 2);
+            assert(found.size() == expected.size());
+            // Clusters of roots are ill conditioned.
+            for (size_t i = 0; i < found.size(); ++i)
+                assert(fabs(found[i] - expected[i]) < 1e-7);
+        }
+    }
+
+    bool thrown = false;
+    try {
+        ul::real_roots_in(p, 1, 0);
+    } catch (const ul::check_failure&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_batch()
+{
+    std::mt19937 rng{9};
+    std::uniform_real_distribution<double> d(-2, 2);
+    for (int degree : {0, 1, 2, 3, 5}) {
+        const size_t n = size_t(degree) + 1, count = 100;
+        vector<double> ps(count * n);
+        for (auto& c : ps)
+            c = d(rng);
+        ps[n - 1] = 0;  // lower degree
+        vector<complex> out(count * size_t(degree));
+        ul::roots_batch(ul::as_span(ps), degree,
+                        ul::make_span(out.data(), out.size()));
+        vector<double> real_out(out.size());
+        vector<int> counts(count);
+        ul::real_roots_in_batch(ul::as_span(ps), degree, -1, 1.5,
+                                ul::make_span(real_out.data(), out.size()),
+                                ul::make_span(counts.data(), count));
+        for (size_t k = 0; k < count; ++k) {
+            const vector<double> p(ps.begin() + k * n,
+                                   ps.begin() + (k + 1) * n);
+            const auto single = ul::roots(p);
+            for (size_t i = 0; i < size_t(degree); ++i) {
+                const complex z = out[k * size_t(degree) + i];
+                if (i < single.size())
+                    assert(z == single[i]);
+                else
+                    assert(std::isnan(z.real()));
+            }
+            const auto real_single = ul::real_roots_in(p, -1, 1.5);
+            assert(size_t(counts[k]) == real_single.size());
+            for (size_t i = 0; i < real_single.size(); ++i)
+                assert(real_out[k * size_t(degree) + i] == real_single[i]);
+        }
+    }
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_closed_forms();
+    test_aberth();
+    test_real_roots_in();
+    test_batch();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
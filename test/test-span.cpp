@@ -1,5 +1,6 @@
 #include <array>
 
+#define UL_DONT_DEFINE_PLAIN_CHECK
 #include "simple_test.hpp"
 #include "ul/span.h"
 
@@ -0,0 +1,228 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/cpu.h"
+#include "ul/math.h"
+
+using ul::Statistics;
+
+// Two-pass reference in long double
+struct Exact
+{
+    long double mean, var;
+};
+
+Exact exact(const std::vector<double>& xs)
+{
+    long double sum = 0;
+    for (double x : xs)
+        sum += x;
+    const long double mean = sum / xs.size();
+    long double m2 = 0;
+    for (double x : xs)
+        m2 += (x - mean) * (x - mean);
+    return {mean, m2 / xs.size()};
+}
+
+double relative_error(double x, long double reference)
+{
+    return double(fabsl(x - reference) / fabsl(reference));
+}
+
+Statistics make(const std::vector<double>& xs, size_t b, size_t e)
+{
+    Statistics s;
+    for (size_t i = b; i < e; ++i)
+        s.add(xs[i]);
+    return s;
+}
+
+void test_basic()
+{
+    Statistics s;
+    assert(s.count() == 0);
+    assert(std::isnan(s.mean()) && std::isnan(s.std()) && std::isnan(s.var()));
+    assert(std::isnan(s.lower()) && std::isnan(s.upper()));
+    assert(s.sum() == 0 && s.sum2() == 0);
+
+    for (double x : {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0})
+        s.add(x);
+    s.add(NAN);
+    assert(s.count() == 8);
+    assert(s.mean() == 5);
+    assert(s.var() == 4 && s.std() == 2);
+    assert(fabs(s.var_sample() - 32.0 / 7) < 1e-14);
+    assert(s.sum() == 40);
+    assert(s.sum2() == 232);
+    assert(s.m2() == 32);
+    assert(s.lower() == 2 && s.upper() == 9);
+
+    Statistics one;
+    one.add(3);
+    assert(one.var() == 0 && std::isnan(one.var_sample()));
+
+    s.reset();
+    assert(s.count() == 0 && std::isnan(s.mean()) && std::isnan(s.std()));
+
+    auto from_sums = Statistics::from_sums(8, 40, 232, 2, 9);
+    assert(from_sums.mean() == 5 && from_sums.var() == 4);
+    auto from_moments = Statistics::from_moments(8, 5, 32, 2, 9);
+    assert(from_moments.mean() == 5 && from_moments.var() == 4);
+    assert(Statistics::from_sums(0, 0, 0, NAN, NAN).count() == 0);
+}
+
+// Large mean, small variance: the naive sum/sum2 formula loses all digits.
+void test_accuracy()
+{
+    std::mt19937_64 rng(1);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<double> xs(1000000);
+    for (auto& x : xs)
+        x = 1e9 + dist(rng);  // e.g. ns timestamps with 1 ns jitter
+
+    auto reference = exact(xs);
+    auto s = make(xs, 0, xs.size());
+    printf("mean error %g, var error %g\n",
+           relative_error(s.mean(), reference.mean),
+           relative_error(s.var(), reference.var));
+    assert(relative_error(s.mean(), reference.mean) < 1e-12);
+    assert(relative_error(s.var(), reference.var) < 1e-6);
+
+    // What the previous sum/sum2 implementation computed
+    long double sum = 0, sum2 = 0;
+    double dsum = 0, dsum2 = 0;
+    for (double x : xs) {
+        dsum += x;
+        dsum2 += x * x;
+    }
+    sum = dsum;
+    sum2 = dsum2;
+    const double n = double(xs.size());
+    const double naive_var = double((n * sum2 - sum * sum) / (n * n));
+    printf("naive var error %g\n", relative_error(naive_var, reference.var));
+    assert(relative_error(naive_var, reference.var) > 1e-2);
+}
+
+void test_merge()
+{
+    std::mt19937_64 rng(2);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::vector<double> xs(100003);
+    for (auto& x : xs)
+        x = 1e6 + 1e-3 * dist(rng);
+    auto reference = exact(xs);
+    auto sequential = make(xs, 0, xs.size());
+
+    // Uneven shards, including empty ones.
+    for (size_t num_shards : {1, 2, 7, 64, 1000}) {
+        Statistics total;
+        size_t b = 0;
+        for (size_t i = 0; i < num_shards; ++i) {
+            const size_t e = i + 1 == num_shards
+                                 ? xs.size()
+                                 : std::min(xs.size(), b + (i % 3) * xs.size() /
+                                                               num_shards);
+            total.merge(make(xs, b, e));
+            b = e;
+        }
+        assert(total.count() == sequential.count());
+        assert(relative_error(total.mean(), reference.mean) < 1e-12);
+        assert(relative_error(total.var(), reference.var) < 1e-6);
+        assert(total.lower() == sequential.lower());
+        assert(total.upper() == sequential.upper());
+    }
+
+    // Merging into/from empty
+    Statistics empty, a = make(xs, 0, 10);
+    Statistics c = a;
+    c.merge(empty);
+    assert(c.count() == 10 && c.mean() == a.mean() && c.m2() == a.m2());
+    empty.merge(a);
+    assert(empty.count() == 10 && empty.mean() == a.mean());
+}
+
+bool close(double x, double y, double tolerance)
+{
+    if (std::isnan(x) || std::isnan(y))
+        return std::isnan(x) && std::isnan(y);
+    return fabs(x - y) <= tolerance * std::max(1.0, fabs(y));
+}
+
+void check_same(const Statistics& x, const Statistics& y)
+{
+    assert(x.count64() == y.count64());
+    assert(x.lower() == y.lower() ||
+           (std::isnan(x.lower()) && std::isnan(y.lower())));
+    assert(x.upper() == y.upper() ||
+           (std::isnan(x.upper()) && std::isnan(y.upper())));
+    assert(close(x.mean(), y.mean(), 1e-13));
+    assert(close(x.var(), y.var(), 1e-9));
+}
+
+template <class T>
+void test_batch_add_type()
+{
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> dist(-1, 1);
+    for (size_t n : {0, 1, 3, 7, 8, 9, 17, 1023, 1024, 1025, 5000}) {
+        for (double offset : {0.0, 1e6}) {
+            std::vector<T> xs(n);
+            for (size_t i = 0; i < n; ++i)
+                xs[i] = T(offset + dist(rng));
+            // Some NANs, also in the SIMD body and the tails.
+            for (size_t i = 5; i < n; i += 11)
+                xs[i] = T(NAN);
+
+            Statistics scalar;
+            for (T x : xs)
+                scalar.add(double(x));
+            Statistics batch;
+            batch.add(ul::span<const T>(xs.data(), xs.size()));
+            check_same(batch, scalar);
+
+            check_same(ul::detail::block_statistics(xs.data(), n),
+                       ul::detail::block_statistics_portable(xs.data(), n));
+
+            // Appending a batch to existing values
+            Statistics mixed;
+            for (size_t i = 0; i < n / 2; ++i)
+                mixed.add(double(xs[i]));
+            mixed.add(ul::span<const T>(xs.data() + n / 2, n - n / 2));
+            check_same(mixed, scalar);
+        }
+    }
+
+    // Only NANs
+    std::vector<T> nans(10, T(NAN));
+    Statistics s;
+    s.add(ul::span<const T>(nans.data(), nans.size()));
+    assert(s.count() == 0 && std::isnan(s.lower()));
+}
+
+void test_batch_add()
+{
+    printf("avx2: %d, fma: %d\n", int(ul::cpu_features().avx2),
+           int(ul::cpu_features().fma));
+    test_batch_add_type<double>();
+    test_batch_add_type<float>();
+
+    std::vector<double> v = {1, 2, 3};
+    Statistics s;
+    s.add(ul::as_span(v));
+    assert(s.count() == 3 && s.mean() == 2);
+}
+
+int main()
+{
+    test_basic();
+    test_accuracy();
+    test_merge();
+    test_batch_add();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#undef NDEBUG
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/statistics_n.h"
+#include "ul/usual.h"
+
+using ul::AD3;
+using std::vector;
+
+bool close(double a, double b, double tolerance)
+{
+    return fabs(a - b) <= tolerance * std::max(1.0, fabs(b)) ||
+           (std::isnan(a) && std::isnan(b));
+}
+
+template <size_t N>
+void assert_close(const ul::StatisticsN<N>& a,
+                  const ul::StatisticsN<N>& b,
+                  double tolerance)
+{
+    assert(a.count64() == b.count64());
+    assert(close(a.weight_sum(), b.weight_sum(), tolerance));
+    for (size_t i = 0; i < N; ++i) {
+        assert(close(a.mean()[i], b.mean()[i], tolerance));
+        for (size_t j = 0; j < N; ++j) {
+            const double scale =
+                std::max(1.0, sqrt(b.comoment(i, i) * b.comoment(j, j)));
+            assert(fabs(a.comoment(i, j) - b.comoment(i, j)) <=
+                   tolerance * scale);
+        }
+    }
+}
+
+// Correlated 3-D samples around `offset`.
+vector<AD3> random_samples(int n, double offset)
+{
+    std::mt19937 rng(n);
+    std::normal_distribution<double> dist(0, 1);
+    vector<AD3> xs;
+    for (int k = 0; k < n; ++k) {
+        const double a = dist(rng), b = dist(rng), c = dist(rng);
+        xs.push_back({offset + a, offset + 2 * a + b, offset - c});
+    }
+    return xs;
+}
+
+void test_against_two_pass()
+{
+    const auto xs = random_samples(10000, 1e6);
+    ul::StatisticsN<3> s;
+    for (auto& x : xs)
+        s.add(x);
+    assert(s.count() == 10000 && s.weight_sum() == 10000);
+
+    AD3 mean{0, 0, 0};
+    for (auto& x : xs) {
+        for (int i = 0; i < 3; ++i)
+            mean[i] += x[i] / xs.size();
+    }
+    for (int i = 0; i < 3; ++i) {
+        assert(close(s.mean()[i], mean[i], 1e-12));
+        for (int j = 0; j < 3; ++j) {
+            double c = 0;
+            for (auto& x : xs)
+                c += (x[i] - mean[i]) * (x[j] - mean[j]);
+            // Relative to the variances, the cross terms can be near zero.
+            const double scale =
+                sqrt(s.comoment(i, i) * s.comoment(j, j)) / xs.size();
+            assert(fabs(s.comoment(i, j) - c) / xs.size() < 1e-9 * scale);
+            assert(fabs(s.covariance()[i][j] - c / xs.size()) < 1e-9 * scale);
+            assert(fabs(s.covariance_sample()[i][j] - c / (xs.size() - 1)) <
+                   1e-9 * scale);
+        }
+    }
+    // var(a) = 1, var(2a + b) = 5, cov = 2, corr = 2 / sqrt(5)
+    auto r = s.correlation();
+    assert(fabs(r[0][1] - 2 / sqrt(5)) < 0.02);
+    assert(fabs(r[0][2]) < 0.05);
+    assert(r[1][1] == 1 && r[1][0] == r[0][1]);
+    assert(close(s.var()[1], s.covariance()[1][1], 1e-15));
+}
+
+void test_edge_cases()
+{
+    ul::StatisticsN<2> s;
+    assert(std::isnan(s.mean()[0]) && std::isnan(s.covariance()[0][1]));
+    s.add({1, NAN});
+    s.add({1, 2}, 0);
+    assert(s.count() == 0);
+    s.add({1, 2});
+    assert(s.count() == 1 && s.mean()[1] == 2);
+    assert(s.covariance()[0][0] == 0);
+    assert(std::isnan(s.covariance_sample()[0][0]));
+    assert(std::isnan(s.correlation()[0][1]));  // zero variance
+    s.reset();
+    assert(s.count() == 0);
+}
+
+void test_weights_and_merge()
+{
+    // Weight 2 is the same as adding twice.
+    const auto xs = random_samples(1000, 10);
+    ul::StatisticsN<3> weighted, repeated;
+    for (size_t k = 0; k < xs.size(); ++k) {
+        const int w = 1 + int(k % 3);
+        weighted.add(xs[k], w);
+        for (int r = 0; r < w; ++r)
+            repeated.add(xs[k]);
+    }
+    assert(close(weighted.weight_sum(), repeated.weight_sum(), 0));
+    for (int i = 0; i < 3; ++i) {
+        assert(close(weighted.mean()[i], repeated.mean()[i], 1e-12));
+        for (int j = 0; j < 3; ++j)
+            assert(close(weighted.covariance()[i][j],
+                         repeated.covariance()[i][j], 1e-12));
+    }
+
+    ul::StatisticsN<3> all, a, b, empty;
+    for (size_t k = 0; k < xs.size(); ++k) {
+        all.add(xs[k]);
+        (k < 300 ? a : b).add(xs[k]);
+    }
+    a.merge(empty);
+    empty.merge(a);
+    assert_close(empty, a, 0);
+    a.merge(b);
+    assert_close(a, all, 1e-12);
+}
+
+void test_batch()
+{
+    // Sizes around the block size, and offsets far from zero.
+    for (int n : {0, 1, 5, 511, 512, 513, 3000}) {
+        const auto xs = random_samples(n, 1e6);
+        vector<double> weights;
+        vector<double> columns[3];
+        for (int k = 0; k < n; ++k) {
+            weights.push_back(0.5 + k % 4);
+            for (int i = 0; i < 3; ++i)
+                columns[i].push_back(xs[k][i]);
+        }
+        ul::StatisticsN<3> one_by_one, weighted;
+        for (int k = 0; k < n; ++k) {
+            one_by_one.add(xs[k]);
+            weighted.add(xs[k], weights[k]);
+        }
+        const std::array<ul::span<const double>, 3> soa{
+            {ul::as_span(columns[0]), ul::as_span(columns[1]),
+             ul::as_span(columns[2])}};
+
+        ul::StatisticsN<3> s;
+        s.add(soa);
+        assert_close(s, one_by_one, 1e-9);
+        s.reset();
+        s.add(ul::as_span(xs));
+        assert_close(s, one_by_one, 1e-9);
+        s.reset();
+        s.add(soa, ul::as_span(weights));
+        assert_close(s, weighted, 1e-9);
+        s.reset();
+        s.add(ul::as_span(xs), ul::as_span(weights));
+        assert_close(s, weighted, 1e-9);
+    }
+
+    // Blocks with NANs or zero weights.
+    auto xs = random_samples(2000, 0);
+    vector<double> weights(xs.size(), 1.0);
+    xs[7][1] = NAN;
+    weights[1500] = 0;
+    ul::StatisticsN<3> s, expected;
+    s.add(ul::as_span(xs), ul::as_span(weights));
+    for (size_t k = 0; k < xs.size(); ++k)
+        expected.add(xs[k], weights[k]);
+    assert(s.count() == 1998);
+    assert_close(s, expected, 1e-9);
+}
+
+int main()
+{
+    test_against_two_pass();
+    test_edge_cases();
+    test_weights_and_merge();
+    test_batch();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+// Compiled with UL_PROFILE, see CMakeLists.txt
+
+#undef NDEBUG
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ul/clock.h"
+#include "ul/profiler.h"
+#include "ul/stopwatch.h"
+#include "ul/trace.h"
+
+std::string read_file(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    assert(f);
+    std::string s;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        s.append(buf, n);
+    fclose(f);
+    return s;
+}
+
+int count_occurrences(const std::string& s, const char* pattern)
+{
+    int n = 0;
+    for (auto pos = s.find(pattern); pos != std::string::npos;
+         pos = s.find(pattern, pos + 1))
+        ++n;
+    return n;
+}
+
+void traced_work()
+{
+    UL_TRACE_SCOPE("traced_work");
+    UL_PROFILE_ZONE("profile zone");
+    ul::trace::begin("manual");
+    ul::trace::end("manual");
+}
+
+int main()
+{
+    const char* path = "test-trace.json";
+
+    // Not recorded: tracing is off.
+    traced_work();
+
+    ul::trace::start(100);
+    ul::trace::set_thread_name("main \"thread\"");
+    traced_work();
+    std::thread t([]() {
+        ul::trace::set_thread_name("worker");
+        for (int i = 0; i < 10; ++i)
+            traced_work();
+    });
+    t.join();
+    ul::trace::stop();
+    traced_work();  // not recorded
+
+    assert(ul::trace::dropped_count() == 0);
+    assert(ul::trace::dump_chrome_json(path));
+    auto s = read_file(path);
+    assert(s.find("\"traceEvents\":[") != std::string::npos);
+    assert(count_occurrences(s, "\"ph\":\"B\"") == 33);
+    assert(count_occurrences(s, "\"ph\":\"E\"") == 33);
+    assert(count_occurrences(s, "\"name\":\"profile zone\"") == 22);
+    assert(count_occurrences(s, "\"ph\":\"M\"") == 2);
+    assert(s.find("\"main \\\"thread\\\"\"") != std::string::npos);
+    assert(s.find("\"name\":\"worker\"") != std::string::npos);
+
+    // Overflow drops events instead of stalling.
+    ul::trace::start(10);
+    for (int i = 0; i < 10; ++i)
+        traced_work();
+    ul::trace::stop();
+    assert(ul::trace::dropped_count() == 60 - 10);
+    assert(ul::trace::dump_chrome_json(path));
+    s = read_file(path);
+    assert(count_occurrences(s, "\"ph\":\"B\"") +
+               count_occurrences(s, "\"ph\":\"E\"") ==
+           10);
+
+    // Named stopwatches and tic/toc.
+    ul::trace::start(100);
+    ul::Stopwatch<ul::tsc_clock> sw(true, "stopwatch");
+    sw.stop();
+    sw.restart();
+    sw.reset();
+    ul::Stopwatch<> unnamed(true);
+    unnamed.stop();
+    auto t0 = ul::tic("tictoc");
+    ul::toc(t0, "tictoc");
+    ul::trace::stop();
+    assert(ul::trace::dump_chrome_json(path));
+    s = read_file(path);
+    assert(count_occurrences(s, "\"name\":\"stopwatch\"") == 4);
+    assert(count_occurrences(s, "\"name\":\"tictoc\"") == 2);
+    assert(count_occurrences(s, "\"ph\":\"B\"") == 3);
+
+    // Threads that don't record while tracing is on don't allocate, and
+    // their buffers are freed when they exit.
+    const int n_buffers = ul::trace::detail::num_buffers();
+    std::thread([]() {
+        ul::trace::set_thread_name("idle");
+        traced_work();
+        assert(ul::trace::detail::t_buffer->capacity == 0);
+    }).join();
+    assert(ul::trace::detail::num_buffers() == n_buffers);
+
+    // The buffers of exited threads are freed once dumped.
+    ul::trace::start(100);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+        threads.emplace_back(traced_work);
+    for (auto& thread : threads)
+        thread.join();
+    ul::trace::stop();
+    assert(ul::trace::detail::num_buffers() == n_buffers + 8);
+    assert(ul::trace::dump_chrome_json(path));
+    assert(count_occurrences(read_file(path), "\"ph\":\"B\"") == 8 * 3);
+    assert(ul::trace::detail::num_buffers() == n_buffers);
+
+    remove(path);
+    printf("Done.\n");
+    return 0;
+}
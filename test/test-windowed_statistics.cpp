@@ -0,0 +1,128 @@
+#undef NDEBUG
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/windowed_statistics.h"
+
+using std::vector;
+
+// Statistics of the last `window` values of `xs`, computed from scratch.
+ul::Statistics last_values(const vector<double>& xs, int window)
+{
+    ul::Statistics s;
+    for (size_t i = xs.size() > size_t(window) ? xs.size() - window : 0;
+         i < xs.size(); ++i)
+        s.add(xs[i]);
+    return s;
+}
+
+bool close(double a, double b, double tolerance)
+{
+    return fabs(a - b) <= tolerance * std::max(1.0, fabs(b));
+}
+
+template <class W>
+void test_against_recomputed(W& w, double offset)
+{
+    std::mt19937 rng(w.window());
+    std::normal_distribution<double> dist(offset, 1);
+    vector<double> xs;
+    for (int i = 0; i < 20 * w.window() + 3; ++i) {
+        // Also runs of increasing and decreasing values for the queues.
+        double x = dist(rng);
+        if (i % 50 < 10)
+            x = offset + i % 50;
+        else if (i % 50 < 20)
+            x = offset - i % 50;
+        xs.push_back(x);
+        w.add(x);
+        auto expected = last_values(xs, w.window());
+        assert(w.count() == expected.count());
+        assert(w.full() == (w.count() == w.window()));
+        assert(w.lower() == expected.lower());
+        assert(w.upper() == expected.upper());
+        assert(close(w.mean(), expected.mean(), 1e-12));
+        assert(close(w.sum(), expected.sum(), 1e-12));
+        assert(fabs(w.var() - expected.var()) < 1e-6);
+        if (w.count() > 1)
+            assert(fabs(w.var_sample() - expected.var_sample()) < 1e-6);
+        auto s = w.statistics();
+        assert(s.count() == w.count() && s.mean() == w.mean());
+        assert(s.lower() == w.lower() && s.upper() == w.upper());
+    }
+}
+
+void test_fixed()
+{
+    ul::WindowedStatistics<3> w;
+    assert(w.window() == 3 && w.count() == 0);
+    assert(std::isnan(w.mean()) && std::isnan(w.lower()));
+    for (double x : {5.0, 1.0, double(NAN), 3.0, 4.0})
+        w.add(x);
+    // last 3: 1, 3, 4
+    assert(w.count() == 3 && w.full());
+    assert(w.lower() == 1 && w.upper() == 4);
+    assert(close(w.mean(), 8.0 / 3, 1e-15));
+    w.add(2);  // 3, 4, 2
+    assert(w.lower() == 2 && w.upper() == 4 && w.mean() == 3);
+    w.reset();
+    assert(w.count() == 0 && std::isnan(w.upper()));
+
+    ul::WindowedStatistics<1> one;
+    one.add(7);
+    one.add(-7);
+    assert(one.mean() == -7 && one.var() == 0 && one.upper() == -7);
+
+    ul::WindowedStatistics<17> w17;
+    test_against_recomputed(w17, 0);
+    ul::WindowedStatistics<64> w64;
+    test_against_recomputed(w64, 1e6);
+}
+
+void test_runtime()
+{
+    for (int window : {1, 2, 5, 100}) {
+        ul::WindowedStatistics<> w(window);
+        assert(w.window() == window);
+        test_against_recomputed(w, 1e3);
+    }
+
+    bool threw = false;
+    try {
+        ul::WindowedStatistics<> w(0);
+    } catch (const ul::check_failure&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_drift()
+{
+    // Values far from zero and large jumps, the error must not grow with the
+    // number of values.
+    ul::WindowedStatistics<10> w;
+    for (int i = 0; i < 1000000; ++i)
+        w.add(i % 1000 == 0 ? 1e12 : 1e6 + (i % 10));
+    // Last 10: 1e6 + 5, ..., 1e6 + 9, 1e6, ..., 1e6 + 4, mid-way between
+    // two renormalizations.
+    for (int i = 0; i < 15; ++i)
+        w.add(1e6 + i % 10);
+    assert(fabs(w.mean() - (1e6 + 4.5)) < 1e-9);
+    assert(fabs(w.var() - 8.25) < 1e-6);
+}
+
+int main()
+{
+    ul::set_check_failed_policy(ul::check_failed_policy_throw);
+    test_fixed();
+    test_runtime();
+    test_drift();
+    printf("done.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+#include "ul/bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "ul/percentiles.h"
+#include "ul/stringf.h"
+
+namespace ul {
+namespace bench {
+
+namespace {
+bool parse_option(const char* arg, const char* prefix, std::string& value)
+{
+    const size_t n = strlen(prefix);
+    if (strncmp(arg, prefix, n) != 0)
+        return false;
+    value = arg + n;
+    return true;
+}
+}  // namespace
+
+bool Options::parse_args(int argc,
+                         const char* const* argv,
+                         std::vector<std::string>* unparsed)
+{
+    bool ok = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string value;
+        if (parse_option(argv[i], "--min-time=", value))
+            min_time = atof(value.c_str());
+        else if (parse_option(argv[i], "--warmup-time=", value))
+            warmup_time = atof(value.c_str());
+        else if (parse_option(argv[i], "--repetitions=", value))
+            repetitions = std::max(1, atoi(value.c_str()));
+        else if (parse_option(argv[i], "--filter=", value))
+            filter = value;
+        else if (parse_option(argv[i], "--json=", value))
+            json_path = value;
+        else if (parse_option(argv[i], "--baseline=", value))
+            baseline_path = value;
+        else if (parse_option(argv[i], "--threshold=", value))
+            threshold = atof(value.c_str());
+        else if (strcmp(argv[i], "--perf") == 0)
+            perf_counters = true;
+        else {
+            ok = false;
+            if (unparsed)
+                unparsed->push_back(argv[i]);
+        }
+    }
+    return ok;
+}
+
+double median(span<const double> xs)
+{
+    return ul::median(xs);
+}
+
+double mad(span<const double> xs)
+{
+    const double m = median(xs);
+    std::vector<double> deviations;
+    deviations.reserve(xs.size());
+    for (double x : xs)
+        deviations.push_back(fabs(x - m));
+    return median(as_span(deviations));
+}
+
+double Result::ns_per_item() const
+{
+    return items_per_call > 0 ? median_ns / double(items_per_call) : NAN;
+}
+
+double Result::items_per_second() const
+{
+    return items_per_call > 0 ? 1e9 * double(items_per_call) / median_ns
+                              : NAN;
+}
+
+double Result::bytes_per_second() const
+{
+    return bytes_per_call > 0 ? 1e9 * double(bytes_per_call) / median_ns
+                              : NAN;
+}
+
+std::string Result::to_json() const
+{
+    std::string escaped;
+    for (char c : name) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c == '\t') {
+            escaped += "\\t";
+        } else if (uint8_t(c) < 0x20) {
+            escaped += stringf("\\u%04x", unsigned(c));
+        } else {
+            escaped += c;
+        }
+    }
+    // NAN is not valid JSON, write null.
+    auto number = [](double x) {
+        return std::isfinite(x) ? stringf("%.6g", x) : std::string("null");
+    };
+    std::string perf_fields;
+    if (!std::isnan(perf_per_call.ipc()))
+        perf_fields += stringf(",\"ipc\":%.4g", perf_per_call.ipc());
+    for (int i = 0; i < c_num_perf_events; ++i) {
+        if (i != perf_cycles && i != perf_instructions &&
+            !std::isnan(perf_per_call.values[i]))
+            perf_fields +=
+                stringf(",\"%s_per_call\":%.4g", perf_event_name(PerfEvent(i)),
+                        perf_per_call.values[i]);
+    }
+    return stringf(
+        "{\"name\":\"%s\",\"calls\":%lld,\"repetitions\":%d,"
+        "\"median_ns\":%s,\"mad_ns\":%s,\"min_ns\":%s,\"mean_ns\":%s,"
+        "\"std_ns\":%s,\"ns_per_item\":%s,\"items_per_second\":%s,"
+        "\"bytes_per_second\":%s%s}",
+        escaped.c_str(), (long long)calls_per_repetition, stats.count(),
+        number(median_ns).c_str(), number(mad_ns).c_str(),
+        number(min_ns).c_str(), number(stats.mean()).c_str(),
+        number(stats.std()).c_str(), number(ns_per_item()).c_str(),
+        number(items_per_second()).c_str(),
+        number(bytes_per_second()).c_str(), perf_fields.c_str());
+}
+
+namespace {
+// Parses the number after `"key":`, null as NAN.
+bool parse_json_number(const std::string& line, const char* key, double& x)
+{
+    const std::string pattern = stringf("\"%s\":", key);
+    auto pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return false;
+    const char* b = line.c_str() + pos + pattern.size();
+    if (strncmp(b, "null", 4) == 0) {
+        x = NAN;
+        return true;
+    }
+    char* e = nullptr;
+    x = strtod(b, &e);
+    return e != b;
+}
+}  // namespace
+
+bool parse_json_line(const std::string& line, Result& r)
+{
+    const std::string pattern = "\"name\":\"";
+    auto pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return false;
+    r.name.clear();
+    bool closed = false;
+    for (size_t i = pos + pattern.size(); i < line.size(); ++i) {
+        if (line[i] == '"') {
+            closed = true;
+            break;
+        }
+        if (line[i] != '\\' || i + 1 == line.size()) {
+            r.name += line[i];
+            continue;
+        }
+        const char c = line[++i];
+        if (c == 'n') {
+            r.name += '\n';
+        } else if (c == 't') {
+            r.name += '\t';
+        } else if (c == 'u' && i + 4 < line.size()) {
+            // Only the escapes written by to_json, all below 0x80.
+            r.name += char(strtol(line.substr(i + 1, 4).c_str(), nullptr, 16));
+            i += 4;
+        } else {
+            r.name += c;
+        }
+    }
+    return closed && parse_json_number(line, "median_ns", r.median_ns) &&
+           parse_json_number(line, "mad_ns", r.mad_ns) &&
+           parse_json_number(line, "min_ns", r.min_ns);
+}
+
+bool read_json_lines(const std::string& path, std::vector<Result>& results)
+{
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        fprintf(stderr, "Can't open benchmark results file \"%s\".\n",
+                path.c_str());
+        return false;
+    }
+    results.clear();
+    std::string line;
+    int c;
+    do {
+        c = fgetc(f);
+        if (c == '\n' || c == EOF) {
+            Result r;
+            if (parse_json_line(line, r))
+                results.push_back(std::move(r));
+            line.clear();
+        } else
+            line += char(c);
+    } while (c != EOF);
+    fclose(f);
+    return true;
+}
+
+std::vector<Comparison> compare(const std::vector<Result>& baseline,
+                                const std::vector<Result>& current,
+                                double threshold)
+{
+    std::vector<Comparison> cs;
+    for (auto& r : current) {
+        auto it = std::find_if(
+            baseline.begin(), baseline.end(),
+            [&r](const Result& b) { return b.name == r.name; });
+        if (it == baseline.end())
+            continue;
+        Comparison c;
+        c.name = r.name;
+        c.baseline_ns = it->median_ns;
+        c.current_ns = r.median_ns;
+        c.ratio = c.current_ns / c.baseline_ns;
+        // Differences within the noise of either run don't count.
+        auto finite_or_zero = [](double x) { return std::isfinite(x) ? x : 0; };
+        const double noise =
+            3 * std::max(finite_or_zero(r.mad_ns), finite_or_zero(it->mad_ns));
+        const double diff = c.current_ns - c.baseline_ns;
+        c.regression = c.ratio > 1 + threshold && diff > noise;
+        c.improvement = c.ratio < 1 / (1 + threshold) && -diff > noise;
+        cs.push_back(c);
+    }
+    return cs;
+}
+
+void print_comparison(FILE* out, const std::vector<Comparison>& cs)
+{
+    fprintf(out, "%-40s %12s %12s %8s\n", "benchmark", "baseline ns",
+            "current ns", "change");
+    int regressions = 0;
+    for (auto& c : cs) {
+        fprintf(out, "%-40s %12.3f %12.3f %+7.1f%%%s\n", c.name.c_str(),
+                c.baseline_ns, c.current_ns, 100 * (c.ratio - 1),
+                c.regression ? "  REGRESSION"
+                             : c.improvement ? "  improvement" : "");
+        regressions += c.regression;
+    }
+    fprintf(out, "%d regression(s) in %d compared benchmarks\n", regressions,
+            int(cs.size()));
+}
+
+Runner::Runner(const Options& options) : options(options)
+{
+    if (!options.perf_counters)
+        return;
+    perf.reset(new PerfCounters);
+    if (!perf->unavailable_reason().empty())
+        fprintf(stderr, "Performance counters: %s\n",
+                perf->unavailable_reason().c_str());
+    if (!perf->available())
+        perf.reset();
+}
+
+bool Runner::selected(const std::string& name) const
+{
+    return options.filter.empty() ||
+           name.find(options.filter) != std::string::npos;
+}
+
+const Result& Runner::add_result(Result&& r)
+{
+    const auto samples = as_span(r.ns_per_call);
+    r.median_ns = median(samples);
+    r.mad_ns = mad(samples);
+    r.min_ns = r.stats.lower();
+    if (options.print_progress) {
+        if (results_.empty())
+            print_table_header(stdout);
+        print_table_row(stdout, r);
+        fflush(stdout);
+    }
+    results_.push_back(std::move(r));
+    return results_.back();
+}
+
+void Runner::print_table_header(FILE* out)
+{
+    fprintf(out, "%-40s %12s %10s %12s %12s %12s %12s\n", "benchmark",
+            "median ns", "mad %", "min ns", "ns/item", "items/s", "bytes/s");
+}
+
+void Runner::print_table_row(FILE* out, const Result& r)
+{
+    auto si = [](double x) {
+        if (!std::isfinite(x))
+            return std::string("-");
+        const char* prefixes = " kMGTP";
+        int i = 0;
+        while (x >= 1000 && i < 5) {
+            x /= 1000;
+            ++i;
+        }
+        return stringf("%.3g%c", x, prefixes[i]);
+    };
+    fprintf(out, "%-40s %12.3f %10.2f %12.3f %12.4f %12s %12s\n",
+            r.name.c_str(), r.median_ns, 100 * r.mad_ns / r.median_ns,
+            r.min_ns, r.ns_per_item(), si(r.items_per_second()).c_str(),
+            si(r.bytes_per_second()).c_str());
+    const PerfCounts& pc = r.perf_per_call;
+    const double items = r.items_per_call > 0 ? double(r.items_per_call) : 1;
+    std::string perf_line;
+    if (!std::isnan(pc.ipc()))
+        perf_line += stringf(" IPC %.2f", pc.ipc());
+    for (PerfEvent e : {perf_branch_misses, perf_l1d_misses, perf_llc_misses}) {
+        if (!std::isnan(pc[e]))
+            perf_line += stringf(", %s/item %.4f", perf_event_name(e),
+                                 pc[e] / items);
+    }
+    if (!perf_line.empty())
+        fprintf(out, "%-40s%s\n", "", perf_line.c_str());
+}
+
+void Runner::print_table(FILE* out) const
+{
+    print_table_header(out);
+    for (auto& r : results_)
+        print_table_row(out, r);
+}
+
+void Runner::print_json_lines(FILE* out) const
+{
+    for (auto& r : results_)
+        fprintf(out, "%s\n", r.to_json().c_str());
+}
+
+int Runner::finish() const
+{
+    if (!options.print_progress)
+        print_table(stdout);
+    printf("\n");
+    print_json_lines(stdout);
+    if (!options.json_path.empty()) {
+        FILE* f = fopen(options.json_path.c_str(), "w");
+        if (!f) {
+            fprintf(stderr, "Can't open \"%s\" for writing.\n",
+                    options.json_path.c_str());
+            return 1;
+        }
+        print_json_lines(f);
+        fclose(f);
+    }
+    if (options.baseline_path.empty())
+        return 0;
+    std::vector<Result> baseline;
+    if (!read_json_lines(options.baseline_path, baseline))
+        return 1;
+    auto cs = compare(baseline, results_, options.threshold);
+    printf("\n");
+    print_comparison(stdout, cs);
+    for (auto& c : cs) {
+        if (c.regression)
+            return 1;
+    }
+    return 0;
+}
+
+}  // namespace bench
+}  // namespace ul
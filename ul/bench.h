@@ -0,0 +1,259 @@
+#pragma once
+
+// Minimal, dependency-free microbenchmark harness
+//
+//     ul::bench::Runner runner;
+//     std::vector<double> v(1000);
+//     runner.run("sum 1000", [&]() {
+//         ul::bench::do_not_optimize(std::accumulate(v.begin(), v.end(), 0.0));
+//     }, 1000, 1000 * sizeof(double));  // items and bytes per call
+//     ...
+//     return runner.finish();
+//
+// For each benchmark the harness
+//
+// - warms up for `Options::warmup_time`,
+// - calibrates the number of calls per repetition so that one repetition
+//   takes at least `Options::min_time`,
+// - runs `Options::repetitions` repetitions, each timed with a Stopwatch,
+// - aggregates the per-call times of the repetitions with Statistics and
+//   computes the median, MAD (median absolute deviation) and min.
+//
+// The function is called once per operation, use `do_not_optimize` on its
+// results and `clobber_memory` after writes so the optimizer doesn't remove
+// the measured work.
+//
+// `finish()` prints the results as a table and as JSON lines, also writes the
+// JSON lines to a file (--json=) and compares them to the results of an
+// earlier run (--baseline=). A benchmark regressed if its median got slower
+// than the baseline median by more than the relative threshold (--threshold=)
+// and by more than 3 MADs of both runs.
+//
+// With `Options::perf_counters` (--perf) the repetitions are also measured
+// with PerfCounters and the table shows IPC and misses per item.
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ul/math.h"
+#include "ul/perf_counters.h"
+#include "ul/span.h"
+#include "ul/stopwatch.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ul {
+namespace bench {
+
+// Forces the compiler to materialize `value`.
+template <class T>
+inline void do_not_optimize(const T& value)
+{
+#if defined __GNUC__
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile void* volatile p = &value;
+    (void)p;
+    _ReadWriteBarrier();
+#endif
+}
+
+template <class T>
+inline void do_not_optimize(T& value)
+{
+#if defined __GNUC__
+#if defined __clang__
+    asm volatile("" : "+r,m"(value) : : "memory");
+#else
+    asm volatile("" : "+m,r"(value) : : "memory");
+#endif
+#else
+    const volatile void* volatile p = &value;
+    (void)p;
+    _ReadWriteBarrier();
+#endif
+}
+
+// Forces pending memory writes to be considered observable.
+inline void clobber_memory()
+{
+#if defined __GNUC__
+    asm volatile("" : : : "memory");
+#else
+    _ReadWriteBarrier();
+#endif
+}
+
+struct Options
+{
+    double min_time = 0.02;     // seconds per repetition
+    double warmup_time = 0.01;  // seconds
+    int repetitions = 10;
+    // Run only benchmarks whose name contains this, if not empty.
+    std::string filter;
+    // Print a table row to stdout as each benchmark finishes.
+    bool print_progress = true;
+    // Measure hardware counters with PerfCounters, if available.
+    bool perf_counters = false;
+    // Used by Runner::finish()
+    std::string json_path;
+    std::string baseline_path;
+    double threshold = 0.05;
+
+    // Parses --min-time=, --warmup-time=, --repetitions=, --filter=, --json=,
+    // --baseline=, --threshold=, --perf.
+    // Returns false on unknown arguments, which are left in `unparsed`.
+    bool parse_args(int argc,
+                    const char* const* argv,
+                    std::vector<std::string>* unparsed = nullptr);
+};
+
+struct Result
+{
+    std::string name;
+    int64_t calls_per_repetition = 0;
+    int64_t items_per_call = 0;
+    int64_t bytes_per_call = 0;
+    std::vector<double> ns_per_call;  // one per repetition
+    Statistics stats;                 // of ns_per_call
+    PerfCounts perf_per_call;         // NAN without Options::perf_counters
+    double median_ns = NAN;
+    double mad_ns = NAN;
+    double min_ns = NAN;
+
+    // Based on the median
+    double ns_per_item() const;
+    double items_per_second() const;
+    double bytes_per_second() const;
+
+    std::string to_json() const;
+};
+
+// Parses a line written by Result::to_json, only `name`, `median_ns`,
+// `mad_ns` and `min_ns` are restored. Returns false on malformed input.
+bool parse_json_line(const std::string& line, Result& r);
+// Reads results written by Runner::print_json_lines into `results`. Prints a
+// message to stderr and returns false if the file can't be opened.
+bool read_json_lines(const std::string& path, std::vector<Result>& results);
+
+struct Comparison
+{
+    std::string name;
+    double baseline_ns = NAN;
+    double current_ns = NAN;
+    double ratio = NAN;  // current / baseline
+    bool regression = false;
+    bool improvement = false;
+};
+
+// Compares the results found in both, by name.
+std::vector<Comparison> compare(const std::vector<Result>& baseline,
+                                const std::vector<Result>& current,
+                                double threshold);
+void print_comparison(FILE* out, const std::vector<Comparison>& cs);
+
+double median(span<const double> xs);
+// Median absolute deviation from the median
+double mad(span<const double> xs);
+
+class Runner
+{
+public:
+    explicit Runner(const Options& options = Options());
+
+    // Runs `f()` repeatedly. Returns nullptr if skipped by the filter.
+    template <class F>
+    const Result* run(const std::string& name,
+                      F&& f,
+                      int64_t items_per_call = 1,
+                      int64_t bytes_per_call = 0);
+
+    const std::vector<Result>& results() const { return results_; }
+
+    void print_table(FILE* out = stdout) const;
+    // One JSON object per line per benchmark.
+    void print_json_lines(FILE* out) const;
+
+    // Writes and compares the results as requested in the options. Returns
+    // the exit code for main(): 1 if there were regressions or the files
+    // can't be opened, otherwise 0.
+    int finish() const;
+
+    static void print_table_header(FILE* out);
+    static void print_table_row(FILE* out, const Result& r);
+
+private:
+    template <class F>
+    static double time_calls(F& f, int64_t calls);
+
+    bool selected(const std::string& name) const;
+    const Result& add_result(Result&& r);
+
+    Options options;
+    std::unique_ptr<PerfCounters> perf;  // if options.perf_counters
+    std::vector<Result> results_;
+};
+
+template <class F>
+double Runner::time_calls(F& f, int64_t calls)
+{
+    Stopwatch<std::chrono::steady_clock> sw(true);
+    for (int64_t i = 0; i < calls; ++i)
+        f();
+    return sw.stop();
+}
+
+template <class F>
+const Result* Runner::run(const std::string& name,
+                          F&& f,
+                          int64_t items_per_call,
+                          int64_t bytes_per_call)
+{
+    if (!selected(name))
+        return nullptr;
+
+    // Warm up and calibrate: double the number of calls until one batch
+    // takes at least `min_time`.
+    int64_t calls = 1;
+    double warmup_elapsed = 0;
+    for (;;) {
+        const double t = time_calls(f, calls);
+        warmup_elapsed += t;
+        if (t >= options.min_time) {
+            if (warmup_elapsed >= options.warmup_time)
+                break;
+        } else if (t < options.min_time / 2)
+            calls *= 2;
+        else
+            calls = int64_t(double(calls) * options.min_time / t * 1.1) + 1;
+    }
+
+    Result r;
+    r.name = name;
+    r.calls_per_repetition = calls;
+    r.items_per_call = items_per_call;
+    r.bytes_per_call = bytes_per_call;
+    if (perf)
+        perf->reset();
+    for (int i = 0; i < options.repetitions; ++i) {
+        if (perf)
+            perf->start();
+        const double ns = time_calls(f, calls) * 1e9 / double(calls);
+        if (perf)
+            perf->stop();
+        r.ns_per_call.push_back(ns);
+        r.stats.add(ns);
+    }
+    if (perf)
+        r.perf_per_call =
+            perf->counts().per_item(double(calls) * options.repetitions);
+    return &add_result(std::move(r));
+}
+
+}  // namespace bench
+}  // namespace ul
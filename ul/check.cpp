@@ -1,35 +1,212 @@
 #include "ul/check.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <exception>
 
+#include "ul/log_sink.h"
+
 namespace ul {
+
+namespace {
+
+std::atomic<int> s_policy{check_failed_policy_log |
+                          check_failed_policy_terminate};
+std::atomic<int> s_log_rate_limit{0};
+std::atomic<int64_t> s_failed_count{0};
+std::atomic<int64_t> s_suppressed_count{0};
+
+// Rate limiting: number of messages logged in the current one-second window.
+std::atomic<int64_t> s_rate_window{-1};
+std::atomic<int> s_logged_in_window{0};
+
+// Head of the intrusive list of CheckSite objects (UL_CHECK_COUNTERS)
+std::atomic<detail::CheckSite*> s_check_sites{nullptr};
+
+const int c_buf_size = 4096;
+// The report contains the formatted message and the location.
+const int c_report_buf_size = 2 * c_buf_size;
+
+bool log_allowed_by_rate_limit()
+{
+    const int limit = s_log_rate_limit.load(std::memory_order_relaxed);
+    if (limit <= 0)
+        return true;
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    int64_t window = s_rate_window.load(std::memory_order_relaxed);
+    if (window != now && s_rate_window.compare_exchange_strong(window, now))
+        s_logged_in_window.store(0, std::memory_order_relaxed);
+    if (s_logged_in_window.fetch_add(1, std::memory_order_relaxed) < limit)
+        return true;
+    s_suppressed_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void vformat_message(char* message, const char* format_string, va_list args)
+{
+    int len = vsnprintf(message, c_buf_size, format_string, args);
+    if (len >= c_buf_size) {
+        // replace end with '...'
+        for (int i = c_buf_size - 4; i < c_buf_size - 1; ++i)
+            message[i] = '.';
+    }
+}
+
+// Logs, throws or terminates according to the current policy. Returns only if
+// `may_continue` and the policy allows it.
+void handle_failure(const char* report,
+                    const char* condition,
+                    const char* file,
+                    int line,
+                    const char* function,
+                    bool may_continue)
+{
+    s_failed_count.fetch_add(1, std::memory_order_relaxed);
+    const int policy = s_policy.load(std::memory_order_relaxed);
+    const bool terminating =
+        !(policy & check_failed_policy_throw) &&
+        (!may_continue || (policy & check_failed_policy_terminate));
+    if (terminating) {
+        // The last message must not be rate limited, dropped by a full sink
+        // or truncated: the earlier messages first, then this one directly.
+        default_log_sink().flush();
+        if (policy & check_failed_policy_log) {
+            fprintf(stderr, "%s\n", report);
+            fflush(stderr);
+        }
+        std::terminate();
+    }
+    if ((policy & check_failed_policy_log) && log_allowed_by_rate_limit())
+        default_log_sink().write(report);
+    if (policy & check_failed_policy_throw)
+        throw check_failure(report, condition, file, line, function);
+}
+
+}  // namespace
+
+int set_check_failed_policy(int policy)
+{
+    return s_policy.exchange(policy);
+}
+
+int check_failed_policy()
+{
+    return s_policy.load();
+}
+
+void set_check_failed_log_rate_limit(int max_messages_per_second)
+{
+    s_log_rate_limit = max_messages_per_second;
+}
+
+int64_t check_failed_count()
+{
+    return s_failed_count.load();
+}
+
+int64_t check_failed_suppressed_count()
+{
+    return s_suppressed_count.load();
+}
+
+std::vector<CheckSiteCount> check_site_counts()
+{
+    std::vector<CheckSiteCount> result;
+    for (auto* site = s_check_sites.load(std::memory_order_acquire); site;
+         site = site->next) {
+        const int64_t count = site->count.load(std::memory_order_relaxed);
+        // Merge template instantiations which have separate counters.
+        auto it = std::find_if(
+            result.begin(), result.end(), [site](const CheckSiteCount& x) {
+                return x.line == site->line && strcmp(x.file, site->file) == 0;
+            });
+        if (it == result.end())
+            result.push_back(
+                CheckSiteCount{site->file, site->line, site->condition, count});
+        else
+            it->count += count;
+    }
+    std::sort(result.begin(), result.end(),
+              [](const CheckSiteCount& x, const CheckSiteCount& y) {
+                  return x.count > y.count;
+              });
+    return result;
+}
+
+void print_check_site_counts(FILE* f, int max_sites)
+{
+    auto counts = check_site_counts();
+    const int n = std::min<int>(max_sites, counts.size());
+    fprintf(f, "Check site counts (top %d of %d):\n", n, (int)counts.size());
+    for (int i = 0; i < n; ++i) {
+        const auto& c = counts[i];
+        fprintf(f, "%16lld  %s:%d  (%s)\n", (long long)c.count, c.file, c.line,
+                c.condition);
+    }
+}
+
 namespace detail {
 
+CheckSite::CheckSite(const char* file, int line, const char* condition)
+    : file(file), line(line), condition(condition)
+{
+    next = s_check_sites.load(std::memory_order_relaxed);
+    while (!s_check_sites.compare_exchange_weak(next, this,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+    }
+}
+
 void check_failed_core(const char* condition,
                        const char* file,
                        int line,
                        const char* function)
 {
-    fprintf(stderr, "CHECK failed: (%s) in `%s` @ %s:%d.\n", condition,
-            function, file, line);
-    std::terminate();
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size,
+             "CHECK failed: (%s) in `%s` @ %s:%d.", condition, function, file,
+             line);
+    handle_failure(report, condition, file, line, function, true);
+}
+
+void check_failed_fatal(const char* condition,
+                        const char* file,
+                        int line,
+                        const char* function)
+{
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size,
+             "CHECK failed: (%s) in `%s` @ %s:%d.", condition, function, file,
+             line);
+    handle_failure(report, condition, file, line, function, false);
+    std::terminate();  // not reached, handle_failure doesn't return
 }
 
 void unconditionally_failed_core(const char* file,
                                  int line,
                                  const char* function)
 {
-    fprintf(stderr, "FAIL: in `%s` @ %s:%d.\n", function, file, line);
-    std::terminate();
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size, "FAIL: in `%s` @ %s:%d.", function,
+             file, line);
+    handle_failure(report, nullptr, file, line, function, false);
+    std::terminate();  // not reached, handle_failure doesn't return
 }
 
 void unreachable_reached(const char* file, int line, const char* function)
 {
-    fprintf(stderr, "Unreachable statement reached in `%s` @ %s:%d.\n",
-            function, file, line);
-    std::terminate();
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size,
+             "Unreachable statement reached in `%s` @ %s:%d.", function, file,
+             line);
+    handle_failure(report, nullptr, file, line, function, false);
+    std::terminate();  // not reached, handle_failure doesn't return
 }
 
 void check_failed_core(const char* condition,
@@ -39,21 +216,38 @@ void check_failed_core(const char* condition,
                        const char* format_string,
                        ...)
 {
-    const int c_buf_size = 4096;
     char message[c_buf_size];
     va_list args;
     va_start(args, format_string);
-    int len = vsnprintf(message, c_buf_size, format_string, args);
+    vformat_message(message, format_string, args);
+    va_end(args);
+
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size,
+             "CHECK failed \"%s\": (%s) in `%s` @ %s:%d.", message, condition,
+             function, file, line);
+    handle_failure(report, condition, file, line, function, true);
+}
+
+void check_failed_fatal(const char* condition,
+                        const char* file,
+                        int line,
+                        const char* function,
+                        const char* format_string,
+                        ...)
+{
+    char message[c_buf_size];
+    va_list args;
+    va_start(args, format_string);
+    vformat_message(message, format_string, args);
     va_end(args);
-    if (len >= c_buf_size) {
-        // replace end with '...'
-        for (int i = c_buf_size - 4; i < c_buf_size - 1; ++i)
-            message[i] = '.';
-    }
 
-    fprintf(stderr, "CHECK failed \"%s\": (%s) in `%s` @ %s:%d.\n", message,
-            condition, function, file, line);
-    std::terminate();
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size,
+             "CHECK failed \"%s\": (%s) in `%s` @ %s:%d.", message, condition,
+             function, file, line);
+    handle_failure(report, condition, file, line, function, false);
+    std::terminate();  // not reached, handle_failure doesn't return
 }
 
 void unconditionally_failed_core(const char* file,
@@ -62,21 +256,17 @@ void unconditionally_failed_core(const char* file,
                                  const char* format_string,
                                  ...)
 {
-    const int c_buf_size = 4096;
     char message[c_buf_size];
     va_list args;
     va_start(args, format_string);
-    int len = vsnprintf(message, c_buf_size, format_string, args);
+    vformat_message(message, format_string, args);
     va_end(args);
-    if (len >= c_buf_size) {
-        // replace end with '...'
-        for (int i = c_buf_size - 4; i < c_buf_size - 1; ++i)
-            message[i] = '.';
-    }
 
-    fprintf(stderr, "FAIL \"%s\": in `%s` @ %s:%d.\n", message, function, file,
-            line);
-    std::terminate();
+    char report[c_report_buf_size];
+    snprintf(report, c_report_buf_size, "FAIL \"%s\": in `%s` @ %s:%d.",
+             message, function, file, line);
+    handle_failure(report, nullptr, file, line, function, false);
+    std::terminate();  // not reached, handle_failure doesn't return
 }
 
 }  // namespace detail
@@ -11,25 +11,82 @@
 //
 //     CHECK(cond, fmt_string[, args...])
 //
+// Check levels, same arguments as `CHECK`:
+//
+//     CHECK_ALWAYS(cond)  // never compiled out
+//     CHECK(cond)         // compiled out if UL_CHECK_LEVEL < 1
+//     DCHECK(cond)        // compiled out if UL_CHECK_LEVEL < 2
+//
+// UL_CHECK_LEVEL defaults to 2 in debug and 1 in release (NDEBUG) builds.
+// It's set by the `UL_CHECK_LEVEL` CMake cache variable for the `microlib`
+// target and its dependents. A compiled out check does not evaluate its
+// arguments.
+//
+// Per-call-site hit counters: define UL_CHECK_COUNTERS (CMake option
+// `UL_CHECK_COUNTERS`) to count how many times each enabled check ran. Use
+// `check_site_counts()` or `print_check_site_counts()` to find checks that
+// run in hot loops.
+//
 // Set behaviour on failed checks:
 //
 //     set_check_failed_policy(
-//         check_failed_policy_terminate | check_failed_policy_terminate)
+//         check_failed_policy_log | check_failed_policy_terminate)
+//
+// The policy is a combination of these flags:
+//
+// - check_failed_policy_log: print the message to stderr through the
+//   non-blocking `default_log_sink()` (see log_sink.h). Subject to the rate
+//   limit set by `set_check_failed_log_rate_limit` (default: no limit).
+//   Before terminating, the sink is flushed and the message is written
+//   directly to stderr, never rate limited, dropped or truncated.
+// - check_failed_policy_throw: throw `ul::check_failure`.
+// - check_failed_policy_terminate: call `std::terminate`.
+//
+// `throw` takes precedence over `terminate`. With neither of them set (log
+// only or 0) a failed `CHECK` returns and execution continues. The default
+// policy is log | terminate.
+//
+// `FAIL`, `UNREACHABLE` and the library's own `UL_CHECK`s never continue:
+// they terminate unless the policy says throw. The code after them relies on
+// the condition (indices in range, non-null pointers). Only the plain
+// `CHECK`, `DCHECK` and `CHECK_ALWAYS` (`UL_SOFT_CHECK`, ...) of the
+// application may continue.
+//
+// The policy is read only on the failure path, the success path of `CHECK`
+// remains a single compare-and-branch.
 //
 // The `CHECK` macro may collide with the application's own `CHECK`.
-// In that case define `UL_DONT_DEFINE_PLAIN_CHECK` and use `UL_CHECK` instead:
+// In that case define `UL_DONT_DEFINE_PLAIN_CHECK` and use `UL_SOFT_CHECK`
+// instead:
 //
 //     #define UL_DONT_DEFINE_PLAIN_CHECK
 //     #include "ul/check.h"
 //     ...
-//     UL_CHECK(cond)
+//     UL_SOFT_CHECK(cond)
 //
-// The `UL_CHECK` macro is always available.
+// The `UL_SOFT_CHECK`, `UL_SOFT_DCHECK` and `UL_SOFT_CHECK_ALWAYS` macros,
+// and the never continuing `UL_CHECK`, `UL_DCHECK` and `UL_CHECK_ALWAYS` are
+// always available. The library's own headers use only the latter.
 //
 //
 
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include "ul/config.h"
 
+#ifndef UL_CHECK_LEVEL
+#ifdef NDEBUG
+#define UL_CHECK_LEVEL 1
+#else
+#define UL_CHECK_LEVEL 2
+#endif
+#endif
+
 #if defined _MSC_VER
 #define UL_FUNCTION __FUNCSIG__
 #else
@@ -37,33 +94,130 @@
 #endif
 
 namespace ul {
+
+enum check_failed_policy_flags
+{
+    check_failed_policy_log = 1,
+    check_failed_policy_throw = 2,
+    check_failed_policy_terminate = 4
+};
+
+// Sets the process-wide policy, returns the previous one. Thread-safe.
+int set_check_failed_policy(int policy);
+int check_failed_policy();
+
+// Limits the number of messages logged per second by failed checks.
+// Messages over the limit are counted but not printed. 0 means no limit.
+void set_check_failed_log_rate_limit(int max_messages_per_second);
+
+// Number of failed CHECKs and FAILs since the start of the process.
+int64_t check_failed_count();
+// Number of messages suppressed by the rate limit.
+int64_t check_failed_suppressed_count();
+
+// Thrown by failed checks if the policy contains check_failed_policy_throw.
+class check_failure : public std::logic_error
+{
+public:
+    check_failure(const std::string& what,
+                  const char* condition,
+                  const char* file,
+                  int line,
+                  const char* function)
+        : std::logic_error(what),
+          condition_(condition),
+          file_(file),
+          line_(line),
+          function_(function)
+    {}
+
+    // nullptr for FAIL
+    const char* condition() const { return condition_; }
+    const char* file() const { return file_; }
+    int line() const { return line_; }
+    const char* function() const { return function_; }
+
+private:
+    const char* condition_;
+    const char* file_;
+    int line_;
+    const char* function_;
+};
+
+// Number of times an enabled check at a call site was evaluated. Available
+// only if compiled with UL_CHECK_COUNTERS, otherwise the list is empty.
+// Instantiations of the same template are merged into a single item.
+struct CheckSiteCount
+{
+    const char* file;
+    int line;
+    const char* condition;
+    int64_t count;
+};
+
+// Sorted by decreasing count.
+std::vector<CheckSiteCount> check_site_counts();
+void print_check_site_counts(FILE* f = stderr, int max_sites = 20);
+
 namespace detail {
 
-UL_NORETURN void check_failed_core(const char* condition,
-                                   const char* file,
-                                   int line,
-                                   const char* function);
+// Static counter for one check site, registers itself into a global list.
+class CheckSite
+{
+public:
+    CheckSite(const char* file, int line, const char* condition);
+    CheckSite(const CheckSite&) = delete;
 
-UL_NORETURN void check_failed_core(const char* condition,
-                                   const char* file,
-                                   int line,
-                                   const char* function,
-                                   const char* format_string,
-                                   ...) UL_PRINTFLIKE(5, 6);
+    void hit() { count.fetch_add(1, std::memory_order_relaxed); }
 
-UL_NORETURN void unconditionally_failed_core(const char* file,
-                                             int line,
-                                             const char* function);
+    const char* const file;
+    const int line;
+    const char* const condition;
+    std::atomic<int64_t> count{0};
+    CheckSite* next = nullptr;
+};
 
-UL_NORETURN void unconditionally_failed_core(const char* file,
-                                             int line,
-                                             const char* function,
-                                             const char* format_string,
-                                             ...) UL_PRINTFLIKE(4, 5);
+// Not [[noreturn]]: returns if the policy allows execution to continue.
+// Called by the plain CHECKs.
+UL_COLD void check_failed_core(const char* condition,
+                               const char* file,
+                               int line,
+                               const char* function);
+
+UL_COLD void check_failed_core(const char* condition,
+                               const char* file,
+                               int line,
+                               const char* function,
+                               const char* format_string,
+                               ...) UL_PRINTFLIKE(5, 6);
+
+// Like check_failed_core, but terminates if the policy doesn't throw. Called
+// by UL_CHECK.
+UL_NORETURN UL_COLD void check_failed_fatal(const char* condition,
+                                            const char* file,
+                                            int line,
+                                            const char* function);
 
-UL_NORETURN void unreachable_reached(const char* file,
-                                     int line,
-                                     const char* function);
+UL_NORETURN UL_COLD void check_failed_fatal(const char* condition,
+                                            const char* file,
+                                            int line,
+                                            const char* function,
+                                            const char* format_string,
+                                            ...) UL_PRINTFLIKE(5, 6);
+
+UL_NORETURN UL_COLD void unconditionally_failed_core(const char* file,
+                                                     int line,
+                                                     const char* function);
+
+UL_NORETURN UL_COLD void unconditionally_failed_core(const char* file,
+                                                     int line,
+                                                     const char* function,
+                                                     const char* format_string,
+                                                     ...) UL_PRINTFLIKE(4, 5);
+
+UL_NORETURN UL_COLD void unreachable_reached(const char* file,
+                                             int line,
+                                             const char* function);
 
 }  // namespace detail
 }  // namespace ul
@@ -73,12 +227,63 @@ UL_NORETURN void unreachable_reached(const char* file,
 #pragma GCC diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
 #endif
 
-// Simple but non-standard implementation
-#define UL_CHECK(condition, ...)                                            \
-    ((UL_LIKELY(condition))                                                 \
-         ? (void)0                                                          \
-         : (::ul::detail::check_failed_core(#condition, __FILE__, __LINE__, \
-                                            UL_FUNCTION, ##__VA_ARGS__)))
+#ifdef UL_CHECK_COUNTERS
+// Not counted during constant evaluation, where the static counter is not
+// allowed.
+#ifdef UL_IS_CONSTANT_EVALUATED
+#define UL_CHECK_COUNTING_ENABLED() (!UL_IS_CONSTANT_EVALUATED())
+#else
+#define UL_CHECK_COUNTING_ENABLED() true
+#endif
+#define UL_CHECK_COUNT_SITE(condition_str)                             \
+    (UL_CHECK_COUNTING_ENABLED()                                       \
+         ? []() -> ::ul::detail::CheckSite& {                          \
+               static ::ul::detail::CheckSite site(__FILE__, __LINE__, \
+                                                   condition_str);     \
+               return site;                                            \
+           }()                                                         \
+               .hit()                                                  \
+         : (void)0)
+#else
+#define UL_CHECK_COUNT_SITE(condition_str) ((void)0)
+#endif
+
+// Simple but non-standard implementation. `failed` is check_failed_core or
+// check_failed_fatal.
+#define UL_CHECK_IMPL(failed, condition, condition_str, ...)        \
+    (UL_CHECK_COUNT_SITE(condition_str),                            \
+     (UL_LIKELY(condition))                                         \
+         ? (void)0                                                  \
+         : (::ul::detail::failed(condition_str, __FILE__, __LINE__, \
+                                 UL_FUNCTION, ##__VA_ARGS__)))
+
+// Type-checks but does not evaluate the condition
+#define UL_CHECK_DISABLED(condition, ...) (false ? (void)(condition) : (void)0)
+
+#define UL_CHECK_ALWAYS(condition, ...) \
+    UL_CHECK_IMPL(check_failed_fatal, condition, #condition, ##__VA_ARGS__)
+#define UL_SOFT_CHECK_ALWAYS(condition, ...) \
+    UL_CHECK_IMPL(check_failed_core, condition, #condition, ##__VA_ARGS__)
+
+#if UL_CHECK_LEVEL >= 1
+#define UL_CHECK(condition, ...) \
+    UL_CHECK_IMPL(check_failed_fatal, condition, #condition, ##__VA_ARGS__)
+#define UL_SOFT_CHECK(condition, ...) \
+    UL_CHECK_IMPL(check_failed_core, condition, #condition, ##__VA_ARGS__)
+#else
+#define UL_CHECK(condition, ...) UL_CHECK_DISABLED(condition)
+#define UL_SOFT_CHECK(condition, ...) UL_CHECK_DISABLED(condition)
+#endif
+
+#if UL_CHECK_LEVEL >= 2
+#define UL_DCHECK(condition, ...) \
+    UL_CHECK_IMPL(check_failed_fatal, condition, #condition, ##__VA_ARGS__)
+#define UL_SOFT_DCHECK(condition, ...) \
+    UL_CHECK_IMPL(check_failed_core, condition, #condition, ##__VA_ARGS__)
+#else
+#define UL_DCHECK(condition, ...) UL_CHECK_DISABLED(condition)
+#define UL_SOFT_DCHECK(condition, ...) UL_CHECK_DISABLED(condition)
+#endif
 
 #define UL_FAIL(...)                                               \
     (::ul::detail::unconditionally_failed_core(__FILE__, __LINE__, \
@@ -88,12 +293,11 @@ UL_NORETURN void unreachable_reached(const char* file,
 #pragma GCC diagnostic pop
 #endif
 
-#define UL_UNREACHABLE \
-    ((::ul::detail::unreachable_reached(__FILE__, __LINE__, UL_FUNCTION)))
-
 #define UL_UNREACHABLE \
     ((::ul::detail::unreachable_reached(__FILE__, __LINE__, UL_FUNCTION)))
 
 #ifndef UL_DONT_DEFINE_PLAIN_CHECK
-#define CHECK UL_CHECK
+#define CHECK UL_SOFT_CHECK
+#define DCHECK UL_SOFT_DCHECK
+#define CHECK_ALWAYS UL_SOFT_CHECK_ALWAYS
 #endif
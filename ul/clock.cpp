@@ -0,0 +1,132 @@
+#include "ul/clock.h"
+
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined UL_TSC_X86 && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace ul {
+
+namespace detail {
+
+uint64_t g_tsc_base_ticks = 0;
+std::atomic<double> g_tsc_ns_per_tick{0.0};
+
+namespace {
+#if defined UL_TSC_X86
+// CPUID leaf 0x80000001, EDX bit 27
+bool detect_rdtscp()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if (unsigned(regs[0]) < 0x80000001u)
+        return false;
+    __cpuid(regs, 0x80000001);
+    return (regs[3] >> 27) & 1;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) &&
+           ((edx >> 27) & 1);
+#endif
+}
+#endif
+const auto c_calibration_time = std::chrono::milliseconds(20);
+
+// Reads the TSC and steady_clock as close to each other as possible: retries
+// to find the shortest bracketing TSC interval.
+void read_tsc_and_steady_clock(uint64_t& tsc,
+                               std::chrono::steady_clock::time_point& t)
+{
+    uint64_t best_gap = UINT64_MAX;
+    for (int i = 0; i < 5; ++i) {
+        const uint64_t t0 = read_tsc_fenced();
+        const auto s = std::chrono::steady_clock::now();
+        const uint64_t t1 = read_tsc_fenced();
+        if (t1 - t0 < best_gap) {
+            best_gap = t1 - t0;
+            tsc = t0 + (t1 - t0) / 2;
+            t = s;
+        }
+    }
+}
+}  // namespace
+
+#if defined UL_TSC_X86
+bool g_tsc_has_rdtscp = detect_rdtscp();
+#endif
+
+void calibrate_tsc()
+{
+    static std::once_flag once;
+    std::call_once(once, []() {
+        uint64_t tsc0 = 0, tsc1 = 0;
+        std::chrono::steady_clock::time_point t0, t1;
+        read_tsc_and_steady_clock(tsc0, t0);
+        std::this_thread::sleep_for(c_calibration_time);
+        read_tsc_and_steady_clock(tsc1, t1);
+        const double ns =
+            std::chrono::duration<double, std::nano>(t1 - t0).count();
+        g_tsc_base_ticks = tsc0;
+        g_tsc_ns_per_tick.store(ns / double(tsc1 - tsc0),
+                                std::memory_order_release);
+    });
+}
+
+}  // namespace detail
+
+#ifdef _WIN32
+namespace {
+int64_t filetimes_to_ns(const FILETIME& kernel, const FILETIME& user)
+{
+    auto to_int64 = [](const FILETIME& f) {
+        return (int64_t(f.dwHighDateTime) << 32) | f.dwLowDateTime;
+    };
+    return (to_int64(kernel) + to_int64(user)) * 100;  // 100 ns units
+}
+}  // namespace
+
+thread_cpu_clock::time_point thread_cpu_clock::now() noexcept
+{
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    return time_point(duration(filetimes_to_ns(kernel, user)));
+}
+
+process_cpu_clock::time_point process_cpu_clock::now() noexcept
+{
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    return time_point(duration(filetimes_to_ns(kernel, user)));
+}
+#else
+namespace {
+int64_t clock_gettime_ns(clockid_t clock_id)
+{
+    timespec ts;
+    clock_gettime(clock_id, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+}  // namespace
+
+thread_cpu_clock::time_point thread_cpu_clock::now() noexcept
+{
+    return time_point(duration(clock_gettime_ns(CLOCK_THREAD_CPUTIME_ID)));
+}
+
+process_cpu_clock::time_point process_cpu_clock::now() noexcept
+{
+    return time_point(duration(clock_gettime_ns(CLOCK_PROCESS_CPUTIME_ID)));
+}
+#endif
+
+}  // namespace ul
@@ -0,0 +1,125 @@
+#include "ul/concurrent_statistics.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+namespace ul {
+
+namespace {
+
+std::atomic<uint64_t> next_id{1};  // 0: empty ThreadCache
+
+// Guards the ThreadShards maps and Shard::thread, which are touched by the
+// owning thread, by exiting threads and by destructors. Taken only on the
+// slow paths, before the mutex of an object.
+std::mutex g_threads_mutex;
+
+}  // namespace
+
+// The objects a thread has added to, by id, and its shard in each.
+struct ConcurrentStatistics::ThreadShards
+{
+    std::unordered_map<uint64_t, std::pair<ConcurrentStatistics*, Shard*>>
+        shards;
+
+    ~ThreadShards()
+    {
+        std::lock_guard<std::mutex> lock(g_threads_mutex);
+        for (auto& item : shards)
+            item.second.first->retire(item.second.second);
+    }
+};
+
+thread_local ConcurrentStatistics::ThreadCache ConcurrentStatistics::t_cache;
+
+ConcurrentStatistics::ConcurrentStatistics()
+    : id(next_id.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+ConcurrentStatistics::~ConcurrentStatistics()
+{
+    // t_cache entries with this id are never matched again, ids are not
+    // reused.
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    for (auto& shard : shards)
+        shard->thread->shards.erase(id);
+}
+
+ConcurrentStatistics::Shard& ConcurrentStatistics::register_this_thread()
+{
+    thread_local ThreadShards t_shards;
+    Shard* shard;
+    {
+        std::lock_guard<std::mutex> threads_lock(g_threads_mutex);
+        auto& item = t_shards.shards[id];
+        if (!item.second) {
+            std::lock_guard<std::mutex> lock(mutex);
+            shards.emplace_back(new Shard);
+            item = {this, shards.back().get()};
+            item.second->thread = &t_shards;
+        }
+        shard = item.second;
+    }
+    t_cache.id = id;
+    t_cache.shard = shard;
+    return *shard;
+}
+
+void ConcurrentStatistics::retire(Shard* shard)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    retired.merge(shard->read());
+    auto it = std::find_if(
+        shards.begin(), shards.end(),
+        [shard](const std::unique_ptr<Shard>& x) { return x.get() == shard; });
+    shards.erase(it);
+}
+
+Statistics ConcurrentStatistics::Shard::read() const
+{
+    const auto r = std::memory_order_relaxed;
+    for (;;) {
+        const uint32_t s0 = sequence.load(std::memory_order_acquire);
+        if (s0 & 1)
+            continue;
+        const int64_t n = count.load(r);
+        const double mean_ = mean.load(r), m2_ = m2.load(r);
+        const double lower_ = lower.load(r), upper_ = upper.load(r);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(r) == s0)
+            return Statistics::from_moments(n, mean_, m2_, lower_, upper_);
+    }
+}
+
+Statistics ConcurrentStatistics::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Statistics result = retired;
+    for (auto& shard : shards)
+        result.merge(shard->read());
+    return result;
+}
+
+void ConcurrentStatistics::reset()
+{
+    const auto r = std::memory_order_relaxed;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& shard : shards) {
+        shard->count.store(0, r);
+        shard->mean.store(0.0, r);
+        shard->m2.store(0.0, r);
+        shard->lower.store(NAN, r);
+        shard->upper.store(NAN, r);
+    }
+    retired = Statistics();
+}
+
+int ConcurrentStatistics::num_shards() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return int(shards.size());
+}
+
+}  // namespace ul
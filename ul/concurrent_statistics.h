@@ -0,0 +1,129 @@
+#pragma once
+
+// Statistics accumulated by many threads at the same time
+//
+//     ul::ConcurrentStatistics latency;
+//     ... // in any number of threads:
+//     latency.add(seconds);
+//     ... // in any thread, at any time:
+//     ul::Statistics s = latency.snapshot();
+//
+// Each thread adds to its own cache-line aligned shard, created and
+// registered on the thread's first `add` to the object. The shard is found
+// with a compare for repeated adds to the same object, else in a thread-local
+// map (which keeps an entry for each object the thread has added to). Only
+// the owning thread writes a shard, so `add` is a Welford update published
+// with plain (relaxed) atomic stores and no read-modify-write operations,
+// under a sequence lock.
+//
+// `snapshot()` merges the shards into a Statistics (Chan's formula, see
+// Statistics::merge), retrying a shard that is being written to. When a
+// thread exits, its shards are merged into a retired accumulator of each
+// object and freed, so the values are kept and the number of shards stays at
+// the number of live threads. Destroying an object removes its entries from
+// the threads' maps.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ul/math.h"
+
+namespace ul {
+
+class ConcurrentStatistics
+{
+public:
+    ConcurrentStatistics();
+    ~ConcurrentStatistics();
+
+    ConcurrentStatistics(const ConcurrentStatistics&) = delete;
+    void operator=(const ConcurrentStatistics&) = delete;
+
+    // Thread-safe. NANs are skipped.
+    void add(double d)
+    {
+        if (UL_UNLIKELY(std::isnan(d)))
+            return;
+        this_thread_shard().add(d);
+    }
+
+    // Thread-safe, can be called concurrently with `add`.
+    Statistics snapshot() const;
+
+    // Not thread-safe: there must be no concurrent `add`.
+    void reset();
+
+    // Number of live threads that have added values.
+    int num_shards() const;
+
+private:
+    // The shards of a thread, defined in the .cpp.
+    struct ThreadShards;
+
+    struct alignas(64) Shard
+    {
+        // Odd while the owner is writing.
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<int64_t> count{0};
+        std::atomic<double> mean{0.0}, m2{0.0};
+        std::atomic<double> lower{NAN}, upper{NAN};
+
+        void add(double d)
+        {
+            const auto r = std::memory_order_relaxed;
+            const uint32_t s = sequence.load(r);
+            sequence.store(s + 1, r);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            const int64_t n = count.load(r) + 1;
+            const double old_mean = mean.load(r);
+            const double delta = d - old_mean;
+            const double new_mean = old_mean + delta * (1.0 / double(n));
+            count.store(n, r);
+            mean.store(new_mean, r);
+            m2.store(m2.load(r) + delta * (d - new_mean), r);
+            const double lo = lower.load(r);
+            if (!(d >= lo))  // also if lo is NAN
+                lower.store(d, r);
+            const double hi = upper.load(r);
+            if (!(d <= hi))
+                upper.store(d, r);
+
+            sequence.store(s + 2, std::memory_order_release);
+        }
+        Statistics read() const;
+
+        // The owner, written under the global mutex of the .cpp.
+        ThreadShards* thread = nullptr;
+    };
+
+    Shard& this_thread_shard()
+    {
+        if (UL_LIKELY(t_cache.id == id))
+            return *t_cache.shard;
+        return register_this_thread();
+    }
+    // Finds or creates the calling thread's shard, updates t_cache.
+    Shard& register_this_thread();
+    // Merges the shard of an exiting thread into `retired` and frees it.
+    void retire(Shard* shard);
+
+    // Last object added to by this thread.
+    struct ThreadCache
+    {
+        uint64_t id = 0;
+        Shard* shard = nullptr;
+    };
+    static thread_local ThreadCache t_cache;
+
+    // Unique for each object ever created, never reused.
+    const uint64_t id;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    Statistics retired;  // values of exited threads
+};
+
+}  // namespace ul
@@ -10,6 +10,8 @@
 //   depending on compiler support
 // - UL_CONSTEXPR14 evaluates to `constexpr` if c++14 `constexpr` is supported
 //   or to empty string if not
+// - UL_IS_CONSTANT_EVALUATED() is std::is_constant_evaluated() before c++20,
+//   defined only where the compiler provides it
 //
 // Attributes
 //
@@ -19,6 +21,14 @@
 //   Use UL_PRINTFLIKE(M, 0) for va_list-style printf-like functions.
 //   Increment M and N by one if used on member functions (1st argument is
 //   `this`)
+// - UL_COLD marks a function as unlikely to be called (error paths), it's also
+//   never inlined
+//
+// SIMD
+//
+// - UL_X86_DISPATCH is defined where functions can be compiled for a specific
+//   x86 instruction set with UL_TARGET("avx2,fma") and selected at runtime
+//   with `ul::cpu_features()` (cpu.h). UL_TARGET is empty elsewhere.
 
 #include <cstdio>
 
@@ -59,6 +69,14 @@
 #define UL_CONSTEXPR14
 #endif
 
+#if defined __has_builtin
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define UL_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif defined __GNUC__ && __GNUC__ >= 9
+#define UL_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
 #if defined(__GNUC__) && __GNUC__ >= 4
 #define UL_LIKELY(x) (__builtin_expect(!!(x), 1))
 #define UL_UNLIKELY(x) (__builtin_expect(!!(x), 0))
@@ -67,6 +85,21 @@
 #define UL_UNLIKELY(x) (x)
 #endif
 
+#if defined __GNUC__
+#define UL_COLD __attribute__((cold, noinline))
+#elif defined _MSC_VER
+#define UL_COLD __declspec(noinline)
+#else
+#define UL_COLD
+#endif
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define UL_X86_DISPATCH
+#define UL_TARGET(X) __attribute__((target(X)))
+#else
+#define UL_TARGET(X)
+#endif
+
 #ifdef _MSC_VER
 #define UL_NORETURN __declspec(noreturn)
 #elif defined UL_HAVE_CPP11
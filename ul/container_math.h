@@ -126,7 +126,7 @@ auto operator-(const std::vector<X>& x, const std::vector<Y>& y)
 {
     std::vector<decltype(x[0] - y[0])> r;
     const auto N = x.size();
-    CHECK(y.size() == N);
+    UL_CHECK(y.size() == N);
     r.reserve(N);
     for (int i = 0; i < N; ++i) {
         r.emplace_back(x[i] - y[i]);
@@ -138,7 +138,7 @@ template <class X, class Y>
 void operator-=(std::vector<X>& x, const std::vector<Y>& y)
 {
     const auto N = x.size();
-    CHECK(y.size() == N);
+    UL_CHECK(y.size() == N);
     for (int i = 0; i < N; ++i) {
         x[i] -= y[i];
     }
@@ -197,7 +197,7 @@ template <class X, class Y>
 auto times(const std::vector<X>& x, const std::vector<Y>& y)
 {
     const auto N = x.size();
-    CHECK(y.size() == N);
+    UL_CHECK(y.size() == N);
     std::vector<decltype(x[0] * y[0])> r;
     r.reserve(N);
     FOR(i, 0, < N) { r.push_back(x[i] * y[i]); }
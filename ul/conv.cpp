@@ -0,0 +1,296 @@
+#include "ul/conv.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/config.h"
+#include "ul/cpu.h"
+
+#include "ul/simd.h"
+
+namespace ul {
+
+size_t conv_result_size(size_t n, size_t m, ConvShape shape)
+{
+    if (n == 0 || m == 0)
+        return 0;
+    switch (shape) {
+        case ConvShape::full:
+            return n + m - 1;
+        case ConvShape::same:
+            return n;
+        case ConvShape::valid:
+            return n >= m ? n - m + 1 : 0;
+    }
+    return 0;
+}
+
+size_t conv_result_offset(size_t, size_t m, ConvShape shape)
+{
+    switch (shape) {
+        case ConvShape::full:
+            return 0;
+        case ConvShape::same:
+            return m / 2;
+        case ConvShape::valid:
+            return m > 0 ? m - 1 : 0;
+    }
+    return 0;
+}
+
+namespace {
+
+// Outputs computed for all tap chunks before moving on, 8 kB of doubles.
+const size_t c_conv_outputs_block = 1024;
+
+// out[k] = sum x[k + t] * yr[t] for k < count and t < m, added to out[k] if
+// `accumulate`. The kernels compute 4 vectors of consecutive outputs at a
+// time, then single vectors, then the rest one by one.
+template <class T>
+using CorrelateFn = void (*)(const T* x,
+                             const T* yr,
+                             size_t m,
+                             T* out,
+                             size_t count,
+                             bool accumulate);
+
+template <class T>
+void correlate_tail(const T* x,
+                    const T* yr,
+                    size_t m,
+                    T* out,
+                    size_t begin,
+                    size_t count,
+                    bool accumulate)
+{
+    for (size_t k = begin; k < count; ++k) {
+        T s = accumulate ? out[k] : T(0);
+        for (size_t t = 0; t < m; ++t)
+            s += x[k + t] * yr[t];
+        out[k] = s;
+    }
+}
+
+// 8 scalar accumulators, which the compiler can keep in (SSE) registers.
+template <class T>
+void correlate_portable(const T* x,
+                        const T* yr,
+                        size_t m,
+                        T* out,
+                        size_t count,
+                        bool accumulate)
+{
+    const size_t c_lanes = 8;
+    size_t k = 0;
+    for (; k + c_lanes <= count; k += c_lanes) {
+        T a[c_lanes];
+        for (size_t u = 0; u < c_lanes; ++u)
+            a[u] = accumulate ? out[k + u] : T(0);
+        for (size_t t = 0; t < m; ++t) {
+            const T w = yr[t];
+            const T* p = x + k + t;
+            for (size_t u = 0; u < c_lanes; ++u)
+                a[u] += p[u] * w;
+        }
+        for (size_t u = 0; u < c_lanes; ++u)
+            out[k + u] = a[u];
+    }
+    correlate_tail(x, yr, m, out, k, count, accumulate);
+}
+
+#ifdef UL_X86_DISPATCH
+
+template <class T>
+UL_TARGET("avx2,fma")
+void correlate_avx2(const T* x,
+                    const T* yr,
+                    size_t m,
+                    T* out,
+                    size_t count,
+                    bool accumulate)
+{
+    using S = detail::Avx2<T>;
+    using V = typename S::V;
+    const size_t w = S::c_width;
+    size_t k = 0;
+    for (; k + 4 * w <= count; k += 4 * w) {
+        V a0 = accumulate ? S::load(out + k) : S::zero();
+        V a1 = accumulate ? S::load(out + k + w) : S::zero();
+        V a2 = accumulate ? S::load(out + k + 2 * w) : S::zero();
+        V a3 = accumulate ? S::load(out + k + 3 * w) : S::zero();
+        for (size_t t = 0; t < m; ++t) {
+            const V c = S::set1(yr[t]);
+            const T* p = x + k + t;
+            a0 = S::fmadd(S::load(p), c, a0);
+            a1 = S::fmadd(S::load(p + w), c, a1);
+            a2 = S::fmadd(S::load(p + 2 * w), c, a2);
+            a3 = S::fmadd(S::load(p + 3 * w), c, a3);
+        }
+        S::store(out + k, a0);
+        S::store(out + k + w, a1);
+        S::store(out + k + 2 * w, a2);
+        S::store(out + k + 3 * w, a3);
+    }
+    for (; k + w <= count; k += w) {
+        V a = accumulate ? S::load(out + k) : S::zero();
+        for (size_t t = 0; t < m; ++t)
+            a = S::fmadd(S::load(x + k + t), S::set1(yr[t]), a);
+        S::store(out + k, a);
+    }
+    correlate_tail(x, yr, m, out, k, count, accumulate);
+}
+
+// Same as correlate_avx2 with 512-bit vectors.
+template <class T>
+UL_TARGET("avx512f")
+void correlate_avx512(const T* x,
+                      const T* yr,
+                      size_t m,
+                      T* out,
+                      size_t count,
+                      bool accumulate)
+{
+    using S = detail::Avx512<T>;
+    using V = typename S::V;
+    const size_t w = S::c_width;
+    size_t k = 0;
+    for (; k + 4 * w <= count; k += 4 * w) {
+        V a0 = accumulate ? S::load(out + k) : S::zero();
+        V a1 = accumulate ? S::load(out + k + w) : S::zero();
+        V a2 = accumulate ? S::load(out + k + 2 * w) : S::zero();
+        V a3 = accumulate ? S::load(out + k + 3 * w) : S::zero();
+        for (size_t t = 0; t < m; ++t) {
+            const V c = S::set1(yr[t]);
+            const T* p = x + k + t;
+            a0 = S::fmadd(S::load(p), c, a0);
+            a1 = S::fmadd(S::load(p + w), c, a1);
+            a2 = S::fmadd(S::load(p + 2 * w), c, a2);
+            a3 = S::fmadd(S::load(p + 3 * w), c, a3);
+        }
+        S::store(out + k, a0);
+        S::store(out + k + w, a1);
+        S::store(out + k + 2 * w, a2);
+        S::store(out + k + 3 * w, a3);
+    }
+    for (; k + w <= count; k += w) {
+        V a = accumulate ? S::load(out + k) : S::zero();
+        for (size_t t = 0; t < m; ++t)
+            a = S::fmadd(S::load(x + k + t), S::set1(yr[t]), a);
+        S::store(out + k, a);
+    }
+    correlate_tail(x, yr, m, out, k, count, accumulate);
+}
+
+#endif  // UL_X86_DISPATCH
+
+template <class T>
+CorrelateFn<T> select_correlate()
+{
+#ifdef UL_X86_DISPATCH
+    const CpuFeatures& f = cpu_features();
+    if (f.avx512f)
+        return correlate_avx512<T>;
+    if (f.avx2 && f.fma)
+        return correlate_avx2<T>;
+#endif
+    return correlate_portable<T>;
+}
+
+template <class T>
+void conv_direct_impl(span<const T> x,
+                      span<const T> y,
+                      span<T> result,
+                      ConvShape shape,
+                      CorrelateFn<T> correlate)
+{
+    size_t n = x.size(), m = y.size();
+    UL_CHECK(result.size() == conv_result_size(n, m, shape),
+             "conv: result size %d, expected %d.", int(result.size()),
+             int(conv_result_size(n, m, shape)));
+    if (result.empty())
+        return;
+    // Outputs [lo, hi) of the full convolution
+    const size_t lo = conv_result_offset(n, m, shape);
+    const size_t hi = lo + result.size();
+    const T* xp = x.data();
+    const T* yp = y.data();
+    if (n < m) {  // the full convolution is symmetric
+        std::swap(xp, yp);
+        std::swap(n, m);
+    }
+
+    std::vector<T> yr(yp, yp + m);
+    std::reverse(yr.begin(), yr.end());
+    // Full outputs [p, q) from x[p - (m - 1), q), blocked for the L1 cache.
+    auto correlate_blocked = [&](const T* xw, size_t p, size_t q) {
+        T* out = result.data() + (p - lo);
+        for (size_t k = 0; k < q - p; k += c_conv_outputs_block) {
+            const size_t count = std::min(c_conv_outputs_block, q - p - k);
+            for (size_t t = 0; t < m; t += detail::c_conv_taps_block) {
+                correlate(xw + k + t, yr.data() + t,
+                          std::min(detail::c_conv_taps_block, m - t), out + k,
+                          count, t > 0);
+            }
+        }
+    };
+    // The outputs before m - 1 and from n overlap the zero padding of x,
+    // less than m outputs each: from a copy of x with the padding.
+    std::vector<T> padded;
+    auto correlate_padded = [&](size_t p, size_t q) {
+        if (p >= q)
+            return;
+        padded.assign(q - p + m - 1, T(0));
+        for (size_t i = std::max(p, m - 1) - (m - 1); i < std::min(q, n); ++i)
+            padded[i + (m - 1) - p] = xp[i];
+        correlate_blocked(padded.data(), p, q);
+    };
+    const size_t a = std::min(std::max(lo, m - 1), hi);
+    const size_t b = std::max(std::min(hi, n), a);
+    correlate_padded(lo, a);
+    if (a < b)
+        correlate_blocked(xp + (a - (m - 1)), a, b);
+    correlate_padded(b, hi);
+}
+
+}  // namespace
+
+void conv_direct_into(span<const double> x,
+                      span<const double> y,
+                      span<double> result,
+                      ConvShape shape)
+{
+    static const CorrelateFn<double> correlate = select_correlate<double>();
+    conv_direct_impl(x, y, result, shape, correlate);
+}
+
+void conv_direct_into(span<const float> x,
+                      span<const float> y,
+                      span<float> result,
+                      ConvShape shape)
+{
+    static const CorrelateFn<float> correlate = select_correlate<float>();
+    conv_direct_impl(x, y, result, shape, correlate);
+}
+
+namespace detail {
+
+void conv_direct_into_portable(span<const double> x,
+                               span<const double> y,
+                               span<double> result,
+                               ConvShape shape)
+{
+    conv_direct_impl(x, y, result, shape, correlate_portable<double>);
+}
+
+void conv_direct_into_portable(span<const float> x,
+                               span<const float> y,
+                               span<float> result,
+                               ConvShape shape)
+{
+    conv_direct_impl(x, y, result, shape, correlate_portable<float>);
+}
+
+}  // namespace detail
+
+}  // namespace ul
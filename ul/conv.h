@@ -0,0 +1,71 @@
+#pragma once
+
+// Direct convolution of double and float sequences, and output shapes
+//
+//     std::vector<double> out(x.size());
+//     ul::conv_direct_into(ul::as_span(x), ul::as_span(kernel),
+//                          ul::make_span(out.data(), out.size()),
+//                          ul::ConvShape::same);
+//
+// The kernel is output-stationary: the filter is reversed once, then each
+// step computes a block of consecutive outputs in SIMD registers, adding
+// x[i + t] * reversed[t] with FMAs over the taps t, and stores them once.
+// Long filters are split into chunks of detail::c_conv_taps_block taps so
+// the taps and the input window of a chunk stay in the L1 cache. The first
+// and last m - 1 outputs of a full convolution, which only partly overlap x,
+// are computed from a zero-padded copy of that part of x. AVX2 and AVX-512
+// kernels are selected at runtime (see cpu.h), else a portable version with
+// independent scalar accumulators.
+//
+// Usually called through conv / conv_direct in ml.h, which also choose
+// between this and conv_fft (fft.h).
+
+#include <cstddef>
+
+#include "ul/span.h"
+
+namespace ul {
+
+// Which part of the convolution of x (n values) and y (m values) to compute,
+// like matlab's conv(x, y, shape):
+// - full: all n + m - 1 values
+// - same: the central n values, from index m / 2 of the full convolution
+// - valid: the max(n - m + 1, 0) values computed without the zero padding
+//   of x, from index m - 1
+enum class ConvShape
+{
+    full,
+    same,
+    valid
+};
+
+// Number of values of conv(x, y, shape), 0 if x or y is empty.
+size_t conv_result_size(size_t n, size_t m, ConvShape shape);
+// Index of its first value in the full convolution.
+size_t conv_result_offset(size_t n, size_t m, ConvShape shape);
+
+// result.size() must be conv_result_size(x.size(), y.size(), shape).
+void conv_direct_into(span<const double> x,
+                      span<const double> y,
+                      span<double> result,
+                      ConvShape shape = ConvShape::full);
+void conv_direct_into(span<const float> x,
+                      span<const float> y,
+                      span<float> result,
+                      ConvShape shape = ConvShape::full);
+
+namespace detail {
+const size_t c_conv_taps_block = 512;
+
+// conv_direct_into without the SIMD kernels.
+void conv_direct_into_portable(span<const double> x,
+                               span<const double> y,
+                               span<double> result,
+                               ConvShape shape = ConvShape::full);
+void conv_direct_into_portable(span<const float> x,
+                               span<const float> y,
+                               span<float> result,
+                               ConvShape shape = ConvShape::full);
+}  // namespace detail
+
+}  // namespace ul
@@ -0,0 +1,33 @@
+#include "ul/cpu.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "ul/config.h"
+
+namespace ul {
+
+namespace {
+CpuFeatures detect_cpu_features()
+{
+    CpuFeatures f;
+    const char* no_simd = getenv("UL_NO_SIMD");
+    if (no_simd && strcmp(no_simd, "0") != 0)
+        return f;
+#ifdef UL_X86_DISPATCH
+    __builtin_cpu_init();
+    f.avx2 = __builtin_cpu_supports("avx2");
+    f.fma = __builtin_cpu_supports("fma");
+    f.avx512f = __builtin_cpu_supports("avx512f");
+#endif
+    return f;
+}
+}  // namespace
+
+const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
+
+}  // namespace ul
@@ -0,0 +1,26 @@
+#pragma once
+
+// Instruction set extensions supported by the CPU, for selecting SIMD kernels
+// compiled with UL_TARGET (see config.h) at runtime:
+//
+//     if (ul::cpu_features().avx2 && ul::cpu_features().fma)
+//         kernel_avx2(...);
+//     else
+//         kernel_portable(...);
+//
+// Setting the environment variable UL_NO_SIMD (to anything but 0) reports no
+// extensions, to compare with or test the portable code paths.
+
+namespace ul {
+
+struct CpuFeatures
+{
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512f = false;
+};
+
+// Detected once, on the first call.
+const CpuFeatures& cpu_features();
+
+}  // namespace ul
@@ -0,0 +1,243 @@
+#pragma once
+
+// Exponentially decayed statistics, O(1) memory and no window buffer
+//
+// EwmaStatistics: exponentially weighted mean and variance, the weight of a
+// value halves every `half_life` values:
+//
+//     ul::EwmaStatistics load(100);
+//     ... // each sample:
+//     load.add(queue_length);
+//     printf("%f +- %f\n", load.mean(), load.std());
+//
+// RateMeter: events per second decayed over 1, 5 and 15 minutes, like the
+// Unix load average:
+//
+//     ul::RateMeter<> requests;  // or RateMeter<ul::tsc_clock>, see clock.h
+//     ... // for each request:
+//     requests.mark();
+//     ... // any thread:
+//     printf("%.1f req/s\n", requests.rate_1m());
+//
+// `mark` only adds to a count and compares the time with the next tick. Once
+// every 5 seconds it folds the events counted since the last tick into the
+// rates (rate += alpha * (instant_rate - rate), alpha = 1 - exp(-5 s / 1
+// min) for rate_1m). The rates are 0 until the first tick, then start at the
+// instant rate of the first interval. Readers extrapolate the ticks that
+// haven't happened yet, so the rates also decay while nothing is marked.
+//
+// Both are single-writer: one thread calls `add` or `mark`, any thread can
+// read at the same time. Writes are plain (relaxed) atomic stores, no locks
+// and no read-modify-write operations. EwmaStatistics' mean and variance can
+// be from two consecutive `add`s. RateMeter's ticks are published under a
+// sequence lock, readers retry while a tick is written.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "ul/check.h"
+#include "ul/config.h"
+
+namespace ul {
+
+class EwmaStatistics
+{
+public:
+    explicit EwmaStatistics(double half_life)
+        : alpha(1 - exp2(-1 / half_life))
+    {
+        UL_CHECK(half_life > 0, "Invalid half-life %g.", half_life);
+    }
+
+    // NANs are skipped.
+    void add(double d)
+    {
+        if (UL_UNLIKELY(std::isnan(d)))
+            return;
+        const auto r = std::memory_order_relaxed;
+        const int64_t n = count_.load(r);
+        if (UL_UNLIKELY(n == 0)) {
+            mean_.store(d, r);
+        } else {
+            // West (1979): incremental weighted mean and variance.
+            const double mean = mean_.load(r);
+            const double delta = d - mean;
+            const double increment = alpha * delta;
+            mean_.store(mean + increment, r);
+            var_.store((1 - alpha) * (var_.load(r) + delta * increment), r);
+        }
+        count_.store(n + 1, r);
+    }
+
+    void reset()
+    {
+        const auto r = std::memory_order_relaxed;
+        count_.store(0, r);
+        mean_.store(0.0, r);
+        var_.store(0.0, r);
+    }
+
+    // Weight of the newest value.
+    double weight() const { return alpha; }
+    int64_t count64() const { return count_.load(std::memory_order_relaxed); }
+
+    double mean() const
+    {
+        return count64() > 0 ? mean_.load(std::memory_order_relaxed) : NAN;
+    }
+    double var() const
+    {
+        return count64() > 0 ? var_.load(std::memory_order_relaxed) : NAN;
+    }
+    double std() const { return sqrt(var()); }
+
+private:
+    const double alpha;
+    std::atomic<int64_t> count_{0};
+    std::atomic<double> mean_{0.0}, var_{0.0};
+};
+
+template <class Clock = std::chrono::high_resolution_clock>
+class RateMeter
+{
+public:
+    using clock = Clock;
+    using time_point = typename clock::time_point;
+    using duration = typename clock::duration;
+
+    static constexpr double c_tick_seconds = 5;
+
+    explicit RateMeter(time_point now = clock::now())
+        : start(now), last_tick(now.time_since_epoch().count())
+    {
+        for (auto& r : rates)
+            r.store(0.0, std::memory_order_relaxed);
+    }
+
+    RateMeter(const RateMeter&) = delete;
+    void operator=(const RateMeter&) = delete;
+
+    void mark(int64_t n = 1) { mark(n, clock::now()); }
+    // `now` must not go backwards.
+    void mark(int64_t n, time_point now)
+    {
+        const auto r = std::memory_order_relaxed;
+        count_.store(count_.load(r) + n, r);
+        if (UL_UNLIKELY(now.time_since_epoch().count() - last_tick.load(r) >=
+                        tick_interval().count()))
+            tick(now);
+    }
+
+    // Events marked so far.
+    int64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    // Events per second.
+    double rate_1m(time_point now = clock::now()) const { return rate(0, now); }
+    double rate_5m(time_point now = clock::now()) const { return rate(1, now); }
+    double rate_15m(time_point now = clock::now()) const
+    {
+        return rate(2, now);
+    }
+    // Since construction.
+    double mean_rate(time_point now = clock::now()) const
+    {
+        const double seconds =
+            std::chrono::duration<double>(now - start).count();
+        return seconds > 0 ? double(count()) / seconds : 0.0;
+    }
+
+private:
+    static constexpr int c_num_rates = 3;
+
+    static duration tick_interval()
+    {
+        return std::chrono::duration_cast<duration>(
+            std::chrono::duration<double>(c_tick_seconds));
+    }
+
+    static double alpha(int i)
+    {
+        static const double minutes[c_num_rates] = {1, 5, 15};
+        return 1 - exp(-c_tick_seconds / (60 * minutes[i]));
+    }
+
+    // Rate after `ticks` ticks, the first with `events` counted since the
+    // previous tick.
+    static double advance(int i,
+                          double rate,
+                          bool initialized,
+                          int64_t events,
+                          int64_t ticks)
+    {
+        const double instant_rate = double(events) / c_tick_seconds;
+        if (initialized)
+            rate += alpha(i) * (instant_rate - rate);
+        else
+            rate = instant_rate;
+        return rate * pow(1 - alpha(i), double(ticks - 1));
+    }
+
+    // Number of whole ticks from `tick_rep` to `now`.
+    static int64_t ticks_since(typename duration::rep tick_rep, time_point now)
+    {
+        return int64_t((now.time_since_epoch().count() - tick_rep) /
+                       tick_interval().count());
+    }
+
+    void tick(time_point now)
+    {
+        const auto r = std::memory_order_relaxed;
+        const uint32_t s = sequence.load(r);
+        sequence.store(s + 1, r);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const auto tick_rep = last_tick.load(r);
+        const int64_t ticks = ticks_since(tick_rep, now);
+        const int64_t n = count_.load(r);
+        for (int i = 0; i < c_num_rates; ++i) {
+            rates[i].store(advance(i, rates[i].load(r), initialized.load(r),
+                                   n - count_at_tick.load(r), ticks),
+                           r);
+        }
+        initialized.store(true, r);
+        count_at_tick.store(n, r);
+        last_tick.store(tick_rep + ticks * tick_interval().count(), r);
+
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    double rate(int i, time_point now) const
+    {
+        const auto r = std::memory_order_relaxed;
+        for (;;) {
+            const uint32_t s0 = sequence.load(std::memory_order_acquire);
+            if (s0 & 1)
+                continue;
+            double result = rates[i].load(r);
+            const bool init = initialized.load(r);
+            const int64_t n = count_at_tick.load(r);
+            const auto tick_rep = last_tick.load(r);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(r) != s0)
+                continue;
+            const int64_t ticks = ticks_since(tick_rep, now);
+            if (ticks > 0)
+                result = advance(i, result, init, count() - n, ticks);
+            return result;
+        }
+    }
+
+    const time_point start;
+    std::atomic<int64_t> count_{0};
+
+    // Written by tick()
+    std::atomic<uint32_t> sequence{0};  // odd while writing
+    std::atomic<typename duration::rep> last_tick;
+    std::atomic<int64_t> count_at_tick{0};
+    std::atomic<bool> initialized{false};
+    std::atomic<double> rates[c_num_rates];
+};
+
+}  // namespace ul
@@ -0,0 +1,226 @@
+#include "ul/fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "ul/check.h"
+#include "ul/math.h"
+
+namespace ul {
+
+Fft::Fft(size_t n) : n(n), twiddle_re(n), twiddle_im(n)
+{
+    UL_CHECK(n > 0 && (n & (n - 1)) == 0, "FFT size %d is not a power of 2.",
+             int(n));
+    for (size_t h = 1; h < n; h *= 2) {
+        for (size_t k = 0; k < h; ++k) {
+            const double a = -M_PI * double(k) / double(h);
+            twiddle_re[h + k] = cos(a);
+            twiddle_im[h + k] = sin(a);
+        }
+    }
+    int bits = 0;
+    while ((size_t(1) << bits) < n)
+        ++bits;
+    for (size_t i = 0; i < n; ++i) {
+        size_t r = 0;
+        for (int b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        if (i < r) {
+            swaps.push_back(i);
+            swaps.push_back(r);
+        }
+    }
+}
+
+void Fft::permute(double* re, double* im) const
+{
+    for (size_t i = 0; i < swaps.size(); i += 2) {
+        std::swap(re[swaps[i]], re[swaps[i + 1]]);
+        std::swap(im[swaps[i]], im[swaps[i + 1]]);
+    }
+}
+
+void Fft::forward(double* re, double* im) const
+{
+    forward_bitreversed(re, im);
+    permute(re, im);
+}
+
+void Fft::inverse(double* re, double* im) const
+{
+    permute(re, im);
+    inverse_bitreversed(re, im);
+}
+
+// Decimation in frequency: natural order in, bit-reversed out.
+void Fft::forward_bitreversed(double* re, double* im) const
+{
+    for (size_t h = n / 2; h >= 1; h /= 2) {
+        const double* wr = twiddle_re.data() + h;
+        const double* wi = twiddle_im.data() + h;
+        for (size_t s = 0; s < n; s += 2 * h) {
+            double *ar = re + s, *ai = im + s, *br = ar + h, *bi = ai + h;
+            for (size_t k = 0; k < h; ++k) {
+                const double dr = ar[k] - br[k], di = ai[k] - bi[k];
+                ar[k] += br[k];
+                ai[k] += bi[k];
+                br[k] = dr * wr[k] - di * wi[k];
+                bi[k] = dr * wi[k] + di * wr[k];
+            }
+        }
+    }
+}
+
+// Decimation in time with the conjugate twiddles: bit-reversed in, natural
+// order out.
+void Fft::inverse_bitreversed(double* re, double* im) const
+{
+    for (size_t h = 1; h < n; h *= 2) {
+        const double* wr = twiddle_re.data() + h;
+        const double* wi = twiddle_im.data() + h;
+        for (size_t s = 0; s < n; s += 2 * h) {
+            double *ar = re + s, *ai = im + s, *br = ar + h, *bi = ai + h;
+            for (size_t k = 0; k < h; ++k) {
+                const double tr = br[k] * wr[k] + bi[k] * wi[k];
+                const double ti = bi[k] * wr[k] - br[k] * wi[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+    const double scale = 1.0 / double(n);
+    for (size_t i = 0; i < n; ++i) {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
+
+namespace {
+
+// FFT size for a filter of m values and a sequence of n values: the power of
+// 2 >= 2m with the fewest operations, L log L for each transform (the
+// filter's and two per pair of blocks of L - m + 1 values).
+size_t ola_size(size_t m, size_t n)
+{
+    size_t l = 2;
+    while (l < 2 * m)
+        l *= 2;
+    size_t best = l;
+    double best_cost = INFINITY;
+    for (; l < 4 * std::max(n, m); l *= 2) {
+        const size_t pairs = (n + 2 * (l - m + 1) - 1) / (2 * (l - m + 1));
+        const double cost = double(2 * pairs + 1) * double(l) * log2(double(l));
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = l;
+        }
+    }
+    return best;
+}
+
+// Plans are reused by the calls of a thread, twiddles take longer to compute
+// than a transform.
+const Fft& cached_fft(size_t n)
+{
+    thread_local std::vector<std::unique_ptr<Fft>> t_ffts;
+    size_t log2n = 0;
+    while ((size_t(1) << log2n) < n)
+        ++log2n;
+    if (t_ffts.size() <= log2n)
+        t_ffts.resize(log2n + 1);
+    if (!t_ffts[log2n])
+        t_ffts[log2n] = std::make_unique<Fft>(n);
+    return *t_ffts[log2n];
+}
+
+// Adds src[i] to the outputs at full indices s + i within [lo, hi).
+template <class T>
+void add_block(const double* src,
+               size_t s,
+               size_t count,
+               size_t lo,
+               size_t hi,
+               T* out)
+{
+    const size_t begin = std::max(s, lo), end = std::min(s + count, hi);
+    for (size_t i = begin; i < end; ++i)
+        out[i - lo] += T(src[i - s]);
+}
+
+template <class T>
+void conv_fft_into_impl(span<const T> x,
+                        span<const T> y,
+                        span<T> result,
+                        ConvShape shape)
+{
+    UL_CHECK(result.size() == conv_result_size(x.size(), y.size(), shape),
+             "conv_fft: result size %d, expected %d.", int(result.size()),
+             int(conv_result_size(x.size(), y.size(), shape)));
+    if (result.empty())
+        return;
+    // Outputs [lo, hi) of the full convolution, which is symmetric.
+    const size_t lo = conv_result_offset(x.size(), y.size(), shape);
+    const size_t hi = lo + result.size();
+    if (x.size() < y.size())
+        std::swap(x, y);
+    const size_t n = x.size(), m = y.size();
+    const Fft& fft = cached_fft(ola_size(m, n));
+    const size_t l = fft.size(), block = l - m + 1;
+
+    std::vector<double> buffer(4 * l, 0.0);
+    double *fr = buffer.data(), *fi = fr + l;
+    double *br = fi + l, *bi = br + l;
+    for (size_t i = 0; i < m; ++i)
+        fr[i] = double(y[i]);
+    fft.forward_bitreversed(fr, fi);
+
+    std::fill(result.begin(), result.end(), T(0));
+    // Blocks starting at s (real part) and s + block (imaginary part),
+    // contributing to the outputs [s, s + 2 block + m - 1)
+    const size_t first =
+        lo >= m - 1 ? (lo - (m - 1)) / (2 * block) * (2 * block) : 0;
+    for (size_t s = first; s < std::min(n, hi); s += 2 * block) {
+        const size_t na = std::min(block, n - s);
+        const size_t nb = s + block < n ? std::min(block, n - s - block) : 0;
+        for (size_t i = 0; i < na; ++i)
+            br[i] = double(x[s + i]);
+        std::fill(br + na, br + l, 0.0);
+        for (size_t i = 0; i < nb; ++i)
+            bi[i] = double(x[s + block + i]);
+        std::fill(bi + nb, bi + l, 0.0);
+        fft.forward_bitreversed(br, bi);
+        for (size_t i = 0; i < l; ++i) {
+            const double r = br[i] * fr[i] - bi[i] * fi[i];
+            bi[i] = br[i] * fi[i] + bi[i] * fr[i];
+            br[i] = r;
+        }
+        fft.inverse_bitreversed(br, bi);
+        add_block(br, s, na + m - 1, lo, hi, result.data());
+        if (nb > 0)
+            add_block(bi, s + block, nb + m - 1, lo, hi, result.data());
+    }
+}
+
+}  // namespace
+
+void conv_fft_into(span<const double> x,
+                   span<const double> y,
+                   span<double> result,
+                   ConvShape shape)
+{
+    conv_fft_into_impl(x, y, result, shape);
+}
+
+void conv_fft_into(span<const float> x,
+                   span<const float> y,
+                   span<float> result,
+                   ConvShape shape)
+{
+    conv_fft_into_impl(x, y, result, shape);
+}
+
+}  // namespace ul
@@ -0,0 +1,72 @@
+#pragma once
+
+// Complex FFT of power-of-2 sizes and FFT-based linear convolution
+//
+//     ul::Fft fft(1024);      // precomputes twiddles and bit reversal
+//     fft.forward(re, im);    // in place, 1024 real and imaginary parts
+//     fft.inverse(re, im);    // scaled by 1/n, inverse(forward(x)) == x
+//
+// Radix 2, real and imaginary parts in separate arrays so that the
+// butterflies of a stage are a vectorizable loop. `forward_bitreversed` and
+// `inverse_bitreversed` skip the permutation: the spectrum is in bit-reversed
+// order, which doesn't matter for pointwise products (convolution).
+//
+// `conv_fft_into` computes the linear convolution of two real sequences with
+// overlap-add: the shorter sequence (the filter, m values) is transformed
+// once at size L (the power of 2 >= 2m with the lowest cost per output),
+// the longer one is cut into blocks of L - m + 1 values whose products with
+// the filter's spectrum are transformed back and added. Two real blocks go
+// into one complex transform, as real and imaginary parts, since the filter
+// is real. O((n + m) log m) instead of the O(n m) of the direct loop, see
+// conv / conv_direct / conv_fft in ml.h for the choice between the two.
+//
+// Computes in double, also for float.
+
+#include <cstddef>
+#include <vector>
+
+#include "ul/conv.h"
+#include "ul/span.h"
+
+namespace ul {
+
+class Fft
+{
+public:
+    // `n` must be a power of 2.
+    explicit Fft(size_t n);
+
+    size_t size() const { return n; }
+
+    // X[k] = sum x[j] exp(-2 pi i j k / n)
+    void forward(double* re, double* im) const;
+    // Scaled by 1/n.
+    void inverse(double* re, double* im) const;
+
+    // X in bit-reversed order.
+    void forward_bitreversed(double* re, double* im) const;
+    // From X in bit-reversed order, scaled by 1/n.
+    void inverse_bitreversed(double* re, double* im) const;
+
+private:
+    void permute(double* re, double* im) const;
+
+    size_t n;
+    // exp(-pi i k / h) at h + k, for the stages h = 1, 2, 4, ..., n / 2.
+    std::vector<double> twiddle_re, twiddle_im;
+    std::vector<size_t> swaps;  // pairs of bit-reversed indices
+};
+
+// result = conv(x, y, shape), result.size() must be
+// conv_result_size(x.size(), y.size(), shape). Only the blocks of x which
+// contribute to the result are transformed.
+void conv_fft_into(span<const double> x,
+                   span<const double> y,
+                   span<double> result,
+                   ConvShape shape = ConvShape::full);
+void conv_fft_into(span<const float> x,
+                   span<const float> y,
+                   span<float> result,
+                   ConvShape shape = ConvShape::full);
+
+}  // namespace ul
@@ -0,0 +1,176 @@
+#include "ul/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ul/check.h"
+
+namespace ul {
+
+LatencyHistogram::LatencyHistogram(int64_t lowest_discernible_value,
+                                   int64_t highest_trackable_value,
+                                   int significant_digits)
+    : lowest_discernible_value_(lowest_discernible_value),
+      highest_trackable_value_(highest_trackable_value),
+      significant_digits_(significant_digits)
+{
+    UL_CHECK(lowest_discernible_value >= 1);
+    UL_CHECK(highest_trackable_value >= 2 * lowest_discernible_value);
+    UL_CHECK(1 <= significant_digits && significant_digits <= 5);
+
+    const int64_t largest_value_with_single_unit_resolution =
+        2 * int64_t(pow(10, significant_digits));
+    const int sub_bucket_count_magnitude = int(
+        ceil(log2(double(largest_value_with_single_unit_resolution))));
+    sub_bucket_half_count_magnitude =
+        std::max(sub_bucket_count_magnitude, 1) - 1;
+    unit_magnitude = int(floor(log2(double(lowest_discernible_value))));
+    sub_bucket_count = 1 << (sub_bucket_half_count_magnitude + 1);
+    sub_bucket_half_count = sub_bucket_count / 2;
+    sub_bucket_mask = uint64_t(sub_bucket_count - 1) << unit_magnitude;
+
+    int64_t smallest_untrackable_value = int64_t(sub_bucket_count)
+                                         << unit_magnitude;
+    bucket_count = 1;
+    while (smallest_untrackable_value <= highest_trackable_value) {
+        if (smallest_untrackable_value > INT64_MAX / 2) {
+            ++bucket_count;
+            break;
+        }
+        smallest_untrackable_value <<= 1;
+        ++bucket_count;
+    }
+    counts.assign(size_t(bucket_count + 1) * sub_bucket_half_count, 0);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& x)
+{
+    UL_CHECK(lowest_discernible_value_ == x.lowest_discernible_value_ &&
+                 highest_trackable_value_ == x.highest_trackable_value_ &&
+                 significant_digits_ == x.significant_digits_,
+             "LatencyHistogram::merge: different parameters");
+    for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += x.counts[i];
+    total_count_ += x.total_count_;
+    saturated_count_ += x.saturated_count_;
+    min_ = std::min(min_, x.min_);
+    max_ = std::max(max_, x.max_);
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    total_count_ = saturated_count_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+}
+
+int64_t LatencyHistogram::value_at_index(int index) const
+{
+    int bucket = (index >> sub_bucket_half_count_magnitude) - 1;
+    int sub_bucket =
+        (index & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+    if (bucket < 0) {
+        sub_bucket -= sub_bucket_half_count;
+        bucket = 0;
+    }
+    return int64_t(sub_bucket) << (bucket + unit_magnitude);
+}
+
+int64_t LatencyHistogram::lowest_equivalent_value(int64_t value) const
+{
+    const int bucket = bucket_index_for(value);
+    const int sub_bucket = int(value >> (bucket + unit_magnitude));
+    return int64_t(sub_bucket) << (bucket + unit_magnitude);
+}
+
+int64_t LatencyHistogram::highest_equivalent_value(int64_t value) const
+{
+    const int bucket = bucket_index_for(value);
+    const int sub_bucket = int(value >> (bucket + unit_magnitude));
+    const int adjusted_bucket =
+        sub_bucket >= sub_bucket_count ? bucket + 1 : bucket;
+    const int64_t range_size = int64_t(1) << (unit_magnitude + adjusted_bucket);
+    return lowest_equivalent_value(value) + range_size - 1;
+}
+
+double LatencyHistogram::mean() const
+{
+    if (total_count_ == 0)
+        return NAN;
+    double sum = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) {
+            const int64_t v = value_at_index(int(i));
+            const double mid =
+                0.5 * (double(v) + double(highest_equivalent_value(v)));
+            sum += mid * double(counts[i]);
+        }
+    }
+    return sum / double(total_count_);
+}
+
+double LatencyHistogram::std() const
+{
+    if (total_count_ == 0)
+        return NAN;
+    const double m = mean();
+    double sum2 = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) {
+            const int64_t v = value_at_index(int(i));
+            const double mid =
+                0.5 * (double(v) + double(highest_equivalent_value(v)));
+            sum2 += (mid - m) * (mid - m) * double(counts[i]);
+        }
+    }
+    return sqrt(sum2 / double(total_count_));
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+    if (total_count_ == 0)
+        return 0;
+    p = std::min(std::max(p, 0.0), 100.0);
+    const int64_t target = std::max<int64_t>(
+        1, int64_t(ceil(p / 100 * double(total_count_))));
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        cumulative += counts[i];
+        if (cumulative >= target) {
+            const int64_t v = highest_equivalent_value(value_at_index(int(i)));
+            return std::min(std::max(v, min()), max());
+        }
+    }
+    return max();
+}
+
+std::vector<std::pair<int64_t, double>> LatencyHistogram::cdf() const
+{
+    std::vector<std::pair<int64_t, double>> result;
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) {
+            cumulative += counts[i];
+            result.emplace_back(
+                highest_equivalent_value(value_at_index(int(i))),
+                double(cumulative) / double(total_count_));
+        }
+    }
+    return result;
+}
+
+void LatencyHistogram::print_cdf(FILE* f, double value_scale) const
+{
+    fprintf(f, "%16s %12s %14s\n", "value", "percentile", "1/(1-p)");
+    for (auto& x : cdf()) {
+        const double inverse = x.second < 1 ? 1 / (1 - x.second) : INFINITY;
+        fprintf(f, "%16.3f %12.6f %14.2f\n", double(x.first) * value_scale,
+                x.second * 100, inverse);
+    }
+    fprintf(f, "#[count = %lld, min = %.3f, max = %.3f, mean = %.3f]\n",
+            (long long)count(), double(min()) * value_scale,
+            double(max()) * value_scale, mean() * value_scale);
+}
+
+}  // namespace ul
@@ -0,0 +1,159 @@
+#pragma once
+
+// HDR-style latency histogram, complements Statistics with percentiles.
+//
+//     ul::LatencyHistogram h;  // 1 ns .. 100 s, 2 significant digits
+//     Stopwatch<> sw(true);
+//     ...
+//     h.record_seconds(sw.elapsed());
+//     ...
+//     h.record(std::chrono::microseconds(15));
+//     ...
+//     printf("p99: %lld ns\n", (long long)h.percentile(99));
+//
+// Values are non-negative integers, durations are recorded in nanoseconds.
+// Buckets are log-linear: powers of two split into linear sub-buckets, so the
+// relative error of any recorded value is at most 10^-significant_digits.
+//
+// `record()` is O(1) (a count-leading-zeros, a shift and an increment). The
+// memory footprint is fixed at construction: about 32 KB for the default 1 ns
+// to 100 s range at 2 significant digits.
+//
+// Values above `highest_trackable_value()` are recorded as the highest
+// trackable value and counted by `saturated_count()`. Not thread-safe, use a
+// histogram per thread and `merge()` them.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "ul/config.h"
+
+namespace ul {
+
+class LatencyHistogram
+{
+public:
+    // `lowest_discernible_value` >= 1, `significant_digits` in [1, 5].
+    explicit LatencyHistogram(int64_t lowest_discernible_value = 1,
+                              int64_t highest_trackable_value = 100000000000,
+                              int significant_digits = 2);
+
+    void record(int64_t value) { record(value, 1); }
+    void record(int64_t value, int64_t count)
+    {
+        if (UL_UNLIKELY(value < 0))
+            value = 0;
+        if (UL_UNLIKELY(value > highest_trackable_value_)) {
+            saturated_count_ += count;
+            value = highest_trackable_value_;
+        }
+        counts[counts_index_for(value)] += count;
+        total_count_ += count;
+        if (value < min_)
+            min_ = value;
+        if (value > max_)
+            max_ = value;
+    }
+    // Records in nanoseconds
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d)
+    {
+        record(int64_t(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    }
+    // Records in nanoseconds, for example `Stopwatch::elapsed()`
+    void record_seconds(double seconds)
+    {
+        record(int64_t(seconds * 1e9 + 0.5));
+    }
+
+    // Adds the counts of another histogram, must have the same parameters.
+    void merge(const LatencyHistogram& x);
+    void reset();
+
+    int64_t count() const { return total_count_; }
+    int64_t saturated_count() const { return saturated_count_; }
+    // Exact values, 0 if empty
+    int64_t min() const { return total_count_ > 0 ? min_ : 0; }
+    int64_t max() const { return total_count_ > 0 ? max_ : 0; }
+    // Approximate values based on bucket midpoints, NAN if empty
+    double mean() const;
+    double std() const;
+
+    // Value at percentile `p` in [0, 100]: the highest value equivalent to
+    // the bucket containing the p-th percentile sample. 0 if empty.
+    int64_t percentile(double p) const;
+
+    // Cumulative distribution: (value, fraction of samples <= value) for each
+    // non-empty bucket, value is the bucket's highest equivalent value.
+    std::vector<std::pair<int64_t, double>> cdf() const;
+    // Prints the cdf() as text, values are multiplied by `value_scale`
+    // (e.g. 1e-3 to print microseconds from nanoseconds).
+    void print_cdf(FILE* f = stdout, double value_scale = 1.0) const;
+
+    int64_t lowest_discernible_value() const
+    {
+        return lowest_discernible_value_;
+    }
+    int64_t highest_trackable_value() const
+    {
+        return highest_trackable_value_;
+    }
+    int significant_digits() const { return significant_digits_; }
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + counts.size() * sizeof(counts[0]);
+    }
+
+    // Range of values sharing a bucket with `value`.
+    int64_t lowest_equivalent_value(int64_t value) const;
+    int64_t highest_equivalent_value(int64_t value) const;
+
+private:
+    int bucket_index_for(int64_t value) const
+    {
+        // Index of the highest bit of value, relative to the sub-bucket range.
+        const uint64_t v = uint64_t(value) | sub_bucket_mask;
+#if defined __GNUC__
+        const int highest_bit = 63 - __builtin_clzll(v);
+#else
+        int highest_bit = 0;
+        for (uint64_t w = v >> 1; w; w >>= 1)
+            ++highest_bit;
+#endif
+        return highest_bit - unit_magnitude - sub_bucket_half_count_magnitude;
+    }
+    int counts_index_for(int64_t value) const
+    {
+        const int bucket = bucket_index_for(value);
+        const int sub_bucket = int(value >> (bucket + unit_magnitude));
+        return counts_index(bucket, sub_bucket);
+    }
+    int counts_index(int bucket, int sub_bucket) const
+    {
+        return ((bucket + 1) << sub_bucket_half_count_magnitude) +
+               (sub_bucket - sub_bucket_half_count);
+    }
+    int64_t value_at_index(int index) const;
+
+    int64_t lowest_discernible_value_;
+    int64_t highest_trackable_value_;
+    int significant_digits_;
+    int unit_magnitude;
+    int sub_bucket_half_count_magnitude;
+    int sub_bucket_count;
+    int sub_bucket_half_count;
+    uint64_t sub_bucket_mask;
+    int bucket_count;
+
+    int64_t total_count_ = 0;
+    int64_t saturated_count_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = 0;
+    std::vector<int64_t> counts;
+};
+
+}  // namespace ul
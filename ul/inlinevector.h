@@ -1,7 +1,6 @@
 #pragma once
 
 #include <array>
-#include <cassert>
 #include <initializer_list>
 
 #include "ul/check.h"
@@ -28,25 +27,26 @@ public:
 
     explicit InlineVector(uninitialized_t) {}
 
-    InlineVector(int n, uninitialized_t) : s(n) { CHECK(n <= Capacity); }
+    InlineVector(int n, uninitialized_t) : s(n) { UL_CHECK(n <= Capacity); }
 
+    // Fills the whole array: copies of the vector don't read uninitialized
+    // items, and it costs about the same as filling n.
     InlineVector(int n, const T& x) : s(n)
     {
-        CHECK(n <= Capacity);
-        for (int i = 0; i < n; ++i)
-            a[i] = x;
+        UL_CHECK(n <= Capacity);
+        a.fill(x);
     }
 
     explicit InlineVector(std::initializer_list<T> x) : s(x.size())
     {
-        CHECK(x.size() <= Capacity);
+        UL_CHECK(x.size() <= Capacity);
         std::copy(BE(x), a.begin());
     }
 
     template <class C>
     void operator=(const C& x)
     {
-        CHECK(x.size() <= Capacity);
+        UL_CHECK(x.size() <= Capacity);
         std::copy(BE(x), a.begin());
         s = x.size();
     }
@@ -54,7 +54,7 @@ public:
     template <class C>
     void operator=(std::initializer_list<C> x)
     {
-        CHECK(x.size() <= Capacity);
+        UL_CHECK(x.size() <= Capacity);
         std::copy(BE(x), a.begin());
         s = x.size();
     }
@@ -72,32 +72,32 @@ public:
     bool empty() const { return s == 0; }
     T& operator[](int x)
     {
-        assert(0 <= x && x < s);
+        UL_DCHECK(0 <= x && x < s);
         return a[x];
     }
     const T& operator[](int x) const
     {
-        assert(0 <= x && x < s);
+        UL_DCHECK(0 <= x && x < s);
         return a[x];
     }
     T& front()
     {
-        assert(s > 0);
+        UL_DCHECK(s > 0);
         return a[0];
     }
     const T& front() const
     {
-        assert(s > 0);
+        UL_DCHECK(s > 0);
         return a[0];
     }
     T& back()
     {
-        assert(s > 0);
+        UL_DCHECK(s > 0);
         return a[s - 1];
     }
     const T& back() const
     {
-        assert(s > 0);
+        UL_DCHECK(s > 0);
         return a[s - 1];
     }
 
@@ -107,18 +107,18 @@ public:
     const_iterator end() const { return a.begin() + s; }
     void push_back(const T& x)
     {
-        assert(s < Capacity);
+        UL_DCHECK(s < Capacity);
         a[s++] = x;
     }
     void pop_back()
     {
-        assert(s > 0);
+        UL_DCHECK(s > 0);
         --s;
     }
     void erase(const_iterator it)
     {
         int idx = it - a.begin();
-        CHECK(0 <= idx && idx < s);
+        UL_CHECK(0 <= idx && idx < s);
         for (int i = idx; i + 1 < s; ++i)
             a[i] = std::move(a[i + 1]);
         --s;
@@ -128,13 +128,13 @@ public:
 
     void resize(int i, uninitialized_t)
     {
-        CHECK(0 <= i && i <= Capacity);
+        UL_CHECK(0 <= i && i <= Capacity);
         s = i;
     }
 
     void resize(int i, const T& value = T())
     {
-        CHECK(0 <= i && i <= Capacity);
+        UL_CHECK(0 <= i && i <= Capacity);
         for (int j = s; j < i; ++j)
             a[j] = value;
         s = i;
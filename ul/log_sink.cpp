@@ -0,0 +1,176 @@
+#include "ul/log_sink.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "ul/check.h"
+
+namespace ul {
+
+namespace {
+const auto c_flush_interval = std::chrono::milliseconds(10);
+
+void truncate_with_ellipsis(char* message, int max_message_size)
+{
+    for (int i = max_message_size - 4; i < max_message_size - 1; ++i)
+        message[i] = '.';
+    message[max_message_size - 1] = 0;
+}
+}  // namespace
+
+LogSink::LogSink(FILE* out, int capacity, int max_message_size)
+    : out(out),
+      capacity_(capacity),
+      max_message_size_(max_message_size),
+      slots(new Slot[capacity]),
+      buffer(new char[size_t(capacity) * max_message_size])
+{
+    UL_CHECK(capacity > 0 && max_message_size >= 4);
+    for (int i = 0; i < capacity; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+        slots[i].length = 0;
+    }
+    flusher = std::thread([this]() { flusher_thread(); });
+}
+
+LogSink::~LogSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(consumer_mutex);
+        stopping = true;
+    }
+    wake_flusher.notify_one();
+    flusher.join();
+    flush();
+}
+
+char* LogSink::reserve(size_t& pos)
+{
+    pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[pos % capacity_];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto diff = intptr_t(sequence) - intptr_t(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+                return &buffer[(pos % capacity_) * max_message_size_];
+        } else if (diff < 0) {
+            // The consumer hasn't released this slot yet: full.
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+}
+
+void LogSink::publish(size_t pos, int length)
+{
+    Slot& slot = slots[pos % capacity_];
+    slot.length = length;
+    slot.sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool LogSink::write(const char* message, size_t length)
+{
+    size_t pos;
+    char* dst = reserve(pos);
+    if (!dst)
+        return false;
+    if (length < size_t(max_message_size_)) {
+        memcpy(dst, message, length);
+    } else {
+        length = max_message_size_ - 1;
+        memcpy(dst, message, length);
+        truncate_with_ellipsis(dst, max_message_size_);
+    }
+    publish(pos, int(length));
+    return true;
+}
+
+bool LogSink::write(const char* message)
+{
+    return write(message, strlen(message));
+}
+
+bool LogSink::printf(const char* format_string, ...)
+{
+    va_list args;
+    va_start(args, format_string);
+    bool result = vprintf(format_string, args);
+    va_end(args);
+    return result;
+}
+
+bool LogSink::vprintf(const char* format_string, va_list args)
+{
+    size_t pos;
+    char* dst = reserve(pos);
+    if (!dst)
+        return false;
+    int length = vsnprintf(dst, max_message_size_, format_string, args);
+    if (length < 0)
+        length = 0;
+    else if (length >= max_message_size_) {
+        length = max_message_size_ - 1;
+        truncate_with_ellipsis(dst, max_message_size_);
+    }
+    publish(pos, length);
+    return true;
+}
+
+void LogSink::drain()
+{
+    bool wrote = false;
+    for (;;) {
+        Slot& slot = slots[dequeue_pos % capacity_];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeue_pos + 1)
+            break;  // empty or not yet published
+        fwrite(&buffer[(dequeue_pos % capacity_) * max_message_size_], 1,
+               slot.length, out);
+        fputc('\n', out);
+        wrote = true;
+        slot.sequence.store(dequeue_pos + capacity_, std::memory_order_release);
+        ++dequeue_pos;
+    }
+    if (wrote)
+        fflush(out);
+}
+
+void LogSink::flush()
+{
+    std::lock_guard<std::mutex> lock(consumer_mutex);
+    drain();
+}
+
+void LogSink::flusher_thread()
+{
+    std::unique_lock<std::mutex> lock(consumer_mutex);
+    while (!stopping) {
+        drain();
+        wake_flusher.wait_for(lock, c_flush_interval);
+    }
+}
+
+LogSink& default_log_sink()
+{
+    static LogSink* sink = []() {
+        auto* s = new LogSink(stderr);
+        std::atexit([]() { default_log_sink().flush(); });
+        return s;
+    }();
+    return *sink;
+}
+
+bool logf(const char* format_string, ...)
+{
+    va_list args;
+    va_start(args, format_string);
+    bool result = default_log_sink().vprintf(format_string, args);
+    va_end(args);
+    return result;
+}
+
+}  // namespace ul
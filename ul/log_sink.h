@@ -0,0 +1,109 @@
+#pragma once
+
+// Asynchronous, non-blocking line-oriented log sink.
+//
+//     ul::LogSink sink(stderr);
+//     sink.printf("processed %d items", n);
+//     sink.write(stringf(...));
+//     sink.flush();  // synchronous, optional
+//
+// Producers (any number of threads) reserve a slot in a bounded lock-free ring
+// buffer with a single compare-and-swap, format the message directly into the
+// slot and publish it. They never block: if the buffer is full the message is
+// dropped and counted. A background thread writes the messages to the output
+// file, one line per message, appending the newline.
+//
+// Messages longer than `max_message_size - 1` are truncated, the end replaced
+// with '...'.
+//
+// `default_log_sink()` writes to stderr, it's used by failed CHECKs and by
+// `logf()`. It's created on first use and flushed at exit and before
+// terminating on failed CHECKs.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ul/config.h"
+
+namespace ul {
+
+class LogSink
+{
+public:
+    static const int c_default_capacity = 1024;
+    static const int c_default_max_message_size = 1024;
+
+    explicit LogSink(FILE* out = stderr,
+                     int capacity = c_default_capacity,
+                     int max_message_size = c_default_max_message_size);
+    LogSink(const LogSink&) = delete;
+    // Flushes and stops the background thread.
+    ~LogSink();
+
+    // Returns false if the message has been dropped.
+    bool write(const char* message, size_t length);
+    bool write(const char* message);
+    bool write(const std::string& message)
+    {
+        return write(message.data(), message.size());
+    }
+    bool printf(const char* format_string, ...) UL_PRINTFLIKE(2, 3);
+    bool vprintf(const char* format_string, va_list args)
+        UL_PRINTFLIKE(2, 0);
+
+    // Writes out all published messages synchronously, from the calling
+    // thread.
+    void flush();
+
+    int64_t dropped_count() const
+    {
+        return dropped_count_.load(std::memory_order_relaxed);
+    }
+    int capacity() const { return capacity_; }
+    int max_message_size() const { return max_message_size_; }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        int length;
+    };
+
+    // Returns the slot's buffer or nullptr if full.
+    char* reserve(size_t& pos);
+    void publish(size_t pos, int length);
+    // Writes out messages until the buffer is empty. Consumer mutex must be
+    // held.
+    void drain();
+    void flusher_thread();
+
+    FILE* const out;
+    const int capacity_;
+    const int max_message_size_;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<char[]> buffer;
+
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) size_t dequeue_pos = 0;  // guarded by consumer_mutex
+    std::atomic<int64_t> dropped_count_{0};
+
+    std::mutex consumer_mutex;
+    std::condition_variable wake_flusher;
+    bool stopping = false;  // guarded by consumer_mutex
+    std::thread flusher;
+};
+
+// Writes to stderr. Never destroyed, flushed at exit.
+LogSink& default_log_sink();
+
+// Formats a message into `default_log_sink()`. Returns false if dropped.
+bool logf(const char* format_string, ...) UL_PRINTFLIKE(1, 2);
+
+}  // namespace ul
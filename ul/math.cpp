@@ -1,31 +1,246 @@
 #include "ul/math.h"
 
+#include "ul/cpu.h"
+
+#ifdef UL_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace ul {
 
 void Statistics::reset()
 {
-    count_ = 0;
-    sum_ = sum2_ = 0.0;
-    bDirty = false;
-    lower_ = upper_ = NAN;
+    *this = Statistics();
+}
+
+void Statistics::merge(const Statistics& x)
+{
+    if (x.count_ == 0)
+        return;
+    if (count_ == 0) {
+        *this = x;
+        return;
+    }
+    const int64_t n = count_ + x.count_;
+    const double delta = x.mean_ - mean_;
+    const double x_fraction = double(x.count_) / double(n);
+    mean_ += delta * x_fraction;
+    m2_ += x.m2_ + delta * delta * double(count_) * x_fraction;
+    count_ = n;
+    lower_ = std::min(lower_, x.lower_);
+    upper_ = std::max(upper_, x.upper_);
+}
+
+void Statistics::add(span<const double> xs)
+{
+    for (size_t i = 0; i < xs.size(); i += detail::c_statistics_block_size) {
+        merge(detail::block_statistics(
+            xs.data() + i,
+            std::min(xs.size() - i, detail::c_statistics_block_size)));
+    }
+}
+
+void Statistics::add(span<const float> xs)
+{
+    for (size_t i = 0; i < xs.size(); i += detail::c_statistics_block_size) {
+        merge(detail::block_statistics(
+            xs.data() + i,
+            std::min(xs.size() - i, detail::c_statistics_block_size)));
+    }
+}
+
+namespace detail {
+
+namespace {
+
+// Scalar accumulators for the first pass, also for the tails of the SIMD
+// kernels.
+struct BlockSums
+{
+    double sum = 0, count = 0, lower = INFINITY, upper = -INFINITY;
+
+    void add(double x)
+    {
+        // Comparisons with NAN are false
+        const bool valid = x == x;
+        sum += valid ? x : 0.0;
+        count += valid ? 1.0 : 0.0;
+        lower = x < lower ? x : lower;
+        upper = x > upper ? x : upper;
+    }
+    void merge(const BlockSums& y)
+    {
+        sum += y.sum;
+        count += y.count;
+        lower = std::min(lower, y.lower);
+        upper = std::max(upper, y.upper);
+    }
+};
+
+template <class T>
+double squared_deviations_tail(const T* xs, size_t b, size_t e, double mean)
+{
+    double m2 = 0;
+    for (size_t i = b; i < e; ++i) {
+        const double x = xs[i];
+        const double d = x == x ? x - mean : 0.0;
+        m2 += d * d;
+    }
+    return m2;
+}
+
+Statistics to_statistics(const BlockSums& s, double mean, double m2)
+{
+    if (s.count == 0)
+        return Statistics();
+    return Statistics::from_moments(int64_t(s.count), mean, m2, s.lower,
+                                    s.upper);
+}
+
+template <class T>
+Statistics block_statistics_portable_impl(const T* xs, size_t n)
+{
+    const int c_lanes = 4;
+    BlockSums lanes[c_lanes];
+    size_t i = 0;
+    for (; i + c_lanes <= n; i += c_lanes) {
+        for (int l = 0; l < c_lanes; ++l)
+            lanes[l].add(xs[i + l]);
+    }
+    for (; i < n; ++i)
+        lanes[0].add(xs[i]);
+    for (int l = 1; l < c_lanes; ++l)
+        lanes[0].merge(lanes[l]);
+    const BlockSums& s = lanes[0];
+    if (s.count == 0)
+        return Statistics();
+    const double mean = s.sum / s.count;
+
+    double m2[c_lanes] = {};
+    i = 0;
+    for (; i + c_lanes <= n; i += c_lanes) {
+        for (int l = 0; l < c_lanes; ++l) {
+            const double x = xs[i + l];
+            const double d = x == x ? x - mean : 0.0;
+            m2[l] += d * d;
+        }
+    }
+    const double m2_total = (m2[0] + m2[1]) + (m2[2] + m2[3]) +
+                            squared_deviations_tail(xs, i, n, mean);
+    return to_statistics(s, mean, m2_total);
+}
+
+#ifdef UL_X86_DISPATCH
+
+UL_TARGET("avx2,fma") inline __m256d load4(const double* p)
+{
+    return _mm256_loadu_pd(p);
+}
+
+UL_TARGET("avx2,fma") inline __m256d load4(const float* p)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+UL_TARGET("avx2,fma") inline double horizontal_sum(__m256d x)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(x),
+                           _mm256_extractf128_pd(x, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
 }
 
-void Statistics::update() const
+template <class T>
+UL_TARGET("avx2,fma")
+Statistics block_statistics_avx2(const T* xs, size_t n)
 {
-    if (count_ > 0) {
-        mean_ = sum_ / count_;
-        var_ = (count_ * sum2_ - square(sum_)) / (square(count_));
-        std_ = sqrt(var_);
-        if (count_ > 1) {
-            var_sample_ =
-                (count_ * sum2_ - square(sum_)) / (count_ * (count_ - 1));
-            std_sample_ = sqrt(var_sample_);
-        } else
-            std_sample_ = var_sample_ = NAN;
-    } else
-        mean_ = std_ = std_sample_ = var_ = var_sample_ = NAN;
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d sum0 = zero, sum1 = zero, count0 = zero, count1 = zero;
+    __m256d lower0 = _mm256_set1_pd(INFINITY), lower1 = lower0;
+    __m256d upper0 = _mm256_set1_pd(-INFINITY), upper1 = upper0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256d a = load4(xs + i), b = load4(xs + i + 4);
+        const __m256d valid_a = _mm256_cmp_pd(a, a, _CMP_ORD_Q);
+        const __m256d valid_b = _mm256_cmp_pd(b, b, _CMP_ORD_Q);
+        sum0 = _mm256_add_pd(sum0, _mm256_and_pd(a, valid_a));
+        sum1 = _mm256_add_pd(sum1, _mm256_and_pd(b, valid_b));
+        count0 = _mm256_add_pd(count0, _mm256_and_pd(one, valid_a));
+        count1 = _mm256_add_pd(count1, _mm256_and_pd(one, valid_b));
+        // min/max return the second operand if either is NAN.
+        lower0 = _mm256_min_pd(a, lower0);
+        lower1 = _mm256_min_pd(b, lower1);
+        upper0 = _mm256_max_pd(a, upper0);
+        upper1 = _mm256_max_pd(b, upper1);
+    }
+    const size_t simd_end = i;
+    BlockSums s;
+    s.sum = horizontal_sum(_mm256_add_pd(sum0, sum1));
+    s.count = horizontal_sum(_mm256_add_pd(count0, count1));
+    alignas(32) double lower[4], upper[4];
+    _mm256_store_pd(lower, _mm256_min_pd(lower0, lower1));
+    _mm256_store_pd(upper, _mm256_max_pd(upper0, upper1));
+    for (int l = 0; l < 4; ++l) {
+        s.lower = std::min(s.lower, lower[l]);
+        s.upper = std::max(s.upper, upper[l]);
+    }
+    for (; i < n; ++i)
+        s.add(xs[i]);
+    if (s.count == 0)
+        return Statistics();
+    const double mean = s.sum / s.count;
 
-    bDirty = false;
+    const __m256d mean4 = _mm256_set1_pd(mean);
+    __m256d m2_0 = zero, m2_1 = zero;
+    for (i = 0; i < simd_end; i += 8) {
+        const __m256d a = load4(xs + i), b = load4(xs + i + 4);
+        const __m256d da = _mm256_and_pd(_mm256_sub_pd(a, mean4),
+                                         _mm256_cmp_pd(a, a, _CMP_ORD_Q));
+        const __m256d db = _mm256_and_pd(_mm256_sub_pd(b, mean4),
+                                         _mm256_cmp_pd(b, b, _CMP_ORD_Q));
+        m2_0 = _mm256_fmadd_pd(da, da, m2_0);
+        m2_1 = _mm256_fmadd_pd(db, db, m2_1);
+    }
+    const double m2 = horizontal_sum(_mm256_add_pd(m2_0, m2_1)) +
+                      squared_deviations_tail(xs, simd_end, n, mean);
+    return to_statistics(s, mean, m2);
 }
 
+#endif  // UL_X86_DISPATCH
+
+template <class T>
+Statistics block_statistics_impl(const T* xs, size_t n)
+{
+#ifdef UL_X86_DISPATCH
+    static const bool use_avx2 = cpu_features().avx2 && cpu_features().fma;
+    if (use_avx2)
+        return block_statistics_avx2(xs, n);
+#endif
+    return block_statistics_portable_impl(xs, n);
+}
+
+}  // namespace
+
+Statistics block_statistics_portable(const double* xs, size_t n)
+{
+    return block_statistics_portable_impl(xs, n);
+}
+
+Statistics block_statistics_portable(const float* xs, size_t n)
+{
+    return block_statistics_portable_impl(xs, n);
+}
+
+Statistics block_statistics(const double* xs, size_t n)
+{
+    return block_statistics_impl(xs, n);
+}
+
+Statistics block_statistics(const float* xs, size_t n)
+{
+    return block_statistics_impl(xs, n);
+}
+
+}  // namespace detail
+
 }  // namespace ul
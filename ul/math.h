@@ -1,7 +1,7 @@
 #pragma once
 
 // Simple mathematical functions that could be part of standard library
-#include <cassert>
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -18,7 +18,7 @@ namespace ul {
 template <class X, class L, class U>
 bool within_co(const X& x, const L& lower, const U& upper)
 {
-    assert(lower <= upper);
+    UL_DCHECK(lower <= upper);
     return lower <= x && x < upper;
 }
 
@@ -53,9 +53,60 @@ T sec(T x)  // secant
     return 1 / cos(x);
 }
 
+// Count, mean, variance, min and max of a stream of values (NANs are
+// ignored). Accumulates the mean and the sum of squared deviations from the
+// mean (M2) with Welford's method, so the variance doesn't cancel
+// catastrophically for data with a large mean and a small variance
+// (timestamps, latencies in ns). `merge` combines two Statistics with Chan's
+// parallel formula, per-thread or per-shard accumulators can be reduced
+// without losing precision:
+//
+//     std::vector<Statistics> shards(n);
+//     ... // accumulate shards[i] in parallel
+//     Statistics total;
+//     for (auto& s : shards)
+//         total.merge(s);
 class Statistics
 {
 public:
+    // Creates Statistics from sums accumulated elsewhere (count, sum of
+    // values, sum of squares, min, max).
+    static Statistics from_sums(int64_t count,
+                                double sum,
+                                double sum2,
+                                double lower,
+                                double upper)
+    {
+        Statistics s;
+        if (count > 0) {
+            s.count_ = count;
+            s.mean_ = sum / count;
+            s.m2_ = std::max(0.0, sum2 - sum * s.mean_);
+            s.lower_ = lower;
+            s.upper_ = upper;
+        }
+        return s;
+    }
+
+    // Creates Statistics from count, mean, sum of squared deviations from the
+    // mean, min and max.
+    static Statistics from_moments(int64_t count,
+                                   double mean,
+                                   double m2,
+                                   double lower,
+                                   double upper)
+    {
+        Statistics s;
+        if (count > 0) {
+            s.count_ = count;
+            s.mean_ = mean;
+            s.m2_ = m2;
+            s.lower_ = lower;
+            s.upper_ = upper;
+        }
+        return s;
+    }
+
     void reset();
 
     void add(double d)
@@ -64,70 +115,84 @@ public:
             return;
         }
         ++count_;
-        sum_ += d;
-        sum2_ += square(d);
+        // The reciprocal doesn't depend on the previous mean, so the
+        // division is off the critical path of the loop-carried mean_.
+        const double inv_count = 1.0 / double(count_);
+        const double delta = d - mean_;
+        mean_ += delta * inv_count;
+        m2_ += delta * (d - mean_);
         if (UL_UNLIKELY(std::isnan(lower_)))
             lower_ = upper_ = d;
         else if (d < lower_)
             lower_ = d;
         else if (d > upper_)
             upper_ = d;
-        bDirty = true;
     }
 
-    double mean() const
-    {
-        update_if_needed();
-        return mean_;
-    }
+    // Adds the values of `xs` (NANs are skipped) block-by-block, with SIMD
+    // kernels where available (see detail::block_statistics). Same result as
+    // adding them one by one, within rounding.
+    void add(span<const double> xs);
+    void add(span<const float> xs);
+
+    // Adds all values added to `x`.
+    void merge(const Statistics& x);
+
+    double mean() const { return count_ > 0 ? mean_ : NAN; }
 
     double std() const  // normalized with N
     {
-        update_if_needed();
-        return std_;
+        return sqrt(var());
     }
     double std_sample() const  // normalized with N-1
     {
-        update_if_needed();
-        return std_sample_;
+        return sqrt(var_sample());
     }
 
     double var() const  // normalized with N
     {
-        update_if_needed();
-        return var_;
+        return count_ > 0 ? m2_ / count_ : NAN;
     }
     double var_sample() const  // normalized with N-1
     {
-        update_if_needed();
-        return var_sample_;
+        return count_ > 1 ? m2_ / (count_ - 1) : NAN;
     }
 
     int count() const
     {
-        CHECK(count_ <= INT_MAX);
+        UL_CHECK_ALWAYS(count_ <= INT_MAX);
         return static_cast<int>(count_);
     }
     int64_t count64() const { return count_; }
-    double sum() const { return sum_; }
-    double sum2() const { return sum2_; }
+    double sum() const { return mean_ * count_; }
+    double sum2() const { return m2_ + mean_ * mean_ * count_; }
+    // Sum of squared deviations from the mean
+    double m2() const { return m2_; }
     double upper() const { return upper_; }
     double lower() const { return lower_; }
-    void update() const;
+    // No-op, the accessors are always up-to-date. Kept for compatibility.
+    void update() const {}
 
 private:
-    void update_if_needed() const
-    {
-        if (bDirty)
-            update();
-    }
-    double sum_ = 0.0, sum2_ = 0.0;
     int64_t count_ = 0;
-
-    mutable bool bDirty = false;
-    mutable double mean_ = NAN;
-    mutable double lower_ = NAN, upper_ = NAN;
-    mutable double std_, std_sample_, var_, var_sample_;
+    double mean_ = 0.0, m2_ = 0.0;
+    double lower_ = NAN, upper_ = NAN;
 };
 
+namespace detail {
+// Statistics::add(span) processes blocks of this size, small enough to make
+// the second pass hit the L1 cache.
+const size_t c_statistics_block_size = 1024;
+
+// Statistics of xs[0..n), skipping NANs, in two passes: sum and count, then
+// sum of squared deviations from the mean. Both passes use independent
+// accumulators, the portable versions 4 scalar lanes, the AVX2 versions
+// 2 x 4 lanes.
+Statistics block_statistics_portable(const double* xs, size_t n);
+Statistics block_statistics_portable(const float* xs, size_t n);
+// Selects the AVX2 version if supported by the CPU (see cpu.h).
+Statistics block_statistics(const double* xs, size_t n);
+Statistics block_statistics(const float* xs, size_t n);
+}  // namespace detail
+
 }  // namespace ul
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <array>
-#include <cassert>
 #include <type_traits>
 #include <vector>
 
@@ -40,7 +39,7 @@ void choose_one_from_each_group(span<I> Cs, F&& f)
 {
     if (Cs.empty())
         return;
-    assert(std::all_of(Cs.begin(), Cs.end(), [](auto i) { return i > 0; }));
+    UL_DCHECK(std::all_of(Cs.begin(), Cs.end(), [](auto i) { return i > 0; }));
     std::vector<std::decay_t<I>> v(Cs.size(), I(0));
     span<I> span_out(v.data(), v.size());
     for (;;) {
@@ -185,17 +184,17 @@ std::array<T, Deg + 1> taylor_sin(T a)
 }
 
 // p and q are two functions described as polynomials. This function creates the
-// polynomial for p(q(x)).
+// polynomial for p(q(x)). Constant expression for constexpr std::arrays.
 template <class P, class Q>
-auto polycompose(const P& p, const Q& q)
+constexpr auto polycompose(const P& p, const Q& q)
 {
     auto p_bounds = get_size_bounds(p);
     auto q_bounds = get_size_bounds(q);
     static_assert(p_bounds.compile_time_capacity > 0 &&
                       q_bounds.compile_time_capacity > 0,
                   "polycompose: both input arguments must be non-empty.");
-    CHECK(p_bounds.runtime_size() > 0 && q_bounds.runtime_size() > 0,
-          "polycompose: both input arguments must be non-empty.");
+    UL_CHECK(p_bounds.runtime_size() > 0 && q_bounds.runtime_size() > 0,
+             "polycompose: both input arguments must be non-empty.");
     size_bounds_constant<1> sb_one;
     size_bounds_constant<2> sb_two;
     auto r_bounds =
@@ -278,13 +277,16 @@ auto polycompose(const P& p, const Q& q)
                 q_ad_i_copy[j] = q_ad_i[j];
             }
 
-            auto q_ad_i_copy_span =
-                make_span(q_ad_i_copy.data(), q_ad_i_highest_nonzero_ix + 1);
+            const int q_ad_i_copy_size = q_ad_i_highest_nonzero_ix + 1;
             q_ad_i_highest_nonzero_ix = i * (q.size() - 1);
 
             // q_ad_i = conv(q_ad_i, q)
-            conv_into(q_ad_i_copy_span, q,
-                      make_span(q_ad_i.data(), q_ad_i_highest_nonzero_ix + 1));
+            FOR(j, 0, <= q_ad_i_highest_nonzero_ix) { q_ad_i[j] = 0; }
+            FOR(ja, 0, < q_ad_i_copy_size)
+            {
+                FOR(jb, 0, < q.size())
+                q_ad_i[ja + jb] += q_ad_i_copy[ja] * q[jb];
+            }
 
             // result += x^i * p[i] * q_ad_i;
             FOR(j, 0, <= q_ad_i_highest_nonzero_ix)
@@ -0,0 +1,257 @@
+#include "ul/metrics.h"
+
+#include <cstring>
+#include <utility>
+
+#include "ul/check.h"
+#include "ul/stringf.h"
+
+namespace ul {
+namespace metrics {
+
+namespace detail {
+int this_thread_shard()
+{
+    static std::atomic<int> next_shard{0};
+    thread_local int shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed) % c_num_shards;
+    return shard;
+}
+}  // namespace detail
+
+int64_t Counter::value() const
+{
+    int64_t sum = 0;
+    for (auto& s : shards)
+        sum += s.value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+void Gauge::add(double x)
+{
+    double old = value_.load(std::memory_order_relaxed);
+    while (!value_.compare_exchange_weak(old, old + x,
+                                         std::memory_order_relaxed)) {
+    }
+}
+
+namespace {
+
+enum MetricKind
+{
+    kind_counter,
+    kind_gauge,
+    kind_gauge_fn,
+    kind_timer
+};
+
+bool valid_metric_name(const std::string& name)
+{
+    auto valid_first = [](char c) {
+        return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' ||
+               c == ':';
+    };
+    if (name.empty() || !valid_first(name[0]))
+        return false;
+    for (char c : name) {
+        if (!valid_first(c) && !('0' <= c && c <= '9'))
+            return false;
+    }
+    return true;
+}
+
+// Escapes backslash and newline for HELP lines.
+std::string escape_help(const std::string& help)
+{
+    std::string s;
+    for (char c : help) {
+        if (c == '\\')
+            s += "\\\\";
+        else if (c == '\n')
+            s += "\\n";
+        else
+            s += c;
+    }
+    return s;
+}
+
+void append_header(std::string& s,
+                   const std::string& name,
+                   const std::string& help,
+                   const char* type)
+{
+    if (!help.empty())
+        s += stringf("# HELP %s %s\n", name.c_str(), escape_help(help).c_str());
+    s += stringf("# TYPE %s %s\n", name.c_str(), type);
+}
+
+// Prometheus accepts NaN, +Inf and -Inf.
+std::string format_value(double x)
+{
+    if (std::isnan(x))
+        return "NaN";
+    if (std::isinf(x))
+        return x > 0 ? "+Inf" : "-Inf";
+    return stringf("%.17g", x);
+}
+
+}  // namespace
+
+std::string Snapshot::to_text() const
+{
+    std::string s;
+    for (auto& c : counters) {
+        append_header(s, c.name, c.help, "counter");
+        s += stringf("%s %lld\n", c.name.c_str(), (long long)c.value);
+    }
+    for (auto& g : gauges) {
+        append_header(s, g.name, g.help, "gauge");
+        s += stringf("%s %s\n", g.name.c_str(), format_value(g.value).c_str());
+    }
+    for (auto& t : timers) {
+        append_header(s, t.name, t.help, "summary");
+        const char* n = t.name.c_str();
+        s += stringf("%s_count %lld\n", n, (long long)t.stats.count64());
+        s += stringf("%s_sum %s\n", n, format_value(t.stats.sum()).c_str());
+        // Not part of a summary, separate gauge families.
+        const std::pair<const char*, double> gauges[] = {
+            {"min", t.stats.lower()},
+            {"max", t.stats.upper()},
+            {"mean", t.stats.mean()},
+            {"std", t.stats.std()}};
+        for (auto& g : gauges) {
+            const std::string name = stringf("%s_%s", n, g.first);
+            append_header(s, name, "", "gauge");
+            s += stringf("%s %s\n", name.c_str(),
+                         format_value(g.second).c_str());
+        }
+    }
+    return s;
+}
+
+struct Registry::Entry
+{
+    std::string name, help;
+    int kind;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::function<double()> gauge_fn;
+    std::unique_ptr<Timer> timer;
+};
+
+Registry::Registry() = default;
+Registry::~Registry() = default;
+
+Registry::Entry& Registry::find_or_add(const std::string& name,
+                                       const std::string& help,
+                                       int kind)
+{
+    UL_CHECK(valid_metric_name(name), "Invalid metric name \"%s\".",
+             name.c_str());
+    for (auto& e : entries) {
+        if (e->name == name) {
+            UL_CHECK(e->kind == kind,
+                     "Metric \"%s\" is already registered as another kind.",
+                     name.c_str());
+            return *e;
+        }
+    }
+    entries.emplace_back(new Entry);
+    auto& e = *entries.back();
+    e.name = name;
+    e.help = help;
+    e.kind = kind;
+    return e;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& e = find_or_add(name, help, kind_counter);
+    if (!e.counter)
+        e.counter.reset(new Counter);
+    return *e.counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& e = find_or_add(name, help, kind_gauge);
+    if (!e.gauge)
+        e.gauge.reset(new Gauge);
+    return *e.gauge;
+}
+
+void Registry::gauge_fn(const std::string& name,
+                        std::function<double()> f,
+                        const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    find_or_add(name, help, kind_gauge_fn).gauge_fn = std::move(f);
+}
+
+Timer& Registry::timer(const std::string& name, const std::string& help)
+{
+    // Takes about 20 ms the first time, not under the lock.
+    tsc_clock::calibrate();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& e = find_or_add(name, help, kind_timer);
+    if (!e.timer)
+        e.timer.reset(new Timer);
+    return *e.timer;
+}
+
+Snapshot Registry::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot s;
+    for (auto& e : entries) {
+        switch (e->kind) {
+            case kind_counter:
+                s.counters.push_back({e->name, e->help, e->counter->value()});
+                break;
+            case kind_gauge:
+                s.gauges.push_back({e->name, e->help, e->gauge->value()});
+                break;
+            case kind_gauge_fn:
+                s.gauges.push_back({e->name, e->help, e->gauge_fn()});
+                break;
+            case kind_timer:
+                s.timers.push_back(
+                    {e->name, e->help, e->timer->statistics()});
+                break;
+            default:
+                UL_UNREACHABLE;
+        }
+    }
+    return s;
+}
+
+void Registry::write_text(FILE* f) const
+{
+    fputs(snapshot().to_text().c_str(), f);
+}
+
+bool Registry::write_text_file(const std::string& path) const
+{
+    const std::string text = snapshot().to_text();
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "w");
+    if (!f)
+        return false;
+    const bool written = fwrite(text.data(), 1, text.size(), f) == text.size();
+    if (fclose(f) != 0 || !written) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+Registry& default_registry()
+{
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+}  // namespace metrics
+}  // namespace ul
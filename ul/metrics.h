@@ -0,0 +1,202 @@
+#pragma once
+
+// Registry of named counters, gauges and timers, cheap enough for hot paths
+//
+//     static auto& tokens = ul::metrics::default_registry().counter(
+//         "tokens_split_total", "Number of tokens produced by split");
+//     ...
+//     tokens.add(parts.size());
+//
+//     static auto& parse_time = ul::metrics::default_registry().timer(
+//         "parse_seconds", "Time spent parsing");
+//     {
+//         ul::metrics::Timer::Scope t(parse_time);
+//         ...
+//     }
+//     ...
+//     ul::metrics::default_registry().write_text_file("/tmp/app.metrics");
+//
+// Registration looks up the name under a mutex and returns a handle which
+// stays valid as long as the registry, so the hot path does no lookup.
+// Registering the same name again returns the same handle.
+//
+// - Counter: monotonic int64. Each thread adds to one of `c_num_shards`
+//   cache-line padded shards with a relaxed fetch_add, so increments of
+//   different threads don't contend (as long as there are fewer threads
+//   than shards).
+// - Gauge: a double which is set or adjusted, or a callback evaluated at
+//   snapshot time (e.g. `ul::check_failed_count`).
+// - Timer: Statistics of durations in seconds, recorded explicitly or with
+//   the RAII `Timer::Scope` (tsc_clock ticks), in a ConcurrentStatistics:
+//   each thread writes its own shard under a sequence lock, so writers never
+//   wait and snapshots retry instead of blocking them.
+//
+// `snapshot()` merges the shards while writers keep running, a snapshot may
+// miss the most recent updates. It serializes to the Prometheus text
+// exposition format, counters and gauges as is, timers as summaries
+// (`_count`, `_sum`) and separate `_min`, `_max`, `_mean`, `_std` gauges.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ul/clock.h"
+#include "ul/concurrent_statistics.h"
+#include "ul/math.h"
+
+namespace ul {
+namespace metrics {
+
+const int c_num_shards = 16;
+
+namespace detail {
+// Index of the calling thread's shard, assigned round-robin on first use.
+int this_thread_shard();
+}  // namespace detail
+
+class Counter
+{
+public:
+    void add(int64_t n = 1)
+    {
+        shards[detail::this_thread_shard()].value.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+    void increment() { add(1); }
+
+    // Sum of the shards.
+    int64_t value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<int64_t> value{0};
+    };
+    Shard shards[c_num_shards];
+};
+
+class Gauge
+{
+public:
+    void set(double x) { value_.store(x, std::memory_order_relaxed); }
+    void add(double x);
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+class Timer
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope(Timer& timer) : timer(timer), t0(tsc_clock::ticks()) {}
+        ~Scope()
+        {
+            timer.record(double(tsc_clock::ticks() - t0) *
+                         timer.seconds_per_tick);
+        }
+
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+
+    private:
+        Timer& timer;
+        uint64_t t0;
+    };
+
+    // Calibrates tsc_clock if needed.
+    Timer() : seconds_per_tick(1 / tsc_clock::ticks_per_second()) {}
+
+    // NANs are skipped.
+    void record(double seconds) { stats.add(seconds); }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d)
+    {
+        record(std::chrono::duration<double>(d).count());
+    }
+
+    // Merged statistics of the shards.
+    Statistics statistics() const { return stats.snapshot(); }
+
+private:
+    ConcurrentStatistics stats;
+    const double seconds_per_tick;
+};
+
+struct Snapshot
+{
+    struct CounterValue
+    {
+        std::string name, help;
+        int64_t value;
+    };
+    struct GaugeValue
+    {
+        std::string name, help;
+        double value;
+    };
+    struct TimerValue
+    {
+        std::string name, help;
+        Statistics stats;  // seconds
+    };
+
+    // In order of registration
+    std::vector<CounterValue> counters;
+    std::vector<GaugeValue> gauges;
+    std::vector<TimerValue> timers;
+
+    // Prometheus text exposition format
+    std::string to_text() const;
+};
+
+class Registry
+{
+public:
+    Registry();
+    ~Registry();
+
+    Registry(const Registry&) = delete;
+    void operator=(const Registry&) = delete;
+
+    // `name` must be a valid Prometheus metric name
+    // ([a-zA-Z_:][a-zA-Z0-9_:]*) and can't be registered with another kind.
+    Counter& counter(const std::string& name, const std::string& help = "");
+    Gauge& gauge(const std::string& name, const std::string& help = "");
+    void gauge_fn(const std::string& name,
+                  std::function<double()> f,
+                  const std::string& help = "");
+    Timer& timer(const std::string& name, const std::string& help = "");
+
+    Snapshot snapshot() const;
+
+    void write_text(FILE* f) const;
+    // Writes to a temporary file and renames it to `path`, so scrapers never
+    // see a partial file. Returns false on I/O errors.
+    bool write_text_file(const std::string& path) const;
+
+private:
+    struct Entry;
+
+    Entry& find_or_add(const std::string& name,
+                       const std::string& help,
+                       int kind);
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+};
+
+// Process-wide registry, never destroyed.
+Registry& default_registry();
+
+}  // namespace metrics
+}  // namespace ul
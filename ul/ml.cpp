@@ -0,0 +1,348 @@
+#include "ul/ml.h"
+
+#include <vector>
+
+#include "ul/config.h"
+#include "ul/cpu.h"
+#include "ul/simd.h"
+
+namespace ul {
+
+namespace {
+
+// Values before and after the current one in a window of `window` values.
+struct WindowExtent
+{
+    int before, after;
+
+    explicit WindowExtent(int window)
+        : before(window / 2), after((window - 1) / 2)
+    {
+    }
+};
+
+void check_moving_args(span<const double> x, int window, span<double> out)
+{
+    UL_CHECK(window > 0, "Invalid window %d.", window);
+    UL_CHECK(out.size() == x.size(), "Output size %d, expected %d.",
+             int(out.size()), int(x.size()));
+}
+
+// `better(a, b)`: a is kept over b (min: a < b).
+template <class Better>
+void moving_extreme(span<const double> x,
+                    int window,
+                    span<double> out,
+                    Better better)
+{
+    check_moving_args(x, window, out);
+    const int n = int(x.size());
+    const WindowExtent w(window);
+    // Monotonic queue of indices, each index is pushed once.
+    std::vector<int> queue(x.size());
+    int head = 0, tail = 0;
+    int next = 0;  // next index to push
+    for (int i = 0; i < n; ++i) {
+        for (const int end = std::min(n - 1, i + w.after); next <= end;
+             ++next) {
+            while (tail > head && !better(x[queue[tail - 1]], x[next]))
+                --tail;
+            queue[tail++] = next;
+        }
+        while (queue[head] < i - w.before)
+            ++head;
+        out[i] = x[queue[head]];
+    }
+}
+
+}  // namespace
+
+void moving_mean(span<const double> x, int window, span<double> out)
+{
+    check_moving_args(x, window, out);
+    const int n = int(x.size());
+    const WindowExtent w(window);
+    // Sum of x[lo, hi), recomputed at i = 0, window, 2 * window, ...
+    int lo = 0, hi = 0;
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        const int new_lo = std::max(0, i - w.before);
+        const int new_hi = std::min(n, i + w.after + 1);
+        if (i % window == 0) {
+            sum = 0;
+            for (int j = new_lo; j < new_hi; ++j)
+                sum += x[j];
+        } else {
+            if (new_hi > hi)
+                sum += x[hi];
+            if (new_lo > lo)
+                sum -= x[lo];
+        }
+        lo = new_lo;
+        hi = new_hi;
+        out[i] = sum / (hi - lo);
+    }
+}
+
+void moving_min(span<const double> x, int window, span<double> out)
+{
+    moving_extreme(x, window, out, [](double a, double b) { return a < b; });
+}
+
+void moving_max(span<const double> x, int window, span<double> out)
+{
+    moving_extreme(x, window, out, [](double a, double b) { return a > b; });
+}
+
+namespace {
+
+// Estrin's scheme for the last vectors of a batch from this many
+// coefficients (degree + 1) on, see polyval_avx2.
+const int c_polyval_estrin_min_size = 8;
+
+// Batched polyval kernel for p[0, n), n > 0 coefficients. `q` is p padded
+// with zeros to a multiple of 4 coefficients if n >=
+// c_polyval_estrin_min_size, else null.
+template <class T>
+using PolyvalFn = void (*)(const T* p,
+                           const T* q,
+                           int n,
+                           const T* xs,
+                           T* out,
+                           size_t count);
+
+template <class T>
+T horner(const T* p, int n, T x)
+{
+    T acc = p[n - 1];
+    for (int i = n - 2; i >= 0; --i)
+        acc = detail::mul_add(acc, x, p[i]);
+    return acc;
+}
+
+// Horner's scheme for 8 points at a time, in independent scalar lanes.
+template <class T>
+void polyval_portable(const T* p,
+                      const T*,
+                      int n,
+                      const T* xs,
+                      T* out,
+                      size_t count)
+{
+    const size_t c_lanes = 8;
+    size_t k = 0;
+    for (; k + c_lanes <= count; k += c_lanes) {
+        T a[c_lanes];
+        for (size_t u = 0; u < c_lanes; ++u)
+            a[u] = p[n - 1];
+        for (int i = n - 2; i >= 0; --i) {
+            for (size_t u = 0; u < c_lanes; ++u)
+                a[u] = a[u] * xs[k + u] + p[i];
+        }
+        for (size_t u = 0; u < c_lanes; ++u)
+            out[k + u] = a[u];
+    }
+    for (; k < count; ++k)
+        out[k] = horner(p, n, xs[k]);
+}
+
+#ifdef UL_X86_DISPATCH
+
+// Horner's scheme is one dependent FMA per coefficient, so the kernels
+// evaluate 8 vectors of points at a time to keep the FMA units busy. The
+// remaining vectors are evaluated one by one, and for high degrees with
+// Estrin's scheme: p(x) = a0(y) + x a1(y) + x^2 (a2(y) + x a3(y)) with
+// y = x^4 and a_j(y) = sum q[4 i + j] y^i, four independent chains of n / 4
+// steps instead of one chain of n steps.
+
+template <class T>
+UL_TARGET("avx2,fma")
+void polyval_avx2(const T* p,
+                  const T* q,
+                  int n,
+                  const T* xs,
+                  T* out,
+                  size_t count)
+{
+    using S = detail::Avx2<T>;
+    using V = typename S::V;
+    const size_t w = S::c_width;
+    size_t k = 0;
+    for (; k + 8 * w <= count; k += 8 * w) {
+        V a[8];
+        for (size_t u = 0; u < 8; ++u)
+            a[u] = S::set1(p[n - 1]);
+        // 16 registers: the points are loaded again for each coefficient.
+        for (int i = n - 2; i >= 0; --i) {
+            const V c = S::set1(p[i]);
+            for (size_t u = 0; u < 8; ++u)
+                a[u] = S::fmadd(a[u], S::load(xs + k + u * w), c);
+        }
+        for (size_t u = 0; u < 8; ++u)
+            S::store(out + k + u * w, a[u]);
+    }
+    for (; k + w <= count; k += w) {
+        const V x = S::load(xs + k);
+        if (!q) {
+            V a = S::set1(p[n - 1]);
+            for (int i = n - 2; i >= 0; --i)
+                a = S::fmadd(a, x, S::set1(p[i]));
+            S::store(out + k, a);
+            continue;
+        }
+        const int m = (n + 3) / 4 * 4;
+        const V xx = S::mul(x, x), y = S::mul(xx, xx);
+        V a0 = S::set1(q[m - 4]), a1 = S::set1(q[m - 3]);
+        V a2 = S::set1(q[m - 2]), a3 = S::set1(q[m - 1]);
+        for (int i = m - 8; i >= 0; i -= 4) {
+            a0 = S::fmadd(a0, y, S::set1(q[i]));
+            a1 = S::fmadd(a1, y, S::set1(q[i + 1]));
+            a2 = S::fmadd(a2, y, S::set1(q[i + 2]));
+            a3 = S::fmadd(a3, y, S::set1(q[i + 3]));
+        }
+        const V lo = S::fmadd(a1, x, a0), hi = S::fmadd(a3, x, a2);
+        S::store(out + k, S::fmadd(hi, xx, lo));
+    }
+    for (; k < count; ++k)
+        out[k] = horner(p, n, xs[k]);
+}
+
+// Same as polyval_avx2 with 512-bit vectors, and 32 registers for the
+// points.
+template <class T>
+UL_TARGET("avx512f")
+void polyval_avx512(const T* p,
+                    const T* q,
+                    int n,
+                    const T* xs,
+                    T* out,
+                    size_t count)
+{
+    using S = detail::Avx512<T>;
+    using V = typename S::V;
+    const size_t w = S::c_width;
+    size_t k = 0;
+    for (; k + 8 * w <= count; k += 8 * w) {
+        V x[8], a[8];
+        for (size_t u = 0; u < 8; ++u) {
+            x[u] = S::load(xs + k + u * w);
+            a[u] = S::set1(p[n - 1]);
+        }
+        for (int i = n - 2; i >= 0; --i) {
+            const V c = S::set1(p[i]);
+            for (size_t u = 0; u < 8; ++u)
+                a[u] = S::fmadd(a[u], x[u], c);
+        }
+        for (size_t u = 0; u < 8; ++u)
+            S::store(out + k + u * w, a[u]);
+    }
+    for (; k + w <= count; k += w) {
+        const V x = S::load(xs + k);
+        if (!q) {
+            V a = S::set1(p[n - 1]);
+            for (int i = n - 2; i >= 0; --i)
+                a = S::fmadd(a, x, S::set1(p[i]));
+            S::store(out + k, a);
+            continue;
+        }
+        const int m = (n + 3) / 4 * 4;
+        const V xx = S::mul(x, x), y = S::mul(xx, xx);
+        V a0 = S::set1(q[m - 4]), a1 = S::set1(q[m - 3]);
+        V a2 = S::set1(q[m - 2]), a3 = S::set1(q[m - 1]);
+        for (int i = m - 8; i >= 0; i -= 4) {
+            a0 = S::fmadd(a0, y, S::set1(q[i]));
+            a1 = S::fmadd(a1, y, S::set1(q[i + 1]));
+            a2 = S::fmadd(a2, y, S::set1(q[i + 2]));
+            a3 = S::fmadd(a3, y, S::set1(q[i + 3]));
+        }
+        const V lo = S::fmadd(a1, x, a0), hi = S::fmadd(a3, x, a2);
+        S::store(out + k, S::fmadd(hi, xx, lo));
+    }
+    for (; k < count; ++k)
+        out[k] = horner(p, n, xs[k]);
+}
+
+#endif  // UL_X86_DISPATCH
+
+template <class T>
+PolyvalFn<T> select_polyval()
+{
+#ifdef UL_X86_DISPATCH
+    const CpuFeatures& f = cpu_features();
+    if (f.avx512f)
+        return polyval_avx512<T>;
+    if (f.avx2 && f.fma)
+        return polyval_avx2<T>;
+#endif
+    return polyval_portable<T>;
+}
+
+template <class T>
+void polyval_batch_impl(const T* p,
+                        int n,
+                        const T* xs,
+                        T* out,
+                        size_t count)
+{
+    static const PolyvalFn<T> polyval = select_polyval<T>();
+    if (n < c_polyval_estrin_min_size) {
+        polyval(p, nullptr, n, xs, out, count);
+        return;
+    }
+    const int m = (n + 3) / 4 * 4;
+    const int c_inline_coefs = 64;
+    T inline_q[c_inline_coefs];
+    std::vector<T> heap_q;
+    T* q = inline_q;
+    if (m > c_inline_coefs) {
+        heap_q.resize(size_t(m));
+        q = heap_q.data();
+    }
+    std::copy(p, p + n, q);
+    std::fill(q + n, q + m, T(0));
+    polyval(p, q, n, xs, out, count);
+}
+
+}  // namespace
+
+namespace detail {
+
+void polyval_batch(const double* p,
+                   int n,
+                   const double* xs,
+                   double* out,
+                   size_t count)
+{
+    polyval_batch_impl(p, n, xs, out, count);
+}
+
+void polyval_batch(const float* p,
+                   int n,
+                   const float* xs,
+                   float* out,
+                   size_t count)
+{
+    polyval_batch_impl(p, n, xs, out, count);
+}
+
+void polyval_batch_portable(const double* p,
+                            int n,
+                            const double* xs,
+                            double* out,
+                            size_t count)
+{
+    polyval_portable<double>(p, nullptr, n, xs, out, count);
+}
+
+void polyval_batch_portable(const float* p,
+                            int n,
+                            const float* xs,
+                            float* out,
+                            size_t count)
+{
+    polyval_portable<float>(p, nullptr, n, xs, out, count);
+}
+
+}  // namespace detail
+
+}  // namespace ul
@@ -2,12 +2,21 @@
 
 #include "ul/span.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "ul/check.h"
+#include "ul/config.h"
+#include "ul/conv.h"
+#include "ul/fft.h"
 #include "ul/inlinevector.h"
 #include "ul/math.h"
+#include "ul/polyfit.h"
+#include "ul/roots.h"
 #include "ul/size_bounds.h"
 #include "ul/type_traits.h"
 
@@ -15,30 +24,105 @@
 
 namespace ul {
 
+namespace detail {
+
+// a * b + c, with a single rounding where the target has FMA instructions
+// (std::fma is a slow library call elsewhere). Rounds twice in constant
+// expressions.
+template <class T>
+constexpr T mul_add(T a, T b, T c)
+{
+#ifdef UL_IS_CONSTANT_EVALUATED
+    if (!UL_IS_CONSTANT_EVALUATED()) {
+#ifdef FP_FAST_FMA
+        if constexpr (std::is_same<T, double>::value)
+            return std::fma(a, b, c);
+#endif
+#ifdef FP_FAST_FMAF
+        if constexpr (std::is_same<T, float>::value)
+            return std::fma(a, b, c);
+#endif
+    }
+#endif
+    return a * b + c;
+}
+
+// Batched polyval kernels, n > 0 coefficients.
+void polyval_batch(const double* p,
+                   int n,
+                   const double* xs,
+                   double* out,
+                   size_t count);
+void polyval_batch(const float* p,
+                   int n,
+                   const float* xs,
+                   float* out,
+                   size_t count);
+// Without the SIMD kernels.
+void polyval_batch_portable(const double* p,
+                            int n,
+                            const double* xs,
+                            double* out,
+                            size_t count);
+void polyval_batch_portable(const float* p,
+                            int n,
+                            const float* xs,
+                            float* out,
+                            size_t count);
+
+}  // namespace detail
+
+// p[0] + p[1] x + p[2] x^2 + ..., with Horner's scheme. Constant expression
+// for a constexpr std::array p.
 template <class V, class U>
-auto polyval(const V& p, U x) -> decltype(p[0] * U(0))
+constexpr auto polyval(const V& p, U x) -> decltype(p[0] * U(0))
 {
     using R = decltype(p[0] * U(0));
-    switch (p.size()) {
-        case 0:
-            return 0;
-        case 1:
-            return p[0];
-        case 2:
-            return p[0] + x * p[1];
-        default:
-            R xa = x;
-            R acc = p[0] + p[1] * x;
-            for (int i = 2; i < p.size(); ++i) {
-                xa *= x;
-                acc += p[i] * xa;
-            }
-            return acc;
+    const int n = int(p.size());
+    if (n == 0)
+        return 0;
+    R acc = p[n - 1];
+    for (int i = n - 2; i >= 0; --i)
+        acc = detail::mul_add(acc, R(x), R(p[i]));
+    return acc;
+}
+
+// out[i] = polyval(p, xs[i]) for double or float values, vectorized across
+// the points: Horner's scheme on 8 vectors of points at a time, and for the
+// last vectors, where there are too few points to hide the latency of the
+// FMAs, Estrin's scheme (4 interleaved chains in x^4) from degree 7 on. AVX2
+// and AVX-512 kernels are selected at runtime (see cpu.h). Rounding can
+// differ from the scalar polyval, infinite xs can give NAN.
+template <class V, class X, class T>
+void polyval(const V& p, span<X> xs, span<T> out)
+{
+    static_assert(std::is_same<T, double>::value ||
+                      std::is_same<T, float>::value,
+                  "polyval: batches of double or float values only.");
+    static_assert(std::is_same<std::remove_const_t<X>, T>::value,
+                  "polyval: different input and output types.");
+    UL_CHECK(out.size() == xs.size(), "polyval: %d outputs for %d values.",
+             int(out.size()), int(xs.size()));
+    const int n = int(p.size());
+    if (n == 0) {
+        std::fill(out.begin(), out.end(), T(0));
+        return;
     }
+    const int c_inline_coefs = 32;
+    T inline_coefs[c_inline_coefs];
+    std::vector<T> heap_coefs;
+    T* coefs = inline_coefs;
+    if (n > c_inline_coefs) {
+        heap_coefs.resize(size_t(n));
+        coefs = heap_coefs.data();
+    }
+    for (int i = 0; i < n; ++i)
+        coefs[i] = T(p[i]);
+    detail::polyval_batch(coefs, n, xs.data(), out.data(), xs.size());
 }
 
 template <class V>
-auto polyder(const V& p)
+constexpr auto polyder(const V& p)
 {
 #if 0
     using traits = sequence_compile_time_size_traits<V>;
@@ -58,12 +142,12 @@ auto polyder(const V& p)
         p_size_bounds.compile_time_capacity == c_runtime_size_marker ||
             p_size_bounds.compile_time_capacity > 0,
         "polyder: argument has zero size.");
-    assert(p.size() > 0);
+    UL_DCHECK(p.size() > 0);
     auto result =
         make_uninitialized_array_or_inlinevector_or_vector<UL_DECAYDECL(p[0])>(
             p_size_bounds - size_bounds_constant<1>());
 #endif
-    assert(result.size() + 1 == p.size());
+    UL_DCHECK(result.size() + 1 == p.size());
     for (int i = 0; i + 1 < p.size(); ++i) {
         result[i] = (i + 1) * p[i + 1];
     }
@@ -71,7 +155,7 @@ auto polyder(const V& p)
 }
 
 template <class V>
-auto polyint(const V& p, UL_DECAYDECL(p[0]) C0 = 0)
+constexpr auto polyint(const V& p, UL_DECAYDECL(p[0]) C0 = 0)
 {
 #if 0
     using traits = sequence_compile_time_size_traits<V>;
@@ -87,12 +171,12 @@ auto polyint(const V& p, UL_DECAYDECL(p[0]) C0 = 0)
         p_size_bounds.compile_time_capacity == c_runtime_size_marker ||
             p_size_bounds.compile_time_capacity > 0,
         "polyint: argument has zero size.");
-    assert(p.size() > 0);
+    UL_DCHECK(p.size() > 0);
     auto result =
         make_uninitialized_array_or_inlinevector_or_vector<UL_DECAYDECL(p[0])>(
             p_size_bounds + size_bounds_constant<1>());
 #endif
-    assert(result.size() == p.size() + 1);
+    UL_DCHECK(result.size() == p.size() + 1);
     result[0] = C0;
     for (int i = 0; i < p.size(); ++i) {
         result[i + 1] = p[i] / (i + 1);
@@ -104,7 +188,7 @@ auto polyint(const V& p, UL_DECAYDECL(p[0]) C0 = 0)
 // size_bounds-based proves stable.
 
 template <class X, class Y, class Result>
-void conv_into_nocheck(const X& x, const Y& y, Result&& result)
+constexpr void conv_into_nocheck(const X& x, const Y& y, Result&& result)
 {
     // result is initialized to zero
     for (int i = 0; i < x.size(); ++i) {
@@ -115,7 +199,7 @@ void conv_into_nocheck(const X& x, const Y& y, Result&& result)
 }
 
 template <class X, class Y>
-auto conv_get_result_size_bounds(const X& x, const Y& y)
+constexpr auto conv_get_result_size_bounds(const X& x, const Y& y)
 {
     auto x_size_bounds = get_size_bounds(x);
     auto y_size_bounds = get_size_bounds(y);
@@ -133,18 +217,171 @@ auto conv_get_result_size_bounds(const X& x, const Y& y)
                size_bounds_constant<0>());
 }
 
+namespace detail {
+
+// conv switches from conv_direct to conv_fft when the shorter sequence has
+// at least c_conv_fft_min_size values and the direct convolution would take
+// at least c_conv_fft_min_products multiplications (result size times the
+// shorter size). Measured with microlib-bench --filter=conv_ against the
+// AVX-512 kernel, they are about as fast for 256 values.
+const int c_conv_fft_min_size = 256;
+const int64_t c_conv_fft_min_products = 1 << 18;
+
+template <class X, class Y>
+using conv_value_t =
+    std::decay_t<decltype(std::declval<X>()[0] * std::declval<Y>()[0])>;
+
+// conv_direct_into (conv.h) and conv_fft_into (fft.h) take double or float
+// sequences of runtime size, stored contiguously.
+template <class X, class Y>
+constexpr bool conv_uses_spans()
+{
+    using T = conv_value_t<X, Y>;
+    using XT = std::decay_t<decltype(std::declval<X>()[0])>;
+    using YT = std::decay_t<decltype(std::declval<Y>()[0])>;
+    return (std::is_same<T, double>::value || std::is_same<T, float>::value) &&
+           std::is_same<XT, T>::value && std::is_same<YT, T>::value &&
+           decltype(conv_get_result_size_bounds(std::declval<X>(),
+                                                std::declval<Y>()))::
+                   compile_time_capacity == c_runtime_size_marker;
+}
+
+inline bool conv_prefers_fft(int x_size, int y_size, int result_size)
+{
+    const int shorter = std::min(x_size, y_size);
+    return shorter >= c_conv_fft_min_size &&
+           int64_t(result_size) * shorter >= c_conv_fft_min_products;
+}
+
+enum class ConvMethod
+{
+    automatic,
+    direct,
+    fft
+};
+
+// result = conv(x, y, shape), `result` has the right size.
+template <class X, class Y, class Result>
+void conv_shaped_into(const X& x,
+                      const Y& y,
+                      Result& result,
+                      ConvShape shape,
+                      ConvMethod method)
+{
+    using T = conv_value_t<X, Y>;
+    if constexpr (conv_uses_spans<X, Y>() &&
+                  std::is_same<std::decay_t<decltype(result[0])>, T>::value) {
+        if (x.size() == 0 || y.size() == 0) {
+            std::fill(BE(result), T(0));
+            return;
+        }
+        const auto xs = make_span(x.data(), size_t(x.size()));
+        const auto ys = make_span(y.data(), size_t(y.size()));
+        const auto rs = make_span(result.data(), size_t(result.size()));
+        if (method == ConvMethod::fft ||
+            (method == ConvMethod::automatic &&
+             conv_prefers_fft(int(x.size()), int(y.size()),
+                              int(result.size())))) {
+            conv_fft_into(xs, ys, rs, shape);
+        } else {
+            conv_direct_into(xs, ys, rs, shape);
+        }
+    } else {
+        auto full =
+            make_zero_initialized_array_or_inlinevector_or_vector<T>(
+                conv_get_result_size_bounds(x, y));
+        conv_into_nocheck(x, y, full);
+        const size_t offset = conv_result_offset(x.size(), y.size(), shape);
+        for (size_t i = 0; i < size_t(result.size()); ++i)
+            result[i] = full[offset + i];
+    }
+}
+
+template <class X, class Y>
+auto conv_shaped(const X& x, const Y& y, ConvShape shape, ConvMethod method)
+{
+    std::vector<conv_value_t<X, Y>> result(
+        conv_result_size(x.size(), y.size(), shape));
+    conv_shaped_into(x, y, result, shape, method);
+    return result;
+}
+
+}  // namespace detail
+
+// The convolution by definition, O(x.size() * y.size()). Double and float
+// vectors use the SIMD kernels of conv.h. Constant expression for constexpr
+// std::arrays.
 template <class X, class Y>
-auto conv(const X& x, const Y& y)
+constexpr auto conv_direct(const X& x, const Y& y)
 {
     auto result =
         make_zero_initialized_array_or_inlinevector_or_vector<decltype(
             x[0] * y[0])>(conv_get_result_size_bounds(x, y));
 
-    conv_into_nocheck(x, y, result);
+    if constexpr (detail::conv_uses_spans<X, Y>()) {
+        detail::conv_shaped_into(x, y, result, ConvShape::full,
+                                 detail::ConvMethod::direct);
+    } else {
+        conv_into_nocheck(x, y, result);
+    }
 
     return result;
 }
 
+// The convolution with FFTs, O((x.size() + y.size()) log min(x.size(),
+// y.size())), see fft.h. For double or float sequences with runtime size
+// (vectors). Differs from conv_direct by rounding errors relative to the
+// largest values of the result.
+template <class X, class Y>
+auto conv_fft(const X& x, const Y& y)
+{
+    static_assert(detail::conv_uses_spans<X, Y>(),
+                  "conv_fft: needs double or float sequences of runtime size.");
+    auto result =
+        make_zero_initialized_array_or_inlinevector_or_vector<decltype(
+            x[0] * y[0])>(conv_get_result_size_bounds(x, y));
+
+    detail::conv_shaped_into(x, y, result, ConvShape::full,
+                             detail::ConvMethod::fft);
+
+    return result;
+}
+
+// conv_fft for double or float vectors long enough for it to be faster (see
+// detail::conv_prefers_fft), else conv_direct.
+template <class X, class Y>
+constexpr auto conv(const X& x, const Y& y)
+{
+    if constexpr (detail::conv_uses_spans<X, Y>()) {
+        if (detail::conv_prefers_fft(int(x.size()), int(y.size()),
+                                     int(x.size() + y.size()) - 1))
+            return conv_fft(x, y);
+    }
+    return conv_direct(x, y);
+}
+
+// Part of the convolution, like matlab's conv(x, y, 'same') (see ConvShape),
+// as a vector. Empty if x or y is empty.
+template <class X, class Y>
+auto conv(const X& x, const Y& y, ConvShape shape)
+{
+    return detail::conv_shaped(x, y, shape, detail::ConvMethod::automatic);
+}
+
+template <class X, class Y>
+auto conv_direct(const X& x, const Y& y, ConvShape shape)
+{
+    return detail::conv_shaped(x, y, shape, detail::ConvMethod::direct);
+}
+
+template <class X, class Y>
+auto conv_fft(const X& x, const Y& y, ConvShape shape)
+{
+    static_assert(detail::conv_uses_spans<X, Y>(),
+                  "conv_fft: needs double or float sequences of runtime size.");
+    return detail::conv_shaped(x, y, shape, detail::ConvMethod::fft);
+}
+
 template <class X, class Y, class Result>
 void conv_into(const X& x, const Y& y, Result&& result)
 {
@@ -169,7 +406,7 @@ void conv_into(const X& x, const Y& y, Result&& result)
                       r_size_bounds_expected.compile_time_size ==
                           c_runtime_size_marker) {
             // ... at runtime ...
-            CHECK(result.size() == r_size_bounds_expected.runtime_size());
+            UL_CHECK(result.size() == r_size_bounds_expected.runtime_size());
         } else {
             // .. or at compile time.
             static_assert(r_size_bounds_actual.compile_time_size ==
@@ -177,7 +414,28 @@ void conv_into(const X& x, const Y& y, Result&& result)
         }
         std::fill(BE(result), 0);
     }
-    conv_into_nocheck(x, y, result);
+    if constexpr (detail::conv_uses_spans<X, Y>()) {
+        detail::conv_shaped_into(x, y, result, ConvShape::full,
+                                 detail::ConvMethod::automatic);
+    } else {
+        conv_into_nocheck(x, y, result);
+    }
+}
+
+// Resizes `result` if resizable, else checks its size.
+template <class X, class Y, class Result>
+void conv_into(const X& x, const Y& y, Result&& result, ConvShape shape)
+{
+    const size_t size = conv_result_size(x.size(), y.size(), shape);
+    if constexpr (is_resizable<std::decay_t<Result>>::value) {
+        result.resize(size);
+    } else {
+        UL_CHECK(size_t(result.size()) == size,
+                 "conv: result size %d, expected %d.", int(result.size()),
+                 int(size));
+    }
+    detail::conv_shaped_into(x, y, result, shape,
+                             detail::ConvMethod::automatic);
 }
 
 template <class T>
@@ -212,4 +470,15 @@ inline double db2mag(double db)
     return pow(10, db / 20);
 }
 
+// Moving mean, min and max over `window` values like matlab's movmean,
+// movmin and movmax: the window is centered on each value (odd `window`),
+// or has one more value before it than after (even `window`), and shrinks at
+// the ends. `out` has the size of `x`, `x` must not contain NANs.
+//
+// O(size) for any window: the mean slides a sum which is recomputed every
+// `window` values to bound the drift, min and max use monotonic queues.
+void moving_mean(span<const double> x, int window, span<double> out);
+void moving_min(span<const double> x, int window, span<double> out);
+void moving_max(span<const double> x, int window, span<double> out);
+
 }  // namespace ul
@@ -0,0 +1,178 @@
+#include "ul/percentiles.h"
+
+#include <cstdint>
+#include <thread>
+
+namespace ul {
+
+namespace {
+
+// Runs f(t) for t in [0, num_threads), f(0) in the calling thread.
+template <class F>
+void run_threads(int num_threads, F f)
+{
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t)
+        threads.emplace_back([&f, t]() { f(t); });
+    f(0);
+    for (auto& t : threads)
+        t.join();
+}
+
+template <class T>
+void percentiles_parallel_impl(span<const T> x,
+                               span<const double> ps,
+                               span<double> out,
+                               int num_threads)
+{
+    UL_CHECK(out.size() == ps.size(), "%d outputs for %d percentiles.",
+             int(out.size()), int(ps.size()));
+    if (num_threads <= 0)
+        num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+    const size_t n = x.size();
+    if (n < detail::c_percentiles_parallel_min_size || ps.empty() ||
+        num_threads == 1) {
+        auto v = percentiles(x, ps);
+        std::copy(v.begin(), v.end(), out.begin());
+        return;
+    }
+
+    // Pivots: sample values around the fraction p / 100 of the sorted
+    // sample, 4 standard deviations of the sampled rank apart.
+    const size_t c_sample_size = 4096;
+    std::vector<T> sample;
+    for (size_t i = 0; i < c_sample_size; ++i) {
+        const T v = x[i * n / c_sample_size];
+        if (v == v)
+            sample.push_back(v);
+    }
+    std::sort(sample.begin(), sample.end());
+    std::vector<T> pivots;
+    const double s = double(sample.size());
+    for (double p : ps) {
+        if (sample.empty())
+            break;
+        const double q = p / 100;
+        const double d = 4 * sqrt(s * q * (1 - q)) + 2;
+        for (double r : {q * s - d, q * s + d}) {
+            r = std::min(std::max(r, 0.0), s - 1);
+            pivots.push_back(sample[size_t(r)]);
+        }
+    }
+    std::sort(pivots.begin(), pivots.end());
+    pivots.erase(std::unique(pivots.begin(), pivots.end()), pivots.end());
+
+    // Bucket b holds pivots[b - 1] <= v < pivots[b], the last bucket NANs.
+    const size_t num_buckets = pivots.size() + 2;
+    const size_t nan_bucket = num_buckets - 1;
+    // Few pivots: branchless count, else binary search.
+    const size_t c_max_linear_pivots = 16;
+    auto bucket = [&](T v) {
+        if (!(v == v))
+            return nan_bucket;
+        if (pivots.size() <= c_max_linear_pivots) {
+            size_t b = 0;
+            for (T pivot : pivots)
+                b += v >= pivot;
+            return b;
+        }
+        return size_t(std::upper_bound(pivots.begin(), pivots.end(), v) -
+                      pivots.begin());
+    };
+    auto chunk_begin = [&](int t) { return n * size_t(t) / num_threads; };
+
+    // counts[t][b]: values of thread t's chunk in bucket b
+    std::vector<std::vector<size_t>> counts(num_threads,
+                                            std::vector<size_t>(num_buckets));
+    run_threads(num_threads, [&](int t) {
+        auto& c = counts[t];
+        for (size_t i = chunk_begin(t); i < chunk_begin(t + 1); ++i)
+            ++c[bucket(x[i])];
+    });
+    std::vector<size_t> first_rank(num_buckets + 1, 0);
+    for (size_t b = 0; b < num_buckets; ++b) {
+        first_rank[b + 1] = first_rank[b];
+        for (int t = 0; t < num_threads; ++t)
+            first_rank[b + 1] += counts[t][b];
+    }
+    const size_t num_values = first_rank[nan_bucket];
+    if (num_values == 0) {
+        std::fill(out.begin(), out.end(), double(NAN));
+        return;
+    }
+
+    // Buckets containing the ranks to interpolate between, copied to
+    // `selected` at `offset[b]` (thread t at offset[b] + earlier threads).
+    std::vector<size_t> ranks;
+    for (double p : ps) {
+        const double pos = detail::percentile_position(num_values, p);
+        ranks.push_back(size_t(pos));
+        ranks.push_back(std::min(size_t(pos) + 1, num_values - 1));
+    }
+    const size_t c_not_selected = SIZE_MAX;
+    std::vector<size_t> offset(num_buckets, c_not_selected);
+    size_t num_selected = 0;
+    for (size_t b = 0; b < nan_bucket; ++b) {
+        for (size_t r : ranks) {
+            if (first_rank[b] <= r && r < first_rank[b + 1]) {
+                offset[b] = num_selected;
+                num_selected += first_rank[b + 1] - first_rank[b];
+                break;
+            }
+        }
+    }
+    std::vector<T> selected(num_selected);
+    run_threads(num_threads, [&](int t) {
+        std::vector<size_t> pos(offset);
+        for (size_t b = 0; b < num_buckets; ++b) {
+            if (offset[b] == c_not_selected)
+                continue;
+            for (int u = 0; u < t; ++u)
+                pos[b] += counts[u][b];
+        }
+        for (size_t i = chunk_begin(t); i < chunk_begin(t + 1); ++i) {
+            const size_t b = bucket(x[i]);
+            if (offset[b] != c_not_selected)
+                selected[pos[b]++] = x[i];
+        }
+    });
+
+    // Value of rank r: select it within its bucket.
+    auto value = [&](size_t r) {
+        const size_t b = size_t(
+            std::upper_bound(first_rank.begin(), first_rank.end(), r) -
+            first_rank.begin() - 1);
+        T* first = selected.data() + offset[b];
+        T* nth = first + (r - first_rank[b]);
+        std::nth_element(first, nth,
+                         first + (first_rank[b + 1] - first_rank[b]));
+        return double(*nth);
+    };
+    for (size_t j = 0; j < ps.size(); ++j) {
+        const double pos = detail::percentile_position(num_values, ps[j]);
+        const double frac = pos - double(size_t(pos));
+        const double lower = value(size_t(pos));
+        out[j] = frac > 0 ? lower + frac * (value(size_t(pos) + 1) - lower)
+                          : lower;
+    }
+}
+
+}  // namespace
+
+void percentiles_parallel(span<const double> x,
+                          span<const double> ps,
+                          span<double> out,
+                          int num_threads)
+{
+    percentiles_parallel_impl(x, ps, out, num_threads);
+}
+
+void percentiles_parallel(span<const float> x,
+                          span<const double> ps,
+                          span<double> out,
+                          int num_threads)
+{
+    percentiles_parallel_impl(x, ps, out, num_threads);
+}
+
+}  // namespace ul
@@ -0,0 +1,221 @@
+#pragma once
+
+// Exact percentiles by selection, without sorting
+//
+//     std::vector<double> latencies = ...;
+//     const double ps[] = {50, 90, 99};
+//     auto v = ul::percentiles(ul::as_span(latencies), ul::make_span(ps, 3));
+//
+// Percentiles are defined like matlab's prctile: the sorted values are
+// placed at 100 * (i + 0.5) / n percent, percentiles in between are
+// interpolated linearly, below the first and above the last they are the
+// minimum and maximum. The 50th percentile is the median (mean of the two
+// middle values for even n), see also `median` and `prctile` below. NANs
+// are skipped, the percentiles of no values are NAN.
+//
+// The values are copied to a scratch buffer (allocated, or passed by the
+// caller) and partitioned with std::nth_element recursively for all ranks at
+// once: the middle rank splits the range, the ranks below and above recurse
+// into the two halves, so m percentiles of n values take O(n log m) instead
+// of the O(n log n) of sorting. The upper neighbor for the interpolation is
+// the minimum of the values between its rank and the next selected one.
+//
+// `percentiles_parallel` is for large inputs (more than
+// detail::c_percentiles_parallel_min_size values). It sorts a sample to
+// find pivots bracketing each rank, counts the values between the pivots and
+// copies only the brackets containing a rank, both passes split across
+// threads, then selects within the brackets. A bracket that misses its rank
+// only costs time, the result is the same.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/span.h"
+#include "ul/type_traits.h"
+
+namespace ul {
+
+namespace detail {
+
+const size_t c_percentiles_parallel_min_size = size_t(1) << 18;
+
+// 0-based position of percentile p among n sorted values, n > 0.
+inline double percentile_position(size_t n, double p)
+{
+    UL_CHECK(0 <= p && p <= 100, "Percentile %g is not in [0, 100].", p);
+    const double pos = double(n) * (p / 100) - 0.5;
+    return std::min(std::max(pos, 0.0), double(n - 1));
+}
+
+// Reorders x[first, last) so that x[r] is the r-th smallest value for each
+// rank r of the sorted, unique ranks [rb, re).
+template <class T>
+void select_ranks(T* x,
+                  size_t first,
+                  size_t last,
+                  const size_t* rb,
+                  const size_t* re)
+{
+    while (rb != re) {
+        const size_t* mid = rb + (re - rb) / 2;
+        std::nth_element(x + first, x + *mid, x + last);
+        select_ranks(x, first, *mid, rb, mid);
+        first = *mid + 1;
+        rb = mid + 1;
+    }
+}
+
+// Percentiles of x[0, n) (no NANs, reordered) into out[0, m).
+template <class T>
+void percentiles_inplace(T* x,
+                         size_t n,
+                         const double* ps,
+                         size_t m,
+                         double* out)
+{
+    if (n == 0) {
+        std::fill(out, out + m, double(NAN));
+        return;
+    }
+    // Lower ranks of the interpolations, sorted and unique.
+    const size_t c_inline_ranks = 32;
+    size_t inline_ranks[c_inline_ranks] = {};
+    std::vector<size_t> heap_ranks;
+    size_t* ranks = inline_ranks;
+    if (m > c_inline_ranks) {
+        heap_ranks.resize(m);
+        ranks = heap_ranks.data();
+    }
+    for (size_t j = 0; j < m; ++j)
+        ranks[j] = size_t(percentile_position(n, ps[j]));
+    std::sort(ranks, ranks + m);
+    const size_t num_ranks = size_t(std::unique(ranks, ranks + m) - ranks);
+    select_ranks(x, 0, n, ranks, ranks + num_ranks);
+
+    for (size_t j = 0; j < m; ++j) {
+        const double pos = percentile_position(n, ps[j]);
+        const size_t lo = size_t(pos);
+        const double frac = pos - double(lo);
+        const double lower = double(x[lo]);
+        if (!(frac > 0)) {
+            out[j] = lower;
+            continue;
+        }
+        // x[lo + 1] is the smallest value up to the next selected rank.
+        const size_t next =
+            size_t(std::upper_bound(ranks, ranks + num_ranks, lo) - ranks);
+        const size_t end = next < num_ranks ? ranks[next] + 1 : n;
+        const double upper = double(*std::min_element(x + lo + 1, x + end));
+        out[j] = lower + frac * (upper - lower);
+    }
+}
+
+// Copies the values of x which are not NAN to `scratch`, returns their
+// number.
+template <class T, class U>
+size_t copy_without_nans(const T* x, size_t n, U* scratch)
+{
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        scratch[k] = x[i];
+        k += x[i] == x[i];
+    }
+    return k;
+}
+
+}  // namespace detail
+
+// Percentiles `ps` (in [0, 100]) of `x` into `out`, using `scratch` (at least
+// the size of `x`) instead of allocating a copy. Allocates only for more than
+// 32 percentiles.
+template <class T>
+void percentiles(span<T> x,
+                 span<const double> ps,
+                 span<double> out,
+                 span<std::remove_const_t<T>> scratch)
+{
+    UL_CHECK(out.size() == ps.size(), "%d outputs for %d percentiles.",
+             int(out.size()), int(ps.size()));
+    UL_CHECK(scratch.size() >= x.size(), "Scratch size %d, expected %d.",
+             int(scratch.size()), int(x.size()));
+    const size_t n = detail::copy_without_nans(x.data(), x.size(),
+                                               scratch.data());
+    detail::percentiles_inplace(scratch.data(), n, ps.data(), ps.size(),
+                                out.data());
+}
+
+template <class T>
+std::vector<double> percentiles(span<T> x, span<const double> ps)
+{
+    std::vector<std::remove_const_t<T>> scratch(x.size());
+    std::vector<double> out(ps.size());
+    percentiles(x, ps, make_span(out.data(), out.size()),
+                make_span(scratch.data(), scratch.size()));
+    return out;
+}
+
+// Same results as `percentiles`, in `num_threads` threads (0: one per
+// hardware thread). Falls back to `percentiles` for small inputs.
+void percentiles_parallel(span<const double> x,
+                          span<const double> ps,
+                          span<double> out,
+                          int num_threads = 0);
+void percentiles_parallel(span<const float> x,
+                          span<const double> ps,
+                          span<double> out,
+                          int num_threads = 0);
+
+// Percentile p in [0, 100] of the values of `v`, NANs skipped, NAN if none.
+// The versions taking a `scratch` span (at least the size of `v`) don't
+// allocate.
+template <class T,
+          class E,
+          UL_T_ENABLE_IF(range_code<T>::value >= c_range_code_indexable)>
+double prctile(const T& v, double p, span<E> scratch)
+{
+    double r;
+    percentiles(make_span(v.data(), v.size()), make_span(&p, 1),
+                make_span(&r, 1), scratch);
+    return r;
+}
+
+template <class T,
+          UL_T_ENABLE_IF(range_code<T>::value >= c_range_code_indexable)>
+double prctile(const T& v, double p)
+{
+    std::vector<UL_DECAYDECL(v[0])> scratch(v.size());
+    return prctile(v, p, make_span(scratch.data(), scratch.size()));
+}
+
+template <class T, class E>
+double prctile(span<T> v, double p, span<E> scratch)
+{
+    double r;
+    percentiles(v, make_span(&p, 1), make_span(&r, 1), scratch);
+    return r;
+}
+
+template <class T>
+double prctile(span<T> v, double p)
+{
+    return percentiles(v, make_span(&p, 1))[0];
+}
+
+// Mean of the two middle values for even sizes.
+template <class T, class E>
+double median(const T& v, span<E> scratch)
+{
+    return prctile(v, 50, scratch);
+}
+
+template <class T>
+double median(const T& v)
+{
+    return prctile(v, 50);
+}
+
+}  // namespace ul
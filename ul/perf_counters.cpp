@@ -0,0 +1,351 @@
+#include "ul/perf_counters.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "ul/check.h"
+#include "ul/stringf.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ul {
+
+const char* perf_event_name(PerfEvent e)
+{
+    switch (e) {
+        case perf_cycles:
+            return "cycles";
+        case perf_instructions:
+            return "instructions";
+        case perf_branch_misses:
+            return "branch_misses";
+        case perf_l1d_misses:
+            return "l1d_misses";
+        case perf_llc_misses:
+            return "llc_misses";
+        default:
+            UL_UNREACHABLE;
+    }
+}
+
+PerfCounts PerfCounts::per_item(double items) const
+{
+    PerfCounts r;
+    for (int i = 0; i < c_num_perf_events; ++i)
+        r.values[i] = values[i] / items;
+    return r;
+}
+
+PerfCounts& PerfCounts::operator+=(const PerfCounts& x)
+{
+    for (int i = 0; i < c_num_perf_events; ++i)
+        values[i] += x.values[i];
+    return *this;
+}
+
+std::string PerfCounts::to_string() const
+{
+    std::string s;
+    for (int i = 0; i < c_num_perf_events; ++i) {
+        if (std::isnan(values[i]))
+            continue;
+        if (!s.empty())
+            s += ' ';
+        s += stringf("%s=%.4g", perf_event_name(PerfEvent(i)), values[i]);
+        if (i == perf_instructions && !std::isnan(ipc()))
+            s += stringf(" IPC=%.3f", ipc());
+    }
+    return s.empty() ? "(no counters)" : s;
+}
+
+PerfCounters::PerfCounters(bool start)
+{
+    fds.fill(-1);
+    mmap_pages.fill(nullptr);
+    running_since.fill(0);
+    accumulated.fill(0);
+    open_all();
+    if (start)
+        this->start();
+}
+
+PerfCounters::~PerfCounters()
+{
+    close_all();
+}
+
+PerfCounts PerfCounters::counts() const
+{
+    PerfCounts r;
+    RawCounts now;
+    if (running_)
+        read_raw(now, running_since_rdpmc);
+    for (int i = 0; i < c_num_perf_events; ++i) {
+        if (fds[i] < 0)
+            continue;
+        r.values[i] = accumulated[i];
+        if (running_)
+            r.values[i] += now[i] - running_since[i];
+    }
+    return r;
+}
+
+void PerfCounters::start()
+{
+    UL_DCHECK(!running_);
+    read_running_since();
+    running_ = true;
+}
+
+PerfCounts PerfCounters::stop()
+{
+    RawCounts now;
+    read_raw(now, running_since_rdpmc);
+    UL_DCHECK(running_);  // check only after reading the counters
+    for (int i = 0; i < c_num_perf_events; ++i)
+        accumulated[i] += now[i] - running_since[i];
+    running_ = false;
+    return counts();
+}
+
+PerfCounts PerfCounters::restart()
+{
+    auto result = counts();
+    accumulated.fill(0);
+    read_running_since();
+    running_ = true;
+    return result;
+}
+
+void PerfCounters::reset()
+{
+    accumulated.fill(0);
+    running_ = false;
+}
+
+void PerfCounters::read_running_since()
+{
+    running_since_rdpmc = rdpmc && read_raw(running_since, true);
+    if (!running_since_rdpmc)
+        read_raw(running_since, false);
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct EventConfig
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+uint64_t cache_event(uint64_t cache)
+{
+    return cache | (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) |
+           (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+}
+
+EventConfig event_config(int e)
+{
+    switch (e) {
+        case perf_cycles:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+        case perf_instructions:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+        case perf_branch_misses:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+        case perf_l1d_misses:
+            return {PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D)};
+        case perf_llc_misses:
+            return {PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL)};
+        default:
+            UL_UNREACHABLE;
+    }
+}
+
+const uint64_t c_read_format = PERF_FORMAT_GROUP |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+int perf_event_paranoid()
+{
+    int level = -100;
+    if (FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r")) {
+        if (fscanf(f, "%d", &level) != 1)
+            level = -100;
+        fclose(f);
+    }
+    return level;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+uint64_t read_pmc(uint32_t counter)
+{
+    uint32_t lo, hi;
+    asm volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+    return uint64_t(lo) | (uint64_t(hi) << 32);
+}
+#define UL_PERF_RDPMC
+#endif
+
+}  // namespace
+
+void PerfCounters::open_all()
+{
+    for (int e = 0; e < c_num_perf_events; ++e) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event_config(e).type;
+        attr.config = event_config(e).config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = c_read_format;
+        // Counting from open on, start/stop only take snapshots, so reads
+        // don't need to enable/disable with ioctl.
+        const int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader,
+                                   PERF_FLAG_FD_CLOEXEC));
+        if (fd < 0) {
+            const int err = errno;
+            reason += stringf("%s%s: %s", reason.empty() ? "" : "; ",
+                              perf_event_name(PerfEvent(e)), strerror(err));
+            if (err == EACCES || err == EPERM)
+                reason += stringf(" (perf_event_paranoid=%d)",
+                                  perf_event_paranoid());
+            continue;
+        }
+        fds[e] = fd;
+        if (leader < 0)
+            leader = fd;
+        ++num_open;
+    }
+    if (num_open == 0)
+        return;
+
+#ifdef UL_PERF_RDPMC
+    rdpmc = true;
+    for (int e = 0; e < c_num_perf_events; ++e) {
+        if (fds[e] < 0)
+            continue;
+        void* p = mmap(nullptr, size_t(sysconf(_SC_PAGESIZE)), PROT_READ,
+                       MAP_SHARED, fds[e], 0);
+        if (p == MAP_FAILED) {
+            rdpmc = false;
+            continue;
+        }
+        mmap_pages[e] = p;
+        rdpmc &= static_cast<perf_event_mmap_page*>(p)->cap_user_rdpmc != 0;
+    }
+    // A first read also verifies that the counters are actually scheduled.
+    RawCounts raw;
+    rdpmc = rdpmc && read_rdpmc(raw);
+#endif
+}
+
+void PerfCounters::close_all()
+{
+    for (int e = 0; e < c_num_perf_events; ++e) {
+        if (mmap_pages[e])
+            munmap(mmap_pages[e], size_t(sysconf(_SC_PAGESIZE)));
+        if (fds[e] >= 0)
+            close(fds[e]);
+    }
+}
+
+bool PerfCounters::read_rdpmc(RawCounts& raw) const
+{
+#ifdef UL_PERF_RDPMC
+    for (int e = 0; e < c_num_perf_events; ++e) {
+        if (fds[e] < 0)
+            continue;
+        auto pc = static_cast<const volatile perf_event_mmap_page*>(
+            mmap_pages[e]);
+        uint32_t seq;
+        int64_t count;
+        do {
+            seq = pc->lock;
+            asm volatile("" : : : "memory");
+            const uint32_t index = pc->index;
+            // index == 0: not on the PMU right now. Multiplexed counters
+            // need the scaling done by read().
+            if (!pc->cap_user_rdpmc || index == 0 ||
+                pc->time_enabled != pc->time_running)
+                return false;
+            const int shift = 64 - pc->pmc_width;
+            count = int64_t(read_pmc(index - 1) << shift) >> shift;
+            count += pc->offset;
+            asm volatile("" : : : "memory");
+        } while (pc->lock != seq);
+        raw[e] = double(count);
+    }
+    return true;
+#else
+    (void)raw;
+    return false;
+#endif
+}
+
+bool PerfCounters::read_syscall(RawCounts& raw) const
+{
+    // struct read_format { nr, time_enabled, time_running, values[nr] }
+    uint64_t buf[3 + c_num_perf_events];
+    const ssize_t n = read(leader, buf, sizeof(buf));
+    if (n < ssize_t(3 * sizeof(uint64_t)) || int(buf[0]) != num_open)
+        return false;
+    const uint64_t time_enabled = buf[1], time_running = buf[2];
+    // Scale multiplexed counts; never scheduled: NAN.
+    const double scale =
+        time_running > 0 ? double(time_enabled) / double(time_running) : NAN;
+    int i = 3;
+    for (int e = 0; e < c_num_perf_events; ++e) {
+        if (fds[e] >= 0)
+            raw[e] = double(buf[i++]) * scale;
+    }
+    return true;
+}
+
+bool PerfCounters::read_raw(RawCounts& raw, bool use_rdpmc) const
+{
+    raw.fill(NAN);
+    if (num_open > 0 && (use_rdpmc ? read_rdpmc(raw) : read_syscall(raw)))
+        return true;
+    raw.fill(NAN);
+    return false;
+}
+
+#else  // __linux__
+
+void PerfCounters::open_all()
+{
+    reason = "hardware performance counters are only supported on Linux";
+}
+
+void PerfCounters::close_all() {}
+
+bool PerfCounters::read_rdpmc(RawCounts&) const
+{
+    return false;
+}
+
+bool PerfCounters::read_syscall(RawCounts&) const
+{
+    return false;
+}
+
+bool PerfCounters::read_raw(RawCounts& raw, bool) const
+{
+    raw.fill(NAN);
+    return false;
+}
+
+#endif  // __linux__
+
+}  // namespace ul
@@ -0,0 +1,129 @@
+#pragma once
+
+// Hardware performance counters of the calling thread (Linux only), with a
+// Stopwatch-like interface:
+//
+//     ul::PerfCounters pc(true);
+//     conv_into_nocheck(x, y, result);
+//     auto counts = pc.stop();
+//     printf("IPC %.2f, %.3f L1d misses/item\n", counts.ipc(),
+//            counts.per_item(n)[ul::perf_l1d_misses]);
+//
+// The events are opened as one group with perf_event_open (user space only),
+// so they are scheduled onto the PMU together. When the kernel allows it
+// (`cap_user_rdpmc` in the mmap page, the default on x86 with
+// perf_event_paranoid <= 2) the counters are read with rdpmc without a
+// system call, otherwise with a single read() of the group. Both ends of a
+// measurement interval are read the same way. If the group gets multiplexed
+// after an interval started with rdpmc, the interval's counts are NAN.
+//
+// Unavailable counters (no PMU in a VM or container, perf_event_paranoid too
+// high, seccomp, not Linux) are reported as NAN. `available()` tells whether
+// any of them work and `unavailable_reason()` why some don't. Nothing fails
+// hard, so the code using PerfCounters runs anywhere.
+//
+// A PerfCounters object must be used on the thread that created it.
+
+#include <array>
+#include <cmath>
+#include <string>
+
+namespace ul {
+
+enum PerfEvent
+{
+    perf_cycles,
+    perf_instructions,
+    perf_branch_misses,
+    perf_l1d_misses,  // L1 data cache read misses
+    perf_llc_misses,  // last level cache read misses
+    c_num_perf_events
+};
+
+const char* perf_event_name(PerfEvent e);
+
+struct PerfCounts
+{
+    // NAN for unavailable counters.
+    std::array<double, c_num_perf_events> values;
+
+    PerfCounts() { values.fill(NAN); }
+
+    double operator[](PerfEvent e) const { return values[e]; }
+    double& operator[](PerfEvent e) { return values[e]; }
+
+    // Instructions per cycle
+    double ipc() const
+    {
+        return values[perf_instructions] / values[perf_cycles];
+    }
+    PerfCounts per_item(double items) const;
+    PerfCounts& operator+=(const PerfCounts& x);
+
+    // "cycles=123 instructions=456 IPC=3.71 ...", omits unavailable counters.
+    std::string to_string() const;
+};
+
+class PerfCounters
+{
+public:
+    explicit PerfCounters(bool start = false);
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    void operator=(const PerfCounters&) = delete;
+
+    // True if at least one counter could be opened.
+    bool available() const { return num_open > 0; }
+    bool available(PerfEvent e) const { return fds[e] >= 0; }
+    // Empty if all counters are available.
+    const std::string& unavailable_reason() const { return reason; }
+    // True if counters are read with rdpmc instead of read().
+    bool uses_rdpmc() const { return rdpmc; }
+
+    bool running() const { return running_; }
+
+    // Counts accumulated in previous measurement intervals plus the current
+    // one if running.
+    PerfCounts counts() const;
+
+    // Starts/resumes counting (does not reset). It's an error to call this
+    // on running counters.
+    void start();
+    // Stops counting, returns the accumulated counts. It's an error to call
+    // this on stopped counters.
+    PerfCounts stop();
+    // Starts counting, zeroing out the counts so far. Returns the previous
+    // counts.
+    PerfCounts restart();
+    // Zeroes out the counts, also stops counting.
+    void reset();
+
+private:
+    using RawCounts = std::array<double, c_num_perf_events>;
+
+    // Reads with rdpmc or with read(), all NAN on failure. The two differ
+    // while counters are multiplexed (only read() scales), so both ends of
+    // an interval must be read the same way.
+    bool read_raw(RawCounts& raw, bool use_rdpmc) const;
+    // Reads running_since, with rdpmc if possible.
+    void read_running_since();
+    bool read_rdpmc(RawCounts& raw) const;
+    bool read_syscall(RawCounts& raw) const;
+    void open_all();
+    void close_all();
+
+    std::array<int, c_num_perf_events> fds;
+    std::array<void*, c_num_perf_events> mmap_pages;
+    int leader = -1;  // fd of the group leader
+    int num_open = 0;
+    bool rdpmc = false;
+    std::string reason;
+
+    bool running_ = false;
+    RawCounts running_since;
+    bool running_since_rdpmc = false;  // how running_since was read
+    RawCounts accumulated;
+};
+
+}  // namespace ul
@@ -0,0 +1,121 @@
+#include "ul/polyfit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ul {
+
+namespace detail {
+
+void polyfit_pseudoinverse(const double* x,
+                           size_t n,
+                           int degree,
+                           double* pinv)
+{
+    UL_CHECK(degree >= 0 && n >= size_t(degree) + 1,
+             "polyfit: %d points for degree %d.", int(n), degree);
+    const size_t m = size_t(degree) + 1;
+
+    // t = (x - mu) / s in [-1, 1].
+    double mu = 0;
+    for (size_t i = 0; i < n; ++i)
+        mu += x[i];
+    mu /= double(n);
+    double s = 0;
+    for (size_t i = 0; i < n; ++i)
+        s = std::max(s, fabs(x[i] - mu));
+    if (s == 0)
+        s = 1;
+
+    // Vandermonde matrix of t, column-major.
+    std::vector<double> a(n * m);
+    for (size_t i = 0; i < n; ++i) {
+        const double t = (x[i] - mu) / s;
+        double power = 1;
+        for (size_t j = 0; j < m; ++j) {
+            a[j * n + i] = power;
+            power *= t;
+        }
+    }
+
+    // Householder QR: the reflection vectors v_k overwrite a[k:n, k], R is
+    // rdiag and the upper triangle of a.
+    std::vector<double> rdiag(m), vv(m);
+    // The columns have norms up to sqrt(n), a smaller residual is rounding.
+    const double tol = 1e-12 * std::sqrt(double(n));
+    for (size_t k = 0; k < m; ++k) {
+        double* v = a.data() + k * n;
+        double norm2 = 0;
+        for (size_t i = k; i < n; ++i)
+            norm2 += v[i] * v[i];
+        const double norm = std::sqrt(norm2);
+        UL_CHECK(norm > tol, "polyfit: x has fewer than %d distinct values.",
+                 int(m));
+        const double vk = v[k];
+        const double alpha = vk > 0 ? -norm : norm;
+        v[k] = vk - alpha;
+        vv[k] = 2 * (norm2 - alpha * vk);  // v . v
+        rdiag[k] = alpha;
+        for (size_t j = k + 1; j < m; ++j) {
+            double* c = a.data() + j * n;
+            double dot = 0;
+            for (size_t i = k; i < n; ++i)
+                dot += v[i] * c[i];
+            const double f = 2 * dot / vv[k];
+            for (size_t i = k; i < n; ++i)
+                c[i] -= f * v[i];
+        }
+    }
+
+    // Thin Q, the reflections applied to the first m unit vectors.
+    std::vector<double> q(n * m, 0.0);
+    for (size_t j = 0; j < m; ++j)
+        q[j * n + j] = 1;
+    for (size_t k = m; k-- > 0;) {
+        const double* v = a.data() + k * n;
+        for (size_t j = k; j < m; ++j) {
+            double* c = q.data() + j * n;
+            double dot = 0;
+            for (size_t i = k; i < n; ++i)
+                dot += v[i] * c[i];
+            const double f = 2 * dot / vv[k];
+            for (size_t i = k; i < n; ++i)
+                c[i] -= f * v[i];
+        }
+    }
+
+    // R^-1 Q^T, by back substitution for each row of Q, into q.
+    std::vector<double> z(m);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = m; k-- > 0;) {
+            double r = q[k * n + i];
+            for (size_t j = k + 1; j < m; ++j)
+                r -= a[j * n + k] * z[j];
+            z[k] = r / rdiag[k];
+        }
+        for (size_t k = 0; k < m; ++k)
+            q[k * n + i] = z[k];
+    }
+
+    // Back to the powers of x: t^k = ((x - mu) / s)^k = sum_j c[k][j] x^j.
+    std::vector<double> c(m * m, 0.0);
+    c[0] = 1;
+    for (size_t k = 1; k < m; ++k) {
+        for (size_t j = 0; j <= k; ++j) {
+            const double lower = j > 0 ? c[(k - 1) * m + j - 1] : 0;
+            c[k * m + j] = (lower - mu * c[(k - 1) * m + j]) / s;
+        }
+    }
+    for (size_t j = 0; j < m; ++j) {
+        for (size_t i = 0; i < n; ++i) {
+            double sum = 0;
+            for (size_t k = j; k < m; ++k)
+                sum += c[k * m + j] * q[k * n + i];
+            pinv[j * n + i] = sum;
+        }
+    }
+}
+
+}  // namespace detail
+
+}  // namespace ul
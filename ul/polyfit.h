@@ -0,0 +1,194 @@
+#pragma once
+
+// Least-squares polynomial fitting, like matlab's polyfit
+//
+//     auto p = ul::polyfit<2>(x, y);  // std::array<double, 3>
+//     ul::polyval(p, 0.5);            // p[0] + p[1] 0.5 + p[2] 0.5^2
+//
+// The coefficients are in ascending order, like the other polynomial
+// functions in ml.h (matlab's are descending). The fit solves the
+// Vandermonde system in t = (x - mean(x)) / max|x - mean(x)|, where it is
+// well conditioned, with a Householder QR decomposition. It then transforms
+// the solution back to the powers of x. For x far from 0 relative to its
+// spread, the coefficients in x are inherently ill conditioned, as in
+// matlab.
+//
+// The coefficients are linear in y: p = P y, where P is the pseudo-inverse
+// of the Vandermonde matrix, with the back transformation folded in. A
+// `Polyfit` computes P once for an x grid (O(n Deg^2)). Each fit on that grid
+// is then Deg + 1 dot products of n values. This is what we need for the
+// many short windows of a series:
+//
+//     ul::Polyfit<3> fit(ul::as_span(x));   // window length x.size()
+//     std::vector<std::array<double, 4>> out(num_windows);
+//     fit.fit_windows(ul::as_span(series), 1,  // sliding, stride 1
+//                     ul::make_span(out.data(), out.size()));
+//
+// With stride 1 the coefficients of consecutive windows are the correlations
+// of the series with the rows of P, computed with the SIMD kernels of
+// conv_direct_into (conv.h). Other strides fit pairs of windows together,
+// for independent accumulators.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/conv.h"
+#include "ul/span.h"
+
+namespace ul {
+
+namespace detail {
+
+// Windows fitted together by Polyfit::fit_windows for strides > 1. With
+// more, the accumulators don't fit in the registers (measured with
+// microlib-bench --filter=polyfit: 2 windows of 32 take 34 ns per window, 4
+// take 58 ns, a single fit 45 ns).
+const size_t c_polyfit_windows_block = 2;
+// Windows per correlation with conv_direct_into for stride 1.
+const size_t c_polyfit_correlation_block = 4096;
+
+// Row-major (degree + 1) x n pseudo-inverse of the Vandermonde matrix of x,
+// so that p[j] = sum_i pinv[j * n + i] y[i]. Checks that x has at least
+// degree + 1 distinct values.
+void polyfit_pseudoinverse(const double* x,
+                           size_t n,
+                           int degree,
+                           double* pinv);
+
+}  // namespace detail
+
+// Fits of degree `Deg` polynomials on a fixed x grid, see above. T is
+// double or float.
+template <int Deg, class T = double>
+class Polyfit
+{
+    static_assert(Deg >= 0, "Polyfit: negative degree.");
+    static_assert(std::is_same<T, double>::value ||
+                      std::is_same<T, float>::value,
+                  "Polyfit: double or float coefficients only.");
+
+public:
+    using coefficients_type = std::array<T, Deg + 1>;
+
+    // Any indexable x with at least Deg + 1 distinct values.
+    template <class X>
+    explicit Polyfit(const X& x) : n(size_t(x.size())), rows((Deg + 1) * n)
+    {
+        std::vector<double> xd(n), pinv(rows.size());
+        for (size_t i = 0; i < n; ++i)
+            xd[i] = double(x[i]);
+        detail::polyfit_pseudoinverse(xd.data(), n, Deg, pinv.data());
+        // Reversed rows, the filters of conv_direct_into.
+        for (int j = 0; j <= Deg; ++j) {
+            for (size_t i = 0; i < n; ++i)
+                rows[j * n + i] = T(pinv[j * n + n - 1 - i]);
+        }
+    }
+
+    // Number of points of the grid and of each window.
+    size_t size() const { return n; }
+
+    // Coefficients of the fit to `y`, y.size() == size().
+    template <class Y>
+    coefficients_type fit(const Y& y) const
+    {
+        UL_CHECK(size_t(y.size()) == n, "Polyfit: %d values for %d points.",
+                 int(y.size()), int(n));
+        coefficients_type p{};
+        for (size_t i = 0; i < n; ++i) {
+            const T v = T(y[n - 1 - i]);
+            for (int j = 0; j <= Deg; ++j)
+                p[j] += rows[j * n + i] * v;
+        }
+        return p;
+    }
+
+    // out[w] = fit(y[w * stride, w * stride + size())) for all windows w.
+    void fit_windows(span<const T> y,
+                     size_t stride,
+                     span<coefficients_type> out) const
+    {
+        const size_t count = out.size();
+        if (count == 0)
+            return;
+        UL_CHECK(stride > 0, "Polyfit: zero stride.");
+        UL_CHECK((count - 1) * stride + n <= y.size(),
+                 "Polyfit: %d values for %d windows.", int(y.size()),
+                 int(count));
+        if (stride == 1) {
+            fit_sliding(y.data(), count, out.data());
+            return;
+        }
+        const size_t c_block = detail::c_polyfit_windows_block;
+        size_t w = 0;
+        for (; w + c_block <= count; w += c_block)
+            fit_block(y.data() + w * stride, stride, out.data() + w);
+        for (; w < count; ++w)
+            out[w] = fit(make_span(y.data() + w * stride, n));
+    }
+
+    // Windows back to back, y.size() == out.size() * size().
+    void fit_windows(span<const T> y, span<coefficients_type> out) const
+    {
+        UL_CHECK(y.size() == out.size() * n,
+                 "Polyfit: %d values for %d windows of %d.", int(y.size()),
+                 int(out.size()), int(n));
+        fit_windows(y, n, out);
+    }
+
+private:
+    void fit_sliding(const T* y, size_t count, coefficients_type* out) const
+    {
+        const size_t c_block = detail::c_polyfit_correlation_block;
+        std::vector<T> correlation(std::min(count, c_block));
+        for (size_t w = 0; w < count; w += c_block) {
+            const size_t block = std::min(count - w, c_block);
+            for (int j = 0; j <= Deg; ++j) {
+                conv_direct_into(make_span(y + w, block + n - 1),
+                                 make_span(rows.data() + j * n, n),
+                                 make_span(correlation.data(), block),
+                                 ConvShape::valid);
+                for (size_t k = 0; k < block; ++k)
+                    out[w + k][j] = correlation[k];
+            }
+        }
+    }
+
+    // c_polyfit_windows_block windows at once, for more independent
+    // accumulators than a single fit has.
+    void fit_block(const T* y, size_t stride, coefficients_type* out) const
+    {
+        const size_t c_block = detail::c_polyfit_windows_block;
+        T acc[c_block][Deg + 1] = {};
+        for (size_t i = 0; i < n; ++i) {
+            for (int j = 0; j <= Deg; ++j) {
+                const T r = rows[j * n + n - 1 - i];
+                for (size_t b = 0; b < c_block; ++b)
+                    acc[b][j] += r * y[b * stride + i];
+            }
+        }
+        for (size_t b = 0; b < c_block; ++b)
+            std::copy(acc[b], acc[b] + Deg + 1, out[b].begin());
+    }
+
+    size_t n;
+    std::vector<T> rows;  // reversed rows of the pseudo-inverse
+};
+
+// Least-squares fit of a degree `Deg` polynomial to the points (x[i], y[i]),
+// ascending coefficients. Float if both x and y are float, else double.
+template <int Deg, class X, class Y>
+auto polyfit(const X& x, const Y& y)
+{
+    using T = std::conditional_t<
+        std::is_same<std::decay_t<decltype(x[0])>, float>::value &&
+            std::is_same<std::decay_t<decltype(y[0])>, float>::value,
+        float, double>;
+    return Polyfit<Deg, T>(x).fit(y);
+}
+
+}  // namespace ul
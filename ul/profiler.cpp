@@ -0,0 +1,143 @@
+#include "ul/profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace ul {
+
+namespace detail {
+
+thread_local ProfileThreadState t_profile_thread_state;
+
+namespace {
+
+std::atomic<int> s_zone_count{0};
+std::atomic<ProfileZoneSite*> s_zone_sites[Profiler::c_max_zones];
+
+// Data of all threads that have ever run a zone. Never shrinks, so reports
+// include finished threads.
+std::mutex& thread_data_mutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+std::vector<std::unique_ptr<ProfileThreadData>>& thread_data()
+{
+    static std::vector<std::unique_ptr<ProfileThreadData>> v;
+    return v;
+}
+
+int register_zone_site(ProfileZoneSite* site)
+{
+    const int id = s_zone_count.fetch_add(1);
+    if (id >= Profiler::c_max_zones)
+        return -1;
+    s_zone_sites[id].store(site, std::memory_order_release);
+    return id;
+}
+
+}  // namespace
+
+ProfileZoneSite::ProfileZoneSite(const char* name, const char* file, int line)
+    : name(name), file(file), line(line), id(register_zone_site(this))
+{}
+
+void ProfileAccumulator::reset()
+{
+    count = 0;
+    mean = 0;
+    m2 = 0;
+    lower = INT64_MAX;
+    upper = INT64_MIN;
+}
+
+void ProfileAccumulator::merge_into(ProfileAccumulator& y) const
+{
+    const int64_t n = count.load();
+    if (n == 0)
+        return;
+    const int64_t yn = y.count.load();
+    const int64_t total = yn + n;
+    const double delta = mean.load() - y.mean.load();
+    y.m2 = y.m2 + m2 + square(delta) * (double(yn) * double(n) / total);
+    y.mean = y.mean + delta * (double(n) / total);
+    y.count = total;
+    y.lower = std::min(y.lower.load(), lower.load());
+    y.upper = std::max(y.upper.load(), upper.load());
+}
+
+Statistics ProfileAccumulator::to_statistics(double seconds_per_tick) const
+{
+    return Statistics::from_moments(
+        count.load(), mean.load() * seconds_per_tick,
+        std::max(0.0, m2.load()) * square(seconds_per_tick),
+        double(lower.load()) * seconds_per_tick,
+        double(upper.load()) * seconds_per_tick);
+}
+
+ProfileThreadData* register_profile_thread()
+{
+    std::lock_guard<std::mutex> lock(thread_data_mutex());
+    thread_data().emplace_back(new ProfileThreadData);
+    return thread_data().back().get();
+}
+
+}  // namespace detail
+
+std::vector<ProfileZoneReport> Profiler::report()
+{
+    const double seconds_per_tick = 1 / tsc_clock::ticks_per_second();
+    const int n_zones = std::min(detail::s_zone_count.load(), c_max_zones);
+
+    std::vector<ProfileZoneReport> result;
+    std::lock_guard<std::mutex> lock(detail::thread_data_mutex());
+    for (int id = 0; id < n_zones; ++id) {
+        auto* site = detail::s_zone_sites[id].load(std::memory_order_acquire);
+        if (!site)
+            continue;  // being registered
+        detail::ProfileThreadData::Zone total;
+        for (auto& td : detail::thread_data()) {
+            td->zones[id].inclusive.merge_into(total.inclusive);
+            td->zones[id].exclusive.merge_into(total.exclusive);
+        }
+        if (total.inclusive.count.load() > 0) {
+            result.push_back(ProfileZoneReport{
+                site->name, site->file, site->line,
+                total.inclusive.to_statistics(seconds_per_tick),
+                total.exclusive.to_statistics(seconds_per_tick)});
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const ProfileZoneReport& x, const ProfileZoneReport& y) {
+                  return x.inclusive.sum() > y.inclusive.sum();
+              });
+    return result;
+}
+
+void Profiler::print_report(FILE* f)
+{
+    auto zones = report();
+    fprintf(f, "%-32s %10s %12s %12s %12s %12s %12s\n", "zone", "count",
+            "incl total", "incl mean", "incl std", "excl total", "excl mean");
+    for (auto& z : zones) {
+        fprintf(f, "%-32s %10lld %10.6f s %9.3f us %9.3f us %10.6f s %9.3f us\n",
+                z.name, (long long)z.inclusive.count64(), z.inclusive.sum(),
+                z.inclusive.mean() * 1e6, z.inclusive.std() * 1e6,
+                z.exclusive.sum(), z.exclusive.mean() * 1e6);
+    }
+}
+
+void Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(detail::thread_data_mutex());
+    for (auto& td : detail::thread_data()) {
+        for (auto& zone : td->zones) {
+            zone.inclusive.reset();
+            zone.exclusive.reset();
+        }
+    }
+}
+
+}  // namespace ul
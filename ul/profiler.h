@@ -0,0 +1,193 @@
+#pragma once
+
+// Scoped, hierarchical profiling zones
+//
+//     void f()
+//     {
+//         UL_PROFILE_ZONE("f");
+//         ...
+//         {
+//             UL_PROFILE_ZONE("f/inner loop");
+//             ...
+//         }
+//     }
+//     ...
+//     ul::Profiler::print_report();
+//
+// Enabled only if UL_PROFILE is defined (CMake option `UL_PROFILE` on the
+// microlib target), otherwise `UL_PROFILE_ZONE` expands to nothing.
+//
+// Each zone measures the time between its construction and the end of the
+// enclosing scope with the CPU's time-stamp counter (see tsc_clock in
+// clock.h). Inclusive time is the full time, exclusive time is the inclusive
+// time minus the inclusive time of the zones nested in it (in the same
+// thread).
+//
+// The timings are recorded into thread-local accumulators, without locks or
+// atomic read-modify-write operations. `Profiler::report()` merges the
+// accumulators of all threads (also of the finished ones) into per-zone
+// Statistics, in seconds. It can be called while other threads are running
+// zones, in that case the result may miss a few of the most recent samples.
+//
+// Zones are identified by call site, a zone name can be used at multiple
+// sites. At most `Profiler::c_max_zones` sites are recorded.
+//
+// While tracing is on (see trace.h) zones are also recorded as timeline
+// events.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "ul/clock.h"
+#include "ul/math.h"
+#include "ul/preproc.h"
+#include "ul/trace.h"
+
+#ifdef UL_PROFILE
+#define UL_PROFILE_ZONE(name) \
+    UL_PROFILE_ZONE_I(name, UL_CAT(ul_profile_zone__, __COUNTER__))
+#define UL_PROFILE_ZONE_I(name, var)                                        \
+    static ::ul::detail::ProfileZoneSite UL_CAT(var, _site)(name, __FILE__, \
+                                                           __LINE__);       \
+    ::ul::detail::ProfileZone var(UL_CAT(var, _site))
+#else
+#define UL_PROFILE_ZONE(name) static_assert(true, "")
+#endif
+
+namespace ul {
+
+struct ProfileZoneReport
+{
+    const char* name;
+    const char* file;
+    int line;
+    Statistics inclusive;  // seconds
+    Statistics exclusive;  // seconds
+};
+
+class Profiler
+{
+public:
+    static constexpr int c_max_zones = 512;
+
+    // One item per zone site that has been run at least once, ordered by
+    // decreasing total inclusive time.
+    static std::vector<ProfileZoneReport> report();
+    static void print_report(FILE* f = stdout);
+
+    // Zeroes all accumulators.
+    static void reset();
+};
+
+namespace detail {
+
+class ProfileZoneSite
+{
+public:
+    ProfileZoneSite(const char* name, const char* file, int line);
+    ProfileZoneSite(const ProfileZoneSite&) = delete;
+
+    const char* const name;
+    const char* const file;
+    const int line;
+    const int id;  // -1 if too many zones
+};
+
+// Single-writer accumulator of tick counts. Relaxed atomics only to make
+// concurrent reads well-defined, updates are plain loads and stores. Keeps
+// the mean and the sum of squared deviations (Welford) instead of the sum of
+// squares, which loses the variance of long zones to cancellation.
+struct ProfileAccumulator
+{
+    std::atomic<int64_t> count{0};
+    std::atomic<double> mean{0};
+    std::atomic<double> m2{0};
+    std::atomic<int64_t> lower{INT64_MAX};
+    std::atomic<int64_t> upper{INT64_MIN};
+
+    void add(int64_t ticks)
+    {
+        const auto r = std::memory_order_relaxed;
+        const int64_t n = count.load(r) + 1;
+        const double x = double(ticks);
+        const double old_mean = mean.load(r);
+        const double new_mean = old_mean + (x - old_mean) / double(n);
+        count.store(n, r);
+        mean.store(new_mean, r);
+        m2.store(m2.load(r) + (x - old_mean) * (x - new_mean), r);
+        if (ticks < lower.load(r))
+            lower.store(ticks, r);
+        if (ticks > upper.load(r))
+            upper.store(ticks, r);
+    }
+    void reset();
+    // Not thread-safe for `y`.
+    void merge_into(ProfileAccumulator& y) const;
+    Statistics to_statistics(double seconds_per_tick) const;
+};
+
+struct ProfileThreadData
+{
+    struct Zone
+    {
+        ProfileAccumulator inclusive, exclusive;
+    };
+    Zone zones[Profiler::c_max_zones];
+};
+
+ProfileThreadData* register_profile_thread();
+
+class ProfileZone;
+
+// Innermost active zone and the data of the current thread.
+struct ProfileThreadState
+{
+    ProfileZone* current_zone = nullptr;
+    ProfileThreadData* data = nullptr;
+};
+
+extern thread_local ProfileThreadState t_profile_thread_state;
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const ProfileZoneSite& site)
+        : site(site), parent(t_profile_thread_state.current_zone)
+    {
+        t_profile_thread_state.current_zone = this;
+        start = tsc_clock::ticks();
+        if (trace::enabled())
+            trace::detail::record(site.name, 'B', start);
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ~ProfileZone()
+    {
+        const uint64_t end = tsc_clock::ticks();
+        if (trace::enabled())
+            trace::detail::record(site.name, 'E', end);
+        const int64_t inclusive = int64_t(end - start);
+        const int id = site.id;
+        auto& state = t_profile_thread_state;
+        state.current_zone = parent;
+        if (parent)
+            parent->children_ticks += inclusive;
+        if (UL_UNLIKELY(!state.data))
+            state.data = register_profile_thread();
+        if (UL_LIKELY(id >= 0)) {
+            auto& zone = state.data->zones[id];
+            zone.inclusive.add(inclusive);
+            zone.exclusive.add(inclusive - children_ticks);
+        }
+    }
+
+private:
+    const ProfileZoneSite& site;
+    ProfileZone* const parent;
+    uint64_t start;
+    int64_t children_ticks = 0;
+};
+
+}  // namespace detail
+}  // namespace ul
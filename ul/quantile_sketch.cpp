@@ -0,0 +1,351 @@
+#include "ul/quantile_sketch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ul/math.h"
+
+namespace ul {
+
+namespace {
+
+// Rank limit of a centroid starting at rank q0, from the arcsine scale
+// function k(q) = compression / (2 pi) * asin(2q - 1): a centroid may span
+// at most one unit of k.
+double rank_limit(double q0, double compression)
+{
+    const double k0 = compression / (2 * M_PI) * asin(2 * q0 - 1);
+    const double angle = std::min((k0 + 1) * 2 * M_PI / compression, M_PI / 2);
+    return (sin(angle) + 1) / 2;
+}
+
+double interpolate(double x0, double x1, double t)
+{
+    return x0 + (x1 - x0) * t;
+}
+
+const uint8_t c_magic[4] = {'U', 'L', 'Q', 'S'};
+const uint8_t c_version = 1;
+
+void put_u64(std::vector<uint8_t>& out, uint64_t x)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(uint8_t(x >> (8 * i)));
+}
+
+void put_f64(std::vector<uint8_t>& out, double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    put_u64(out, u);
+}
+
+// LEB128
+void put_varint(std::vector<uint8_t>& out, uint64_t x)
+{
+    while (x >= 0x80) {
+        out.push_back(uint8_t(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back(uint8_t(x));
+}
+
+struct Reader
+{
+    span<const uint8_t> bytes;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint64_t u64()
+    {
+        if (pos + 8 > bytes.size()) {
+            ok = false;
+            return 0;
+        }
+        uint64_t x = 0;
+        for (int i = 0; i < 8; ++i)
+            x |= uint64_t(bytes[pos++]) << (8 * i);
+        return x;
+    }
+    double f64()
+    {
+        const uint64_t u = u64();
+        double x;
+        memcpy(&x, &u, sizeof(x));
+        return x;
+    }
+    uint64_t varint()
+    {
+        uint64_t x = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= bytes.size())
+                break;
+            const uint8_t b = bytes[pos++];
+            x |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return x;
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+}  // namespace
+
+QuantileSketch::QuantileSketch(double compression)
+    : compression_(compression),
+      buffer_capacity(std::max<size_t>(16, size_t(4 * compression)))
+{
+    UL_CHECK(10 <= compression && compression <= c_max_compression,
+             "QuantileSketch: compression %g is not in [10, %g].", compression,
+             c_max_compression);
+    buffer.reserve(buffer_capacity);
+}
+
+void QuantileSketch::add(span<const double> xs)
+{
+    for (double x : xs)
+        add(x);
+}
+
+void QuantileSketch::add(span<const float> xs)
+{
+    for (float x : xs)
+        add(double(x));
+}
+
+void QuantileSketch::merge_scratch(int64_t total_weight) const
+{
+    centroids_.clear();
+    if (scratch.empty())
+        return;
+    const double total = double(total_weight);
+    double weight_so_far = 0;  // of the finished centroids
+    double limit = total * rank_limit(0, compression_);
+    // The current centroid as weight and weighted sum, divided when done.
+    double weight = scratch[0].weight;
+    double sum = scratch[0].mean * weight;
+    for (size_t i = 1; i < scratch.size(); ++i) {
+        const Centroid& next = scratch[i];
+        if (weight_so_far + weight + next.weight <= limit) {
+            weight += next.weight;
+            sum += next.mean * next.weight;
+        } else {
+            weight_so_far += weight;
+            centroids_.push_back({sum / weight, weight});
+            limit = total * rank_limit(weight_so_far / total, compression_);
+            weight = next.weight;
+            sum = next.mean * weight;
+        }
+    }
+    centroids_.push_back({sum / weight, weight});
+}
+
+void QuantileSketch::compress() const
+{
+    if (buffer.empty())
+        return;
+    std::sort(buffer.begin(), buffer.end());
+    lower_ = std::isnan(lower_) ? buffer.front()
+                                : std::min(lower_, buffer.front());
+    upper_ = std::isnan(upper_) ? buffer.back()
+                                : std::max(upper_, buffer.back());
+
+    // Merge the sorted buffer with the sorted centroids.
+    scratch.clear();
+    scratch.reserve(centroids_.size() + buffer.size());
+    size_t i = 0;
+    for (double x : buffer) {
+        while (i < centroids_.size() && centroids_[i].mean <= x)
+            scratch.push_back(centroids_[i++]);
+        scratch.push_back({x, 1});
+    }
+    scratch.insert(scratch.end(), centroids_.begin() + i, centroids_.end());
+
+    count_ += int64_t(buffer.size());
+    buffer.clear();
+    merge_scratch(count_);
+}
+
+void QuantileSketch::merge(const QuantileSketch& x)
+{
+    x.compress();
+    if (x.count_ == 0)
+        return;
+    compress();
+    scratch.clear();
+    scratch.resize(centroids_.size() + x.centroids_.size());
+    std::merge(centroids_.begin(), centroids_.end(), x.centroids_.begin(),
+               x.centroids_.end(), scratch.begin(),
+               [](const Centroid& a, const Centroid& b) {
+                   return a.mean < b.mean;
+               });
+    count_ += x.count_;
+    lower_ = std::isnan(lower_) ? x.lower_ : std::min(lower_, x.lower_);
+    upper_ = std::isnan(upper_) ? x.upper_ : std::max(upper_, x.upper_);
+    merge_scratch(count_);
+}
+
+void QuantileSketch::reset()
+{
+    centroids_.clear();
+    buffer.clear();
+    count_ = 0;
+    lower_ = upper_ = NAN;
+}
+
+double QuantileSketch::lower() const
+{
+    compress();
+    return lower_;
+}
+
+double QuantileSketch::upper() const
+{
+    compress();
+    return upper_;
+}
+
+const std::vector<QuantileSketch::Centroid>& QuantileSketch::centroids() const
+{
+    compress();
+    return centroids_;
+}
+
+// The weight of a centroid is spread evenly around its mean: half of it is
+// below and half above. Between the means of neighbouring centroids and
+// between the extreme centroids and the min/max the rank is interpolated
+// linearly.
+double QuantileSketch::quantile(double q) const
+{
+    compress();
+    if (count_ == 0 || std::isnan(q))
+        return NAN;
+    if (q <= 0)
+        return lower_;
+    if (q >= 1)
+        return upper_;
+    const auto& c = centroids_;
+    const size_t n = c.size();
+    if (n == 1)
+        return interpolate(lower_, upper_, q);
+
+    const double index = q * double(count_);
+    const double first_half = c[0].weight / 2;
+    if (index < first_half)
+        return interpolate(lower_, c[0].mean, index / first_half);
+
+    double weight_so_far = first_half;  // rank of the current mean
+    for (size_t i = 0; i + 1 < n; ++i) {
+        const double dw = (c[i].weight + c[i + 1].weight) / 2;
+        if (weight_so_far + dw > index)
+            return interpolate(c[i].mean, c[i + 1].mean,
+                               (index - weight_so_far) / dw);
+        weight_so_far += dw;
+    }
+    const double last_half = c[n - 1].weight / 2;
+    return interpolate(c[n - 1].mean, upper_,
+                       std::min(1.0, (index - weight_so_far) / last_half));
+}
+
+double QuantileSketch::cdf(double x) const
+{
+    compress();
+    if (count_ == 0 || std::isnan(x))
+        return NAN;
+    if (x < lower_)
+        return 0;
+    if (x >= upper_)
+        return 1;
+    const auto& c = centroids_;
+    const size_t n = c.size();
+    const double total = double(count_);
+    if (n == 1)
+        return (x - lower_) / (upper_ - lower_);
+
+    const double first_half = c[0].weight / 2;
+    if (x < c[0].mean)
+        return first_half * (x - lower_) / (c[0].mean - lower_) / total;
+
+    double weight_so_far = first_half;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        const double dw = (c[i].weight + c[i + 1].weight) / 2;
+        if (x < c[i + 1].mean)
+            return (weight_so_far + dw * (x - c[i].mean) /
+                                        (c[i + 1].mean - c[i].mean)) /
+                   total;
+        weight_so_far += dw;
+    }
+    const double last_half = c[n - 1].weight / 2;
+    return (weight_so_far +
+            last_half * (x - c[n - 1].mean) / (upper_ - c[n - 1].mean)) /
+           total;
+}
+
+// Format: "ULQS", version (1 byte), compression, count (u64), min, max
+// (doubles), number of centroids (varint), then for each centroid its mean
+// (double) and weight (varint). All fixed-size fields are little-endian.
+std::vector<uint8_t> QuantileSketch::serialize() const
+{
+    compress();
+    std::vector<uint8_t> out(c_magic, c_magic + 4);
+    out.push_back(c_version);
+    put_f64(out, compression_);
+    put_u64(out, uint64_t(count_));
+    put_f64(out, lower_);
+    put_f64(out, upper_);
+    put_varint(out, centroids_.size());
+    for (auto& c : centroids_) {
+        put_f64(out, c.mean);
+        put_varint(out, uint64_t(c.weight));
+    }
+    return out;
+}
+
+bool QuantileSketch::deserialize(span<const uint8_t> bytes,
+                                 QuantileSketch& result)
+{
+    if (bytes.size() < 5 || memcmp(bytes.data(), c_magic, 4) != 0 ||
+        bytes[4] != c_version)
+        return false;
+    Reader r{bytes, 5};
+    const double compression = r.f64();
+    const int64_t count = int64_t(r.u64());
+    const double lower = r.f64(), upper = r.f64();
+    const uint64_t n = r.varint();
+    // Each centroid takes at least 9 bytes.
+    if (!r.ok || !(10 <= compression && compression <= c_max_compression) ||
+        count < 0 || n > (bytes.size() - r.pos) / 9)
+        return false;
+    // NANs only for the empty sketch.
+    if (n > 0 ? !(lower <= upper) : !(std::isnan(lower) && std::isnan(upper)))
+        return false;
+
+    QuantileSketch s(compression);
+    s.centroids_.resize(n);
+    int64_t total = 0;
+    for (auto& c : s.centroids_) {
+        c.mean = r.f64();
+        const uint64_t w = r.varint();
+        // total <= count, so this also rules out overflow.
+        if (w == 0 || w > uint64_t(count - total) ||
+            !(lower <= c.mean && c.mean <= upper))
+            return false;
+        c.weight = double(w);
+        total += int64_t(w);
+    }
+    if (!r.ok || r.pos != bytes.size() || total != count)
+        return false;
+    if (!std::is_sorted(s.centroids_.begin(), s.centroids_.end(),
+                        [](const Centroid& a, const Centroid& b) {
+                            return a.mean < b.mean;
+                        }))
+        return false;
+    s.count_ = count;
+    s.lower_ = lower;
+    s.upper_ = upper;
+    result = std::move(s);
+    return true;
+}
+
+}  // namespace ul
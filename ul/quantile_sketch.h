@@ -0,0 +1,110 @@
+#pragma once
+
+// Streaming quantile estimator in fixed memory (merging t-digest)
+//
+//     ul::QuantileSketch latencies;
+//     ul::Statistics stats;
+//     for (double x : samples) {
+//         latencies.add(x);
+//         stats.add(x);
+//     }
+//     printf("mean %f median %f p95 %f\n", stats.mean(),
+//            latencies.quantile(0.5), latencies.quantile(0.95));
+//
+// Values are buffered and merged into at most about `compression` weighted
+// centroids when the buffer fills up (one sort of the buffer and a linear
+// merge), so `add` is O(1) amortized apart from the buffer sort. The
+// centroid sizes are bounded by the arcsine scale function, which keeps
+// centroids near the tails small: the rank error of `quantile(q)` is about
+// q(1-q) / compression relative to q(1-q), that is, much smaller at p1 or
+// p99 than at the median. The minimum and maximum are exact.
+//
+// `merge` combines sketches of per-thread shards. `serialize` writes a
+// compact, portable (little-endian) byte form, `deserialize` reads it back.
+//
+// Not thread-safe, queries also compress the buffer.
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/config.h"
+#include "ul/span.h"
+
+namespace ul {
+
+class QuantileSketch
+{
+public:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    // Also the limit for `deserialize`, where the compression comes from
+    // untrusted bytes.
+    static constexpr double c_max_compression = 1e5;
+
+    // compression in [10, c_max_compression].
+    explicit QuantileSketch(double compression = 100);
+
+    // NANs are skipped.
+    void add(double x)
+    {
+        if (UL_UNLIKELY(std::isnan(x)))
+            return;
+        buffer.push_back(x);
+        if (UL_UNLIKELY(buffer.size() >= buffer_capacity))
+            compress();
+    }
+    void add(span<const double> xs);
+    void add(span<const float> xs);
+
+    // Adds all values added to `x`.
+    void merge(const QuantileSketch& x);
+
+    void reset();
+
+    int count() const
+    {
+        UL_CHECK_ALWAYS(count64() <= INT_MAX);
+        return static_cast<int>(count64());
+    }
+    int64_t count64() const { return count_ + int64_t(buffer.size()); }
+    double lower() const;
+    double upper() const;
+    double compression() const { return compression_; }
+
+    // Value at rank q in [0, 1], NAN if empty.
+    double quantile(double q) const;
+    // Fraction of values <= x, NAN if empty.
+    double cdf(double x) const;
+
+    // The merged centroids, in increasing order of their means.
+    const std::vector<Centroid>& centroids() const;
+
+    std::vector<uint8_t> serialize() const;
+    // Returns false if `bytes` is not a serialized sketch.
+    static bool deserialize(span<const uint8_t> bytes, QuantileSketch& result);
+
+private:
+    void compress() const;
+    // Merges the centroids in `scratch` (sorted) into centroids_.
+    void merge_scratch(int64_t total_weight) const;
+
+    double compression_;
+    size_t buffer_capacity;
+
+    // Merged centroids and the buffered values (compressed lazily, also by
+    // the const queries).
+    mutable std::vector<Centroid> centroids_;
+    mutable std::vector<double> buffer;
+    mutable int64_t count_ = 0;  // total weight of centroids_
+    mutable double lower_ = NAN, upper_ = NAN;
+    mutable std::vector<Centroid> scratch;
+};
+
+}  // namespace ul
@@ -0,0 +1,531 @@
+#include "ul/roots.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "ul/check.h"
+#include "ul/math.h"
+
+namespace ul {
+
+namespace {
+
+using complex = std::complex<double>;
+
+const int c_aberth_max_iterations = 500;
+const int c_refine_max_iterations = 100;
+// Sturm remainder coefficients below this, relative to the largest
+// coefficient of the dividend, are zero.
+const double c_sturm_zero = 1e-12;
+
+// Reused by the batch versions.
+struct Scratch
+{
+    std::vector<complex> z;
+    std::vector<unsigned char> done;
+    std::vector<double> sturm;  // the sequence, polynomial k at k (n + 1)
+    std::vector<int> sturm_sizes;
+};
+
+// a / b and |z| without the checks for infinities of std::complex, which
+// are library calls (__divdc3, cabs, also in std::norm).
+complex divide(complex a, complex b)
+{
+    const double r = 1 / (b.real() * b.real() + b.imag() * b.imag());
+    return complex((a.real() * b.real() + a.imag() * b.imag()) * r,
+                   (a.imag() * b.real() - a.real() * b.imag()) * r);
+}
+
+double magnitude(complex z)
+{
+    return std::sqrt(z.real() * z.real() + z.imag() * z.imag());
+}
+
+// Number of coefficients without the leading zeros.
+int trimmed_size(const double* p, int n)
+{
+    while (n > 0 && p[n - 1] == 0)
+        --n;
+    return n;
+}
+
+double horner(const double* p, int n, double x)
+{
+    double f = p[n - 1];
+    for (int i = n - 2; i >= 0; --i)
+        f = f * x + p[i];
+    return f;
+}
+
+// f = p(x), df = p'(x).
+void horner(const double* p, int n, double x, double& f, double& df)
+{
+    f = p[n - 1];
+    df = 0;
+    for (int i = n - 2; i >= 0; --i) {
+        df = df * x + f;
+        f = f * x + p[i];
+    }
+}
+
+// Newton steps from x while they decrease |p(x)|.
+double polish(const double* p, int n, double x)
+{
+    double f, df;
+    horner(p, n, x, f, df);
+    for (int i = 0; i < 3 && f != 0 && df != 0; ++i) {
+        const double y = x - f / df;
+        double fy, dfy;
+        horner(p, n, y, fy, dfy);
+        if (!(fabs(fy) < fabs(f)))
+            break;
+        x = y;
+        f = fy;
+        df = dfy;
+    }
+    return x;
+}
+
+// a x^2 + b x + c, a != 0.
+void quadratic_roots(double c, double b, double a, complex* out)
+{
+    double disc = b * b - 4 * a * c;
+    if (fabs(disc) <= 4 * DBL_EPSILON * (b * b + fabs(4 * a * c)))
+        disc = 0;
+    if (disc == 0) {
+        out[0] = out[1] = -b / (2 * a);
+    } else if (disc > 0) {
+        // Both roots without cancellation.
+        const double q = -0.5 * (b + std::copysign(std::sqrt(disc), b));
+        out[0] = q / a;
+        out[1] = c / q;
+    } else {
+        const double re = -b / (2 * a);
+        const double im = std::sqrt(-disc) / fabs(2 * a);
+        out[0] = complex(re, im);
+        out[1] = complex(re, -im);
+    }
+}
+
+// p[0, 4), p[3] != 0.
+void cubic_roots(const double* p, complex* out)
+{
+    // x = t - a / 3, t^3 + pp t + qq = 0.
+    const double a = p[2] / p[3], b = p[1] / p[3], c = p[0] / p[3];
+    const double shift = -a / 3;
+    const double pp = b - a * a / 3;
+    const double qq = (2 * a * a / 27 - b / 3) * a + c;
+    const double h = qq * qq / 4, k = pp * pp * pp / 27;
+    const double d = h + k;
+    if (fabs(d) <= 64 * DBL_EPSILON * (h + fabs(k))) {
+        // A double root, or a triple one for pp == qq == 0. The roots sum to
+        // -a.
+        const double r = polish(p, 4, 2 * std::cbrt(-qq / 2) + shift);
+        out[0] = r;
+        out[1] = out[2] = (-a - r) / 2;
+    } else if (d > 0) {
+        // One real root (Cardano), the largest of u^3 and v^3 by magnitude
+        // first. Deflated: x^3 + a x^2 + b x + c = (x - r) (x^2 + e x + f).
+        const double u = std::cbrt(-qq / 2 - std::copysign(std::sqrt(d), qq));
+        const double r = polish(p, 4, u - pp / (3 * u) + shift);
+        const double e = a + r;
+        out[0] = r;
+        quadratic_roots(b + e * r, e, 1, out + 1);
+    } else {
+        // Three real roots, t = 2 m cos(theta).
+        const double m = std::sqrt(-pp / 3);
+        const double theta =
+            std::acos(std::min(std::max(-qq / (2 * m * m * m), -1.0), 1.0)) /
+            3;
+        for (int j = 0; j < 3; ++j) {
+            const double t = 2 * m * std::cos(theta - 2 * M_PI * j / 3);
+            out[j] = polish(p, 4, t + shift);
+        }
+    }
+}
+
+// p(z) / p'(z), through the reversed polynomial for |z| > 1 to avoid
+// overflow. Sets `converged` when p(z) is within the rounding error of its
+// evaluation.
+complex newton_correction(const double* p, int n, complex z, bool& converged)
+{
+    complex f, df;
+    double bound = 0;
+    const double az = magnitude(z);
+    if (az <= 1) {
+        f = p[n - 1];
+        bound = fabs(p[n - 1]);
+        for (int i = n - 2; i >= 0; --i) {
+            df = df * z + f;
+            f = f * z + p[i];
+            bound = bound * az + fabs(p[i]);
+        }
+        converged = magnitude(f) <= 8 * DBL_EPSILON * bound;
+        return df == 0.0 ? f : divide(f, df);
+    }
+    // p(z) = z^d q(y), y = 1 / z, p / p' = z / (d - y q'(y) / q(y)).
+    const complex y = divide(1.0, z);
+    const double ay = 1 / az;
+    f = p[0];
+    bound = fabs(p[0]);
+    for (int i = 1; i < n; ++i) {
+        df = df * y + f;
+        f = f * y + p[i];
+        bound = bound * ay + fabs(p[i]);
+    }
+    converged = magnitude(f) <= 8 * DBL_EPSILON * bound;
+    if (f == 0.0)
+        return 0;
+    return divide(z, double(n - 1) - y * divide(df, f));
+}
+
+// Aberth-Ehrlich iteration, n > 4 coefficients.
+void aberth_roots(const double* p, int n, complex* out, Scratch& s)
+{
+    const int d = n - 1;
+    s.z.resize(size_t(d));
+    s.done.assign(size_t(d), 0);
+    complex* z = s.z.data();
+    // Start on the circle of the geometric mean of the magnitudes, off the
+    // real axis.
+    const double radius = std::pow(fabs(p[0] / p[d]), 1.0 / d);
+    const complex rotation = std::polar(1.0, 2 * M_PI / d);
+    z[0] = std::polar(radius, 0.4);
+    for (int k = 1; k < d; ++k)
+        z[k] = z[k - 1] * rotation;
+    for (int iteration = 0; iteration < c_aberth_max_iterations; ++iteration) {
+        bool converged = true;
+        for (int k = 0; k < d; ++k) {
+            if (s.done[k])
+                continue;
+            bool at_root;
+            const complex ratio = newton_correction(p, n, z[k], at_root);
+            complex sum = 0;
+            for (int j = 0; j < d; ++j) {
+                if (j != k)
+                    sum += divide(1.0, z[k] - z[j]);
+            }
+            const complex w = divide(ratio, 1.0 - ratio * sum);
+            z[k] -= w;
+            // One more step after reaching the root, for the last bits.
+            if (at_root || magnitude(w) <= DBL_EPSILON * magnitude(z[k]))
+                s.done[k] = 1;
+            else
+                converged = false;
+        }
+        if (converged)
+            break;
+    }
+    for (int k = 0; k < d; ++k) {
+        out[k] = z[k];
+        if (fabs(z[k].imag()) <= 16 * DBL_EPSILON * magnitude(z[k]))
+            out[k] = polish(p, n, z[k].real());
+    }
+}
+
+int roots_impl(const double* p, int n, complex* out, Scratch& s)
+{
+    n = trimmed_size(p, n);
+    int count = 0;
+    while (count + 1 < n && p[count] == 0)
+        out[count++] = 0;
+    p += count;
+    n -= count;
+    if (n == 2)
+        out[count] = -p[0] / p[1];
+    else if (n == 3)
+        quadratic_roots(p[0], p[1], p[2], out + count);
+    else if (n == 4)
+        cubic_roots(p, out + count);
+    else if (n > 4)
+        aberth_roots(p, n, out + count, s);
+    return count + std::max(n - 1, 0);
+}
+
+// Polynomial k of the Sturm sequence.
+double* sturm_poly(Scratch& s, int n, int k)
+{
+    return s.sturm.data() + size_t(k) * size_t(n + 1);
+}
+
+// p / max |p[i]|
+void normalize(double* p, int n)
+{
+    double m = 0;
+    for (int i = 0; i < n; ++i)
+        m = std::max(m, fabs(p[i]));
+    for (int i = 0; i < n; ++i)
+        p[i] /= m;
+}
+
+// Sturm sequence of p[0, n), n > 1: p, p', then the negated remainders,
+// each normalized. Returns its length.
+int make_sturm_sequence(const double* p, int n, Scratch& s)
+{
+    s.sturm.resize(size_t(n) * size_t(n + 1));
+    s.sturm_sizes.resize(size_t(n));
+    double* s0 = sturm_poly(s, n, 0);
+    double* s1 = sturm_poly(s, n, 1);
+    for (int i = 0; i < n; ++i)
+        s0[i] = p[i];
+    for (int i = 1; i < n; ++i)
+        s1[i - 1] = i * p[i];
+    normalize(s0, n);
+    normalize(s1, n - 1);
+    s.sturm_sizes[0] = n;
+    s.sturm_sizes[1] = n - 1;
+    int length = 2;
+    while (s.sturm_sizes[length - 1] > 1) {
+        // r = a mod b, in place of a copy of a.
+        const double* b = sturm_poly(s, n, length - 1);
+        const int nb = s.sturm_sizes[length - 1];
+        double* r = sturm_poly(s, n, length);
+        int nr = s.sturm_sizes[length - 2];
+        std::copy(sturm_poly(s, n, length - 2),
+                  sturm_poly(s, n, length - 2) + nr, r);
+        for (; nr >= nb; --nr) {
+            const double q = r[nr - 1] / b[nb - 1];
+            for (int i = 0; i < nb; ++i)
+                r[nr - nb + i] -= q * b[i];
+        }
+        // The dividend is normalized.
+        while (nr > 0 && fabs(r[nr - 1]) <= c_sturm_zero)
+            --nr;
+        if (nr == 0)
+            break;  // b is the gcd of p and p'
+        for (int i = 0; i < nr; ++i)
+            r[i] = -r[i];
+        normalize(r, nr);
+        s.sturm_sizes[length] = nr;
+        ++length;
+    }
+    return length;
+}
+
+// Whether p(x) is zero within the rounding error of horner: 2 n eps
+// sum |p[i]| |x|^i.
+bool on_root(const double* p, int n, double x)
+{
+    double bound = fabs(p[n - 1]);
+    for (int i = n - 2; i >= 0; --i)
+        bound = bound * fabs(x) + fabs(p[i]);
+    return fabs(horner(p, n, x)) <= 2 * n * DBL_EPSILON * bound;
+}
+
+// x moved toward `toward` until p is clearly not zero there, by at most
+// half the distance. The sign of p and so the Sturm counts are reliable off
+// the roots.
+double off_root(const double* p, int n, double x, double toward)
+{
+    if (!on_root(p, n, x))
+        return x;
+    const double distance = toward - x;
+    double step = DBL_EPSILON * std::max(fabs(x), fabs(distance));
+    for (int i = 0; i < 64 && 2 * step < fabs(distance); ++i, step *= 2) {
+        const double y = x + std::copysign(step, distance);
+        if (!on_root(p, n, y))
+            return y;
+    }
+    return x + distance / 2;
+}
+
+// Sign changes of the Sturm sequence at x.
+int sign_changes(Scratch& s, int n, int length, double x)
+{
+    int changes = 0;
+    double previous = 0;
+    for (int k = 0; k < length; ++k) {
+        const double v = horner(sturm_poly(s, n, k), s.sturm_sizes[k], x);
+        if (v == 0)
+            continue;
+        changes += previous != 0 && (v < 0) != (previous < 0);
+        previous = v;
+    }
+    return changes;
+}
+
+// The single root in (a, b], p(a) != 0.
+double refine_root(const double* p,
+                   int n,
+                   double a,
+                   double b,
+                   Scratch& s,
+                   int length)
+{
+    const double fa = horner(p, n, a);
+    const double fb = horner(p, n, b);
+    if (fb == 0)
+        return b;
+    if ((fa < 0) == (fb < 0)) {
+        // Even multiplicity: bisection on the counts.
+        const int vb = sign_changes(s, n, length, b);
+        for (int i = 0; i < c_refine_max_iterations; ++i) {
+            const double m = a + (b - a) / 2;
+            if (!(a < m && m < b))
+                break;
+            if (sign_changes(s, n, length, m) > vb)
+                a = m;
+            else
+                b = m;
+        }
+        return a + (b - a) / 2;
+    }
+    // Newton steps, bisection when they leave the bracket.
+    double x = a + (b - a) / 2;
+    for (int i = 0; i < c_refine_max_iterations; ++i) {
+        double f, df;
+        horner(p, n, x, f, df);
+        if (f == 0)
+            return x;
+        if ((f < 0) == (fa < 0))
+            a = x;
+        else
+            b = x;
+        double next = df != 0 ? x - f / df : a;
+        if (!(a < next && next < b))
+            next = a + (b - a) / 2;
+        if (fabs(next - x) <= 2 * DBL_EPSILON * fabs(next) || next == a ||
+            next == b)
+            return next;
+        x = next;
+    }
+    return x;
+}
+
+int real_roots_sturm(const double* p,
+                     int n,
+                     double lo,
+                     double hi,
+                     double* out,
+                     Scratch& s)
+{
+    const int length = make_sturm_sequence(p, n, s);
+    int count = 0;
+    // Roots on the ends are found here, the Sturm counts are taken off them.
+    const bool lo_root = on_root(p, n, lo);
+    const bool hi_root = lo < hi && on_root(p, n, hi);
+    if (lo_root)
+        out[count++] = lo;
+    const double a = off_root(p, n, lo, hi);
+    const double b = off_root(p, n, hi, lo);
+    // Intervals (a, b] and their sign changes, the leftmost last.
+    struct Interval
+    {
+        double a, b;
+        int va, vb;
+    };
+    Interval stack[64];
+    int top = 0;
+    if (a < b) {
+        stack[top++] = {a, b, sign_changes(s, n, length, a),
+                        sign_changes(s, n, length, b)};
+    }
+    while (top > 0) {
+        const Interval iv = stack[--top];
+        const int roots = iv.va - iv.vb;
+        if (roots <= 0)
+            continue;
+        if (roots == 1) {
+            out[count++] = refine_root(p, n, iv.a, iv.b, s, length);
+            continue;
+        }
+        const double mid = iv.a + (iv.b - iv.a) / 2;
+        if (!(iv.a < mid && mid < iv.b) || top + 2 > 64) {
+            out[count++] = mid;  // a cluster at the resolution of doubles
+            continue;
+        }
+        const double m = off_root(p, n, mid, iv.b);
+        const int vm = sign_changes(s, n, length, m);
+        stack[top++] = {m, iv.b, vm, iv.vb};
+        stack[top++] = {iv.a, m, iv.va, vm};
+    }
+    if (hi_root)
+        out[count++] = hi;
+    return count;
+}
+
+int real_roots_in_impl(const double* p,
+                       int n,
+                       double lo,
+                       double hi,
+                       double* out,
+                       Scratch& s)
+{
+    UL_CHECK(lo <= hi, "real_roots_in: empty interval [%g, %g].", lo, hi);
+    n = trimmed_size(p, n);
+    if (n > 4)
+        return real_roots_sturm(p, n, lo, hi, out, s);
+    if (n < 2)
+        return 0;
+    complex z[3];
+    roots_impl(p, n, z, s);
+    int count = 0;
+    for (int i = 0; i < n - 1; ++i) {
+        const double x = z[i].real();
+        if (z[i].imag() == 0 && lo <= x && x <= hi)
+            out[count++] = x;
+    }
+    std::sort(out, out + count);
+    return int(std::unique(out, out + count) - out);
+}
+
+}  // namespace
+
+namespace detail {
+
+int roots(const double* p, int n, std::complex<double>* out)
+{
+    Scratch s;
+    return roots_impl(p, n, out, s);
+}
+
+int real_roots_in(const double* p, int n, double lo, double hi, double* out)
+{
+    Scratch s;
+    return real_roots_in_impl(p, n, lo, hi, out, s);
+}
+
+}  // namespace detail
+
+void roots_batch(span<const double> ps,
+                 int degree,
+                 span<std::complex<double>> out)
+{
+    UL_CHECK(degree >= 0, "roots_batch: negative degree %d.", degree);
+    const size_t n = size_t(degree) + 1;
+    const size_t count = ps.size() / n;
+    UL_CHECK(ps.size() == count * n && out.size() == count * size_t(degree),
+             "roots_batch: %d coefficients, %d roots for degree %d.",
+             int(ps.size()), int(out.size()), degree);
+    Scratch s;
+    for (size_t k = 0; k < count; ++k) {
+        complex* r = out.data() + k * size_t(degree);
+        const int found = roots_impl(ps.data() + k * n, int(n), r, s);
+        std::fill(r + found, r + degree, complex(NAN, NAN));
+    }
+}
+
+void real_roots_in_batch(span<const double> ps,
+                         int degree,
+                         double lo,
+                         double hi,
+                         span<double> out,
+                         span<int> counts)
+{
+    UL_CHECK(degree >= 0, "real_roots_in_batch: negative degree %d.", degree);
+    const size_t n = size_t(degree) + 1;
+    const size_t count = ps.size() / n;
+    UL_CHECK(ps.size() == count * n && out.size() == count * size_t(degree) &&
+                 counts.size() == count,
+             "real_roots_in_batch: %d coefficients, %d roots, %d counts for "
+             "degree %d.",
+             int(ps.size()), int(out.size()), int(counts.size()), degree);
+    Scratch s;
+    for (size_t k = 0; k < count; ++k) {
+        counts[k] = real_roots_in_impl(ps.data() + k * n, int(n), lo, hi,
+                                       out.data() + k * size_t(degree), s);
+    }
+}
+
+}  // namespace ul
@@ -0,0 +1,109 @@
+#pragma once
+
+// Roots of polynomials, like matlab's roots
+//
+//     std::array<double, 4> p = {-6, 11, -6, 1};  // (x - 1) (x - 2) (x - 3)
+//     auto z = ul::roots(p);                       // complex, any order
+//     auto x = ul::real_roots_in(ul::polyder(p), 0.0, 4.0);  // extrema
+//
+// The coefficients are in ascending order, like polyval (matlab's are
+// descending). Leading zero coefficients lower the degree. Trailing ones
+// (p[0] == 0, ...) are exact zero roots.
+//
+// Degrees 1 to 3 have closed forms: the quadratic formula without
+// cancellation, and Cardano's or the trigonometric formula for cubics with
+// the real roots polished by Newton steps. A discriminant within rounding
+// of 0 is a double root. Higher degrees use the Aberth-Ehrlich iteration,
+// which refines all roots at once, each with Newton's correction pushed away
+// from the others. It converges cubically to simple roots, linearly to
+// multiple ones (to about sqrt(DBL_EPSILON) relative accuracy).
+//
+// `real_roots_in` returns the distinct real roots in [lo, hi], ascending.
+// From degree 4 it counts the roots in intervals with a Sturm sequence and
+// bisects until each interval holds one. Then it refines the root with
+// Newton steps, falling back to bisection outside the bracket. Where p is
+// zero within rounding, the counts are unreliable: such ends are returned
+// as roots and the counts are taken next to them, such bisection points
+// are moved off the root. Roots closer than about 1e-6 relative can count
+// as one.
+//
+// The batch versions take many polynomials of the same degree, back to back,
+// and reuse the scratch buffers.
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include "ul/span.h"
+
+namespace ul {
+
+namespace detail {
+
+// Roots of the polynomial p[0, n) into out[0, n - 1), returns their number.
+int roots(const double* p, int n, std::complex<double>* out);
+// Distinct real roots of p[0, n) in [lo, hi] into out[0, n - 1), ascending,
+// returns their number.
+int real_roots_in(const double* p, int n, double lo, double hi, double* out);
+
+// Calls f(coefficients, n) with the coefficients of p as doubles.
+template <class V, class F>
+auto with_double_coefficients(const V& p, F f)
+{
+    const int n = int(p.size());
+    const int c_inline_coefs = 32;
+    double inline_coefs[c_inline_coefs];
+    std::vector<double> heap_coefs;
+    double* coefs = inline_coefs;
+    if (n > c_inline_coefs) {
+        heap_coefs.resize(size_t(n));
+        coefs = heap_coefs.data();
+    }
+    for (int i = 0; i < n; ++i)
+        coefs[i] = double(p[i]);
+    return f(static_cast<const double*>(coefs), n);
+}
+
+}  // namespace detail
+
+// Roots of p[0] + p[1] x + p[2] x^2 + ..., in no particular order.
+template <class V>
+std::vector<std::complex<double>> roots(const V& p)
+{
+    return detail::with_double_coefficients(p, [](const double* q, int n) {
+        std::vector<std::complex<double>> r(size_t(std::max(n - 1, 0)));
+        r.resize(size_t(detail::roots(q, n, r.data())));
+        return r;
+    });
+}
+
+// Distinct real roots of p in [lo, hi], ascending.
+template <class V>
+std::vector<double> real_roots_in(const V& p, double lo, double hi)
+{
+    return detail::with_double_coefficients(
+        p, [lo, hi](const double* q, int n) {
+            std::vector<double> r(size_t(std::max(n - 1, 0)));
+            r.resize(size_t(detail::real_roots_in(q, n, lo, hi, r.data())));
+            return r;
+        });
+}
+
+// Roots of the polynomials ps[k (degree + 1), (k + 1) (degree + 1)) into
+// out[k degree, (k + 1) degree), padded with NANs for the degrees lowered by
+// leading zero coefficients.
+void roots_batch(span<const double> ps,
+                 int degree,
+                 span<std::complex<double>> out);
+
+// Distinct real roots in [lo, hi] of the polynomials of `ps`, as in
+// roots_batch: counts[k] of them, ascending, at out[k degree].
+void real_roots_in_batch(span<const double> ps,
+                         int degree,
+                         double lo,
+                         double hi,
+                         span<double> out,
+                         span<int> counts);
+
+}  // namespace ul
@@ -0,0 +1,126 @@
+#pragma once
+
+// SIMD vectors of double and float behind one interface, for kernels written
+// once as templates over the element type:
+//
+//     template <class T>
+//     UL_TARGET("avx2,fma") void kernel_avx2(const T* x, ...)
+//     {
+//         using S = ul::detail::Avx2<T>;
+//         typename S::V a = S::zero();
+//         ...  // S::c_width values per vector
+//     }
+//
+// Only where UL_X86_DISPATCH is defined (see config.h). The kernel must have
+// the same UL_TARGET as the operations it uses, select it at runtime with
+// cpu_features() (cpu.h).
+
+#include <cstddef>
+
+#include "ul/config.h"
+
+#ifdef UL_X86_DISPATCH
+#include <immintrin.h>
+
+namespace ul {
+namespace detail {
+
+template <class T>
+struct Avx2;
+
+template <>
+struct Avx2<double>
+{
+    using V = __m256d;
+    static const size_t c_width = 4;
+    UL_TARGET("avx2,fma") static V zero() { return _mm256_setzero_pd(); }
+    UL_TARGET("avx2,fma") static V set1(double x) { return _mm256_set1_pd(x); }
+    UL_TARGET("avx2,fma") static V load(const double* p)
+    {
+        return _mm256_loadu_pd(p);
+    }
+    UL_TARGET("avx2,fma") static void store(double* p, V x)
+    {
+        _mm256_storeu_pd(p, x);
+    }
+    UL_TARGET("avx2,fma") static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    // a * b + c
+    UL_TARGET("avx2,fma") static V fmadd(V a, V b, V c)
+    {
+        return _mm256_fmadd_pd(a, b, c);
+    }
+};
+
+template <>
+struct Avx2<float>
+{
+    using V = __m256;
+    static const size_t c_width = 8;
+    UL_TARGET("avx2,fma") static V zero() { return _mm256_setzero_ps(); }
+    UL_TARGET("avx2,fma") static V set1(float x) { return _mm256_set1_ps(x); }
+    UL_TARGET("avx2,fma") static V load(const float* p)
+    {
+        return _mm256_loadu_ps(p);
+    }
+    UL_TARGET("avx2,fma") static void store(float* p, V x)
+    {
+        _mm256_storeu_ps(p, x);
+    }
+    UL_TARGET("avx2,fma") static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    UL_TARGET("avx2,fma") static V fmadd(V a, V b, V c)
+    {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+};
+
+template <class T>
+struct Avx512;
+
+template <>
+struct Avx512<double>
+{
+    using V = __m512d;
+    static const size_t c_width = 8;
+    UL_TARGET("avx512f") static V zero() { return _mm512_setzero_pd(); }
+    UL_TARGET("avx512f") static V set1(double x) { return _mm512_set1_pd(x); }
+    UL_TARGET("avx512f") static V load(const double* p)
+    {
+        return _mm512_loadu_pd(p);
+    }
+    UL_TARGET("avx512f") static void store(double* p, V x)
+    {
+        _mm512_storeu_pd(p, x);
+    }
+    UL_TARGET("avx512f") static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    UL_TARGET("avx512f") static V fmadd(V a, V b, V c)
+    {
+        return _mm512_fmadd_pd(a, b, c);
+    }
+};
+
+template <>
+struct Avx512<float>
+{
+    using V = __m512;
+    static const size_t c_width = 16;
+    UL_TARGET("avx512f") static V zero() { return _mm512_setzero_ps(); }
+    UL_TARGET("avx512f") static V set1(float x) { return _mm512_set1_ps(x); }
+    UL_TARGET("avx512f") static V load(const float* p)
+    {
+        return _mm512_loadu_ps(p);
+    }
+    UL_TARGET("avx512f") static void store(float* p, V x)
+    {
+        _mm512_storeu_ps(p, x);
+    }
+    UL_TARGET("avx512f") static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    UL_TARGET("avx512f") static V fmadd(V a, V b, V c)
+    {
+        return _mm512_fmadd_ps(a, b, c);
+    }
+};
+
+}  // namespace detail
+}  // namespace ul
+
+#endif  // UL_X86_DISPATCH
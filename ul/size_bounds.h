@@ -56,7 +56,7 @@ struct sequence_compile_time_size_traits<std::array<T, N>>
     static constexpr size_t size = N;
 };
 
-template <class T, size_t N>
+template <class T, int N>
 struct sequence_compile_time_size_traits<InlineVector<T, N>>
 {
     static constexpr size_t capacity = N;
@@ -168,8 +168,8 @@ struct size_bounds
     constexpr static int compile_time_capacity = Capacity;
     constexpr static int compile_time_size = Size;
 
-    explicit size_bounds(int s) : s(s) {}
-    int runtime_size() const { return s; }
+    constexpr explicit size_bounds(int s) : s(s) {}
+    constexpr int runtime_size() const { return s; }
 
 private:
     const int s;
@@ -179,7 +179,7 @@ private:
 template <int X>
 struct size_bounds_constant : size_bounds<X, X>
 {
-    size_bounds_constant() : size_bounds<X, X>(X) {}
+    constexpr size_bounds_constant() : size_bounds<X, X>(X) {}
 };
 
 // A constant that describes compile-time capacity and runtime size.
@@ -187,7 +187,7 @@ template <int Capacity>
 struct inlinevector_like_size_bounds
     : size_bounds<Capacity, c_runtime_size_marker>
 {
-    explicit inlinevector_like_size_bounds(int size)
+    constexpr explicit inlinevector_like_size_bounds(int size)
         : size_bounds<Capacity, c_runtime_size_marker>(size)
     {}
 };
@@ -196,7 +196,8 @@ struct inlinevector_like_size_bounds
 struct vector_like_size_bounds
     : size_bounds<c_runtime_size_marker, c_runtime_size_marker>
 {
-    explicit vector_like_size_bounds(int size) : size_bounds(size) {}
+    constexpr explicit vector_like_size_bounds(int size) : size_bounds(size)
+    {}
 };
 
 template <class F>
@@ -208,7 +209,7 @@ static constexpr int eval_size_bounds_op(int x, int y)
 }
 
 template <class F, class X, class Y>
-auto make_size_bounds_binary_op(const X& x, const Y& y)
+constexpr auto make_size_bounds_binary_op(const X& x, const Y& y)
 {
     return size_bounds<eval_size_bounds_op<F>(X::compile_time_capacity,
                                               Y::compile_time_capacity),
@@ -218,19 +219,19 @@ auto make_size_bounds_binary_op(const X& x, const Y& y)
 }
 
 template <int A, int B, int C, int D>
-auto operator+(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
+constexpr auto operator+(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
 {
     return make_size_bounds_binary_op<std::plus<int>>(x, y);
 }
 
 template <int A, int B, int C, int D>
-auto operator-(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
+constexpr auto operator-(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
 {
     return make_size_bounds_binary_op<std::minus<int>>(x, y);
 }
 
 template <int A, int B, int C, int D>
-auto operator*(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
+constexpr auto operator*(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
 {
     return make_size_bounds_binary_op<std::multiplies<int>>(x, y);
 }
@@ -245,13 +246,13 @@ struct size_bounds_function_object_max
 };
 
 template <int A, int B, int C, int D>
-auto min(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
+constexpr auto min(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
 {
     return make_size_bounds_binary_op<size_bounds_function_object_min>(x, y);
 }
 
 template <int A, int B, int C, int D>
-auto max(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
+constexpr auto max(const size_bounds<A, B>& x, const size_bounds<C, D>& y)
 {
     return make_size_bounds_binary_op<size_bounds_function_object_max>(x, y);
 }
@@ -261,26 +262,26 @@ template <class X>
 struct is_inlinevector : std::false_type
 {};
 
-template <class T, size_t N>
+template <class T, int N>
 struct is_inlinevector<InlineVector<T, N>> : std::true_type
 {};
 
 // Return the appropriate expression describing the capacity/size
 // characteristics for a container.
 template <class T, size_t N>
-auto get_array_size_bounds(const std::array<T, N>&)
+constexpr auto get_array_size_bounds(const std::array<T, N>&)
 {
     return size_bounds_constant<N>();
 }
 
 template <class T, int N>
-auto get_inlinevector_size_bounds(const InlineVector<T, N>& x)
+constexpr auto get_inlinevector_size_bounds(const InlineVector<T, N>& x)
 {
     return inlinevector_like_size_bounds<N>(x.size());
 }
 
 template <class X>
-auto get_size_bounds(const X& x)
+constexpr auto get_size_bounds(const X& x)
 {
     if constexpr (is_std_array<X>::value)
         return get_array_size_bounds(x);
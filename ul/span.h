@@ -2,12 +2,13 @@
 
 #include <algorithm>
 #include <array>
-#include <cassert>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include <type_traits>
 #include <vector>
 
+#include "ul/check.h"
 #include "ul/type_traits.h"
 
 // minimal implementation (just what was needed) of the 1-D span concept,
@@ -29,14 +30,22 @@ public:
     span() = default;
 
     // fundamental constructor
-    span(pointer d, size_type s) : d(d), s(s) { assert(d || s == 0); }
-    span(pointer d, pointer e) : d(d), s(e - d) { assert(d <= e); }
+    span(pointer d, size_type s) : d(d), s(s) { UL_DCHECK(d || s == 0); }
+    span(pointer d, pointer e) : d(d), s(e - d) { UL_DCHECK(d <= e); }
 
     template <std::size_t N>
     constexpr span(const std::array<std::remove_const_t<T>, N>& arr)
         : d(arr.data()), s(N)
     {}
 
+    // conversion from span<U>, like span<T> -> span<const T>
+    template <typename U,
+              typename = std::enable_if_t<
+                  !std::is_same<U, T>::value &&
+                  std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr span(const span<U>& x) : d(x.data()), s(x.size())
+    {}
+
     // assignent from span
     template <typename U,
               typename = std::enable_if_t<std::is_convertible<U, T>::value>>
@@ -82,7 +91,7 @@ public:
 
     value_type& operator[](size_type x) const
     {
-        assert(0 <= x && x < s);
+        UL_DCHECK(x < s);
         return d[x];
     }
 
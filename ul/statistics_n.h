@@ -0,0 +1,302 @@
+#pragma once
+
+// Mean vector, covariance and correlation matrix of N-dimensional samples
+//
+//     ul::StatisticsN<3> s;
+//     for (const ul::AD3& x : readings)
+//         s.add(x);
+//     auto c = s.covariance();  // std::array<std::array<double, 3>, 3>
+//
+// The multivariate version of Statistics: `add` updates the weighted mean
+// and the co-moments C_ij = sum w (x_i - mean_i)(x_j - mean_j) with the
+// online (Welford/West) update, `merge` uses the pairwise (Chan) formula, so
+// both stay accurate for values far from zero.
+//
+// The batch `add`s take the samples as N columns (SoA) or as a span of
+// arrays (AoS) and process them in blocks of detail::c_statistics_n_block_size
+// samples: block means, then block co-moments around the block means, then
+// a merge. The inner loops run over the samples of a column in 4 independent
+// lanes, which the compiler vectorizes for contiguous columns. Blocks
+// containing NANs or zero weights fall back to adding their samples one by
+// one.
+//
+// Samples with a NAN component or zero weight are skipped. Weights are
+// frequency weights: `add(x, 2)` is the same as adding `x` twice.
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "ul/check.h"
+#include "ul/config.h"
+#include "ul/span.h"
+
+namespace ul {
+
+namespace detail {
+const size_t c_statistics_n_block_size = 512;
+}  // namespace detail
+
+template <size_t N>
+class StatisticsN
+{
+    static_assert(N > 0, "StatisticsN: zero dimensions.");
+
+public:
+    using Vector = std::array<double, N>;
+    using Matrix = std::array<std::array<double, N>, N>;
+
+    StatisticsN() { reset(); }
+
+    void reset()
+    {
+        count_ = 0;
+        weight_sum_ = 0;
+        mean_.fill(0);
+        for (auto& row : c)
+            row.fill(0);
+    }
+
+    void add(const Vector& x, double weight = 1)
+    {
+        UL_DCHECK(weight >= 0);
+        if (UL_UNLIKELY(!(weight > 0) || has_nan(x)))
+            return;
+        ++count_;
+        weight_sum_ += weight;
+        const double r = weight / weight_sum_;
+        Vector delta;
+        for (size_t i = 0; i < N; ++i) {
+            delta[i] = x[i] - mean_[i];
+            mean_[i] += delta[i] * r;
+        }
+        // Upper triangle, mirrored by the accessors.
+        for (size_t i = 0; i < N; ++i) {
+            const double wd = weight * delta[i];
+            for (size_t j = i; j < N; ++j)
+                c[i][j] += wd * (x[j] - mean_[j]);
+        }
+    }
+
+    // Sample k is (columns[0][k], ..., columns[N - 1][k]), with weight
+    // weights[k] or 1 if `weights` is empty.
+    void add(const std::array<span<const double>, N>& columns,
+             span<const double> weights = {})
+    {
+        const size_t n = columns[0].size();
+        std::array<const double*, N> p;
+        for (size_t i = 0; i < N; ++i) {
+            UL_CHECK(columns[i].size() == n, "Column %d has %d values, not %d.",
+                     int(i), int(columns[i].size()), int(n));
+            p[i] = columns[i].data();
+        }
+        add_blocks<1>(p, n, weights);
+    }
+
+    void add(span<const Vector> xs, span<const double> weights = {})
+    {
+        std::array<const double*, N> p;
+        for (size_t i = 0; i < N; ++i)
+            p[i] = xs.empty() ? nullptr : xs.data()->data() + i;
+        add_blocks<N>(p, xs.size(), weights);
+    }
+
+    // Adds all samples added to `x`.
+    void merge(const StatisticsN& x)
+    {
+        if (x.count_ == 0)
+            return;
+        if (count_ == 0) {
+            *this = x;
+            return;
+        }
+        const double w = weight_sum_ + x.weight_sum_;
+        const double r = x.weight_sum_ / w;
+        const double f = weight_sum_ * r;  // wa * wb / w
+        Vector delta;
+        for (size_t i = 0; i < N; ++i) {
+            delta[i] = x.mean_[i] - mean_[i];
+            mean_[i] += delta[i] * r;
+        }
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = i; j < N; ++j)
+                c[i][j] += x.c[i][j] + delta[i] * delta[j] * f;
+        }
+        count_ += x.count_;
+        weight_sum_ = w;
+    }
+
+    int count() const
+    {
+        UL_CHECK_ALWAYS(count_ <= INT_MAX);
+        return static_cast<int>(count_);
+    }
+    int64_t count64() const { return count_; }
+    double weight_sum() const { return weight_sum_; }
+
+    // NANs if empty.
+    Vector mean() const
+    {
+        Vector m = mean_;
+        if (count_ == 0)
+            m.fill(NAN);
+        return m;
+    }
+
+    // Sum of w (x_i - mean_i)(x_j - mean_j)
+    double comoment(size_t i, size_t j) const
+    {
+        UL_DCHECK(i < N && j < N);
+        return i <= j ? c[i][j] : c[j][i];
+    }
+
+    // Normalized with the sum of weights
+    Matrix covariance() const { return normalized(weight_sum_); }
+    // Normalized with the sum of weights - 1
+    Matrix covariance_sample() const { return normalized(weight_sum_ - 1); }
+
+    // Diagonal of covariance()
+    Vector var() const
+    {
+        Vector v;
+        for (size_t i = 0; i < N; ++i)
+            v[i] = count_ > 0 ? c[i][i] / weight_sum_ : NAN;
+        return v;
+    }
+
+    // Pearson correlation coefficients, NAN for dimensions with zero
+    // variance.
+    Matrix correlation() const
+    {
+        Matrix r;
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                const double d = sqrt(c[i][i] * c[j][j]);
+                r[i][j] = count_ > 0 && d > 0 ? comoment(i, j) / d : NAN;
+            }
+        }
+        return r;
+    }
+
+private:
+    static bool has_nan(const Vector& x)
+    {
+        bool nan = false;
+        for (double d : x)
+            nan |= std::isnan(d);
+        return nan;
+    }
+
+    Matrix normalized(double divisor) const
+    {
+        Matrix m;
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j)
+                m[i][j] = count_ > 0 && divisor > 0 ? comoment(i, j) / divisor
+                                                    : NAN;
+        }
+        return m;
+    }
+
+    // Component i of sample k is p[i][k * Stride].
+    template <size_t Stride>
+    void add_blocks(const std::array<const double*, N>& p,
+                    size_t n,
+                    span<const double> weights)
+    {
+        UL_CHECK(weights.empty() || weights.size() == n,
+                 "%d weights for %d samples.", int(weights.size()), int(n));
+        const double* w = weights.empty() ? nullptr : weights.data();
+        for (size_t k0 = 0; k0 < n; k0 += detail::c_statistics_n_block_size) {
+            const size_t m =
+                std::min(n - k0, detail::c_statistics_n_block_size);
+            std::array<const double*, N> q;
+            for (size_t i = 0; i < N; ++i)
+                q[i] = p[i] + k0 * Stride;
+            const double* wq = w ? w + k0 : nullptr;
+            // A NAN in the block makes its mean NAN.
+            if (UL_LIKELY(!wq || all_positive(wq, m))) {
+                auto b = block<Stride>(q, m, wq);
+                if (UL_LIKELY(!has_nan(b.mean_))) {
+                    merge(b);
+                    continue;
+                }
+            }
+            for (size_t k = 0; k < m; ++k) {
+                Vector x;
+                for (size_t i = 0; i < N; ++i)
+                    x[i] = q[i][k * Stride];
+                add(x, wq ? wq[k] : 1);
+            }
+        }
+    }
+
+    static bool all_positive(const double* w, size_t m)
+    {
+        bool positive = true;
+        for (size_t k = 0; k < m; ++k)
+            positive &= w[k] > 0;
+        return positive;
+    }
+
+    // Sum of f(0), ..., f(m - 1) in 4 independent lanes, which breaks the
+    // dependency chain of the additions and lets the compiler vectorize.
+    template <class F>
+    static double sum_lanes(size_t m, F f)
+    {
+        double a[4] = {0, 0, 0, 0};
+        size_t k = 0;
+        for (; k + 4 <= m; k += 4) {
+            a[0] += f(k);
+            a[1] += f(k + 1);
+            a[2] += f(k + 2);
+            a[3] += f(k + 3);
+        }
+        for (; k < m; ++k)
+            a[0] += f(k);
+        return (a[0] + a[1]) + (a[2] + a[3]);
+    }
+
+    // Two passes over the block: means, then co-moments around them.
+    template <size_t Stride>
+    static StatisticsN block(const std::array<const double*, N>& p,
+                             size_t m,
+                             const double* w)
+    {
+        StatisticsN s;
+        s.count_ = int64_t(m);
+        s.weight_sum_ =
+            w ? sum_lanes(m, [w](size_t k) { return w[k]; }) : double(m);
+        for (size_t i = 0; i < N; ++i) {
+            const double* x = p[i];
+            const double sum =
+                w ? sum_lanes(m,
+                              [w, x](size_t k) { return w[k] * x[k * Stride]; })
+                  : sum_lanes(m, [x](size_t k) { return x[k * Stride]; });
+            s.mean_[i] = sum / s.weight_sum_;
+        }
+        for (size_t i = 0; i < N; ++i) {
+            const double *x = p[i], mx = s.mean_[i];
+            for (size_t j = i; j < N; ++j) {
+                const double *y = p[j], my = s.mean_[j];
+                auto f = [=](size_t k) {
+                    return (x[k * Stride] - mx) * (y[k * Stride] - my);
+                };
+                s.c[i][j] =
+                    w ? sum_lanes(m, [=](size_t k) { return w[k] * f(k); })
+                      : sum_lanes(m, f);
+            }
+        }
+        return s;
+    }
+
+    int64_t count_;
+    double weight_sum_;
+    Vector mean_;
+    Matrix c;  // co-moments, upper triangle
+};
+
+}  // namespace ul
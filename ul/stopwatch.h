@@ -1,8 +1,10 @@
 #pragma once
 
-#include <cassert>
 #include <chrono>
 
+#include "ul/check.h"
+#include "ul/trace.h"
+
 namespace ul {
 
 using std::chrono::duration;
@@ -14,15 +16,45 @@ using std::chrono::high_resolution_clock;
 //     auto t0 = tic();
 //     ...
 //     elapsed += toc(t0);
+//
+// With another clock (see also clock.h):
+//
+//     auto t0 = tic<ul::tsc_clock>();
+//     ...
+//     elapsed += toc(t0);
+//
+// With a name, the section is also recorded while tracing is on (trace.h):
+//
+//     auto t0 = tic("load");
+//     ...
+//     elapsed += toc(t0, "load");
+
+template <class Clock = high_resolution_clock>
+typename Clock::time_point tic()
+{
+    return Clock::now();
+}
 
-inline high_resolution_clock::time_point tic()
+template <class Clock = high_resolution_clock>
+typename Clock::time_point tic(const char* trace_name)
 {
-    return high_resolution_clock::now();
+    trace::begin(trace_name);
+    return Clock::now();
 }
 
-inline double toc(high_resolution_clock::time_point t0)
+template <class Clock, class Duration>
+double toc(std::chrono::time_point<Clock, Duration> t0)
 {
-    return duration<double>(tic() - t0).count();
+    return duration<double>(Clock::now() - t0).count();
+}
+
+template <class Clock, class Duration>
+double toc(std::chrono::time_point<Clock, Duration> t0,
+           const char* trace_name)
+{
+    const double result = toc(t0);
+    trace::end(trace_name);
+    return result;
 }
 
 // Stopwatch for more serious measurements
@@ -37,6 +69,13 @@ inline double toc(high_resolution_clock::time_point t0)
 //     ...
 //     sw.stop();
 //     time_of_two_sections = sw.elapsed();
+//
+// Any std::chrono-compatible clock can be used, for example the cheaper
+// `Stopwatch<ul::tsc_clock>` or `Stopwatch<ul::thread_cpu_clock>` from
+// clock.h.
+//
+// A stopwatch with a `trace_name` records each running interval as a section
+// while tracing is on (trace.h). The name is not copied.
 template <class Clock = high_resolution_clock>
 class Stopwatch
 {
@@ -46,8 +85,10 @@ public:
     using duration = typename clock::duration;
     using duration_dbl = std::chrono::duration<double>;
 
-    explicit Stopwatch(bool start = false)
-        : running_since(time_point::max()), elapsed_duration(duration::zero())
+    explicit Stopwatch(bool start = false, const char* trace_name = nullptr)
+        : running_since(time_point::max()),
+          elapsed_duration(duration::zero()),
+          trace_name(trace_name)
     {
         if (start)
             this->start();
@@ -69,7 +110,8 @@ public:
     // this on a running stopwatch.
     void start()
     {
-        assert(!running());
+        UL_DCHECK(!running());
+        trace_begin();
         running_since = clock::now();
     }
 
@@ -78,7 +120,8 @@ public:
     double stop()
     {
         elapsed_duration += clock::now() - running_since;
-        assert(running());  // call check only after registering the time
+        UL_DCHECK(running());  // call check only after registering the time
+        trace_end();
         running_since = time_point::max();
         return duration_dbl(elapsed_duration).count();
     }
@@ -89,6 +132,9 @@ public:
     {
         double result = elapsed();
         elapsed_duration = duration::zero();
+        if (running())
+            trace_end();
+        trace_begin();
         running_since = clock::now();
         return result;
     }
@@ -96,13 +142,27 @@ public:
     // Zeroes out time accumulated so far. Also stops watch if running.
     void reset()
     {
+        if (running())
+            trace_end();
         elapsed_duration = duration::zero();
         running_since = time_point::max();
     }
 
 private:
+    void trace_begin()
+    {
+        if (trace_name)
+            trace::begin(trace_name);
+    }
+    void trace_end()
+    {
+        if (trace_name)
+            trace::end(trace_name);
+    }
+
     time_point running_since;
     duration elapsed_duration;
+    const char* trace_name;
 };
 
 }  // namespace ul
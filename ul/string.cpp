@@ -1,4 +1,5 @@
 #include "ul/string.h"
+#include "ul/check.h"
 #include "ul/ul.h"
 
 namespace ul {
@@ -90,7 +91,7 @@ void split(span<const char> s,
         if (m == e) {
             break;
         }
-        assert(strchr(separators, *m));
+        UL_DCHECK(strchr(separators, *m));
         b = m + 1;
     }
 }
@@ -0,0 +1,220 @@
+#include "ul/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "ul/check.h"
+
+namespace ul {
+namespace trace {
+
+namespace detail {
+
+std::atomic<bool> g_enabled{false};
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+namespace {
+
+std::atomic<int> s_max_events_per_thread{c_default_max_events_per_thread};
+int s_next_tid = 1;
+// Dropped events of the buffers freed since `start()`.
+int64_t s_freed_dropped = 0;
+
+std::mutex& buffers_mutex()
+{
+    static std::mutex m;
+    return m;
+}
+
+// Buffers of the running threads, and of the exited threads until their
+// events are dumped or cleared.
+std::vector<std::unique_ptr<ThreadBuffer>>& buffers()
+{
+    static std::vector<std::unique_ptr<ThreadBuffer>> v;
+    return v;
+}
+
+// Frees the buffers of exited threads, with the mutex held. With
+// `only_empty`, only those without events to dump.
+void free_retired_buffers(bool only_empty)
+{
+    auto& v = buffers();
+    v.erase(std::remove_if(v.begin(), v.end(),
+                           [&](const std::unique_ptr<ThreadBuffer>& b) {
+                               if (!b->retired ||
+                                   (only_empty && b->count.load() > 0))
+                                   return false;
+                               s_freed_dropped += b->dropped.load();
+                               return true;
+                           }),
+            v.end());
+}
+
+// Set when the thread's buffer has been retired. An event recorded after
+// that, from the destructor of another thread_local, gets a new buffer that
+// is never retired.
+thread_local bool t_exited = false;
+
+// Retires the thread's buffer when the thread exits.
+struct RetireOnExit
+{
+    ~RetireOnExit()
+    {
+        t_exited = true;
+        if (!t_buffer)
+            return;
+        std::lock_guard<std::mutex> lock(buffers_mutex());
+        t_buffer->retired = true;
+        t_buffer = nullptr;
+        free_retired_buffers(true);
+    }
+};
+
+void write_json_string(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s; ++s) {
+        const unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+}  // namespace
+
+ThreadBuffer* register_thread()
+{
+    if (!t_exited) {
+        static thread_local RetireOnExit retire_on_exit;
+        (void)retire_on_exit;
+    }
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    auto* b = new ThreadBuffer;
+    b->tid = s_next_tid++;
+    buffers().emplace_back(b);
+    return b;
+}
+
+bool allocate_events(ThreadBuffer* b)
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    const int capacity = s_max_events_per_thread.load();
+    if (capacity > 0) {
+        b->events.reset(new Event[capacity]);
+        b->capacity = capacity;
+    }
+    return capacity > 0;
+}
+
+int num_buffers()
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    return int(buffers().size());
+}
+
+}  // namespace detail
+
+void start(int max_events_per_thread)
+{
+    using namespace detail;
+    UL_CHECK(max_events_per_thread > 0);
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    s_max_events_per_thread = max_events_per_thread;
+    free_retired_buffers(false);
+    s_freed_dropped = 0;
+    for (auto& b : buffers()) {
+        // Reallocated on the thread's next event.
+        if (b->capacity != max_events_per_thread) {
+            b->events.reset();
+            b->capacity = 0;
+        }
+        b->count = 0;
+        b->dropped = 0;
+    }
+    tsc_clock::calibrate();
+    g_enabled = true;
+}
+
+void stop()
+{
+    detail::g_enabled = false;
+}
+
+int64_t dropped_count()
+{
+    using namespace detail;
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    int64_t result = s_freed_dropped;
+    for (auto& b : buffers())
+        result += b->dropped.load();
+    return result;
+}
+
+void set_thread_name(const std::string& name)
+{
+    using namespace detail;
+    if (!t_buffer)
+        t_buffer = register_thread();
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+    t_buffer->name = name;
+}
+
+bool dump_chrome_json(const char* path)
+{
+    using namespace detail;
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    const double us_per_tick = 1e6 / tsc_clock::ticks_per_second();
+
+    std::lock_guard<std::mutex> lock(buffers_mutex());
+
+    // Timestamps relative to the earliest event.
+    uint64_t t0 = UINT64_MAX;
+    for (auto& b : buffers()) {
+        if (b->count.load(std::memory_order_acquire) > 0)
+            t0 = std::min(t0, b->events[0].ticks);
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (auto& b : buffers()) {
+        if (!b->name.empty()) {
+            fprintf(f,
+                    "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"name\":",
+                    first ? "" : ",\n", b->tid);
+            write_json_string(f, b->name.c_str());
+            fprintf(f, "}}");
+            first = false;
+        }
+        const int n = b->count.load(std::memory_order_acquire);
+        for (int i = 0; i < n; ++i) {
+            const Event& e = b->events[i];
+            fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(f, e.name);
+            fprintf(f, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                    e.phase, double(int64_t(e.ticks - t0)) * us_per_tick,
+                    b->tid);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    const bool ok = !ferror(f);
+    if (fclose(f) != 0 || !ok)
+        return false;
+    // The events of exited threads are written, release them.
+    free_retired_buffers(false);
+    return true;
+}
+
+}  // namespace trace
+}  // namespace ul
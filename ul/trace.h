@@ -0,0 +1,159 @@
+#pragma once
+
+// Timeline recording of traced sections, exported in the Chrome trace-event
+// format (open with chrome://tracing or https://ui.perfetto.dev)
+//
+//     ul::trace::start();
+//     ...
+//     void f()
+//     {
+//         UL_TRACE_SCOPE("f");
+//         ...
+//         ul::trace::begin("phase 2");
+//         ...
+//         ul::trace::end("phase 2");
+//     }
+//     ...
+//     ul::trace::stop();
+//     ul::trace::dump_chrome_json("trace.json");
+//
+// If UL_PROFILE is defined, `UL_PROFILE_ZONE`s (profiler.h) are also recorded
+// while tracing is on.
+//
+// Named `Stopwatch`es and `tic`/`toc` pairs (stopwatch.h) are also recorded:
+//
+//     ul::Stopwatch<ul::tsc_clock> sw(true, "solve");  // begin "solve"
+//     ...
+//     sw.stop();                                       // end "solve"
+//
+// Each thread writes begin/end events, timestamped with the CPU's time-stamp
+// counter (tsc_clock in clock.h), into its own bounded buffer, without locks.
+// The buffer is allocated on the thread's first event while tracing is on.
+// When it is full, events are dropped and counted. The buffer of an exited
+// thread is freed once its events have been written by `dump_chrome_json` or
+// cleared by `start`. While tracing is off,
+// `begin`/`end` cost a relaxed load and a branch.
+//
+// Names are not copied, they must outlive the `dump_chrome_json` call (string
+// literals are fine).
+//
+// `start`, `stop` and `dump_chrome_json` are meant to be called from a single
+// control thread. `dump_chrome_json` may run while other threads are
+// recording, in that case it writes the events published so far. Don't call
+// `start` while other threads are recording.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "ul/clock.h"
+#include "ul/config.h"
+#include "ul/preproc.h"
+
+#define UL_TRACE_SCOPE(name) \
+    ::ul::trace::Scope UL_CAT(ul_trace_scope__, __COUNTER__)(name)
+
+namespace ul {
+namespace trace {
+
+const int c_default_max_events_per_thread = 1 << 20;
+
+// Clears previously recorded events and starts recording. Threads allocate
+// their buffers on their first event, max_events_per_thread * 24 bytes.
+void start(int max_events_per_thread = c_default_max_events_per_thread);
+void stop();
+
+// Writes all recorded events and frees the buffers of exited threads.
+// Returns false on I/O error, then nothing is freed.
+bool dump_chrome_json(const char* path);
+
+// Number of events dropped because of full buffers since `start()`.
+int64_t dropped_count();
+
+// Name of the calling thread in the trace. Copied.
+void set_thread_name(const std::string& name);
+
+namespace detail {
+
+extern std::atomic<bool> g_enabled;
+
+struct Event
+{
+    const char* name;
+    uint64_t ticks;
+    char phase;  // 'B' or 'E'
+};
+
+// Single writer, `count` is published with release. `events` is allocated by
+// the writer under the buffers' mutex, `capacity` is 0 until then.
+struct ThreadBuffer
+{
+    std::unique_ptr<Event[]> events;
+    int capacity = 0;
+    std::atomic<int> count{0};
+    std::atomic<int64_t> dropped{0};
+    int tid = 0;
+    std::string name;
+    bool retired = false;  // the thread has exited, under the mutex
+};
+
+extern thread_local ThreadBuffer* t_buffer;
+
+// Registers the calling thread, without allocating its events.
+ThreadBuffer* register_thread();
+// Allocates the events of the calling thread's buffer on its first event.
+// Returns false if there is no room.
+UL_COLD bool allocate_events(ThreadBuffer* b);
+// Number of buffers, including those of exited threads not freed yet.
+int num_buffers();
+
+inline void record(const char* name, char phase, uint64_t ticks)
+{
+    auto* b = t_buffer;
+    if (UL_UNLIKELY(!b))
+        b = t_buffer = register_thread();
+    const int n = b->count.load(std::memory_order_relaxed);
+    if (UL_LIKELY(n < b->capacity) ||
+        (b->capacity == 0 && allocate_events(b))) {
+        b->events[n] = Event{name, ticks, phase};
+        b->count.store(n + 1, std::memory_order_release);
+    } else {
+        b->dropped.store(b->dropped.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    }
+}
+
+}  // namespace detail
+
+inline bool enabled()
+{
+    return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+inline void begin(const char* name)
+{
+    if (enabled())
+        detail::record(name, 'B', tsc_clock::ticks());
+}
+
+inline void end(const char* name)
+{
+    if (enabled())
+        detail::record(name, 'E', tsc_clock::ticks());
+}
+
+// Records begin in the constructor, end in the destructor.
+class Scope
+{
+public:
+    explicit Scope(const char* name) : name(name) { begin(name); }
+    Scope(const Scope&) = delete;
+    ~Scope() { end(name); }
+
+private:
+    const char* const name;
+};
+
+}  // namespace trace
+}  // namespace ul
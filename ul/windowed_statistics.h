@@ -0,0 +1,213 @@
+#pragma once
+
+// Statistics of the last `window` values
+//
+//     ul::WindowedStatistics<64> latency;  // or WindowedStatistics<> (64)
+//     ... // each tick:
+//     latency.add(seconds);
+//     printf("mean %f max %f\n", latency.mean(), latency.upper());
+//
+// `add` is O(1) amortized with a fixed footprint: the values are kept in a
+// ring buffer of `window` doubles and two rings of `window` ints.
+//
+// Mean and variance slide with a Welford-style update which adds the new
+// value and removes the one leaving the window. Rounding errors of the
+// updates would accumulate forever, so mean and m2 are recomputed from the
+// ring buffer (two-pass) each time it wraps around, which costs O(window)
+// every `window` values.
+//
+// Min and max are the fronts of monotonic queues of the positions in the
+// ring buffer (max: decreasing values). A new value removes the values it
+// dominates from the back, the value leaving the window is removed from the
+// front if it's still there.
+//
+// N > 0: window fixed at compile time, storage inside the object.
+// N == 0: window passed to the constructor, storage on the heap.
+//
+// NANs are skipped. Not thread-safe.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "ul/check.h"
+#include "ul/config.h"
+#include "ul/math.h"
+
+namespace ul {
+
+template <int N = 0>
+class WindowedStatistics
+{
+    static_assert(N >= 0, "WindowedStatistics: negative window.");
+
+public:
+    explicit WindowedStatistics(int window = N) : window_(window)
+    {
+        UL_CHECK(window > 0 && (N == 0 || window == N),
+                 "Invalid window %d for WindowedStatistics<%d>.", window, N);
+        resize(values, window);
+        resize(min_queue.positions, window);
+        resize(max_queue.positions, window);
+        reset();
+    }
+
+    void reset()
+    {
+        count_ = 0;
+        pos = 0;
+        mean_ = m2_ = 0;
+        min_queue.clear();
+        max_queue.clear();
+    }
+
+    void add(double d)
+    {
+        if (UL_UNLIKELY(std::isnan(d)))
+            return;
+        if (count_ < window_) {
+            ++count_;
+            const double delta = d - mean_;
+            mean_ += delta / count_;
+            m2_ += delta * (d - mean_);
+        } else {
+            const double removed = values[pos];
+            const double old_mean = mean_;
+            mean_ += (d - removed) * inv_window();
+            m2_ += (d - removed) * (d - mean_ + removed - old_mean);
+            // `removed` is the oldest value, at the front if still queued.
+            min_queue.pop_front_if(pos, window_);
+            max_queue.pop_front_if(pos, window_);
+        }
+        values[pos] = d;
+        min_queue.push_back(values, pos, window_,
+                            [](double a, double b) { return a >= b; });
+        max_queue.push_back(values, pos, window_,
+                            [](double a, double b) { return a <= b; });
+        if (++pos == window_) {
+            pos = 0;
+            renormalize();
+        }
+    }
+
+    int window() const { return window_; }
+    // Number of values in the window, at most `window()`.
+    int count() const { return count_; }
+    bool full() const { return count_ == window_; }
+
+    double mean() const { return count_ > 0 ? mean_ : NAN; }
+    double sum() const { return mean_ * count_; }
+    double var() const  // normalized with N
+    {
+        return count_ > 0 ? std::max(0.0, m2_) / count_ : NAN;
+    }
+    double var_sample() const  // normalized with N-1
+    {
+        return count_ > 1 ? std::max(0.0, m2_) / (count_ - 1) : NAN;
+    }
+    double std() const { return sqrt(var()); }
+    double std_sample() const { return sqrt(var_sample()); }
+    double lower() const { return min_queue.front(values); }
+    double upper() const { return max_queue.front(values); }
+
+    // The statistics of the values in the window.
+    Statistics statistics() const
+    {
+        return Statistics::from_moments(count_, mean_, std::max(0.0, m2_),
+                                        lower(), upper());
+    }
+
+private:
+    template <class T>
+    using Storage = std::conditional_t<N == 0,
+                                       std::vector<T>,
+                                       std::array<T, size_t(N)>>;
+
+    template <class T>
+    static void resize(std::vector<T>& v, int n)
+    {
+        v.resize(size_t(n));
+    }
+    template <class T, size_t M>
+    static void resize(std::array<T, M>&, int)
+    {
+    }
+
+    double inv_window() const
+    {
+        return N > 0 ? 1.0 / N : 1.0 / window_;
+    }
+
+    // Called when the ring buffer wraps around.
+    void renormalize()
+    {
+        double sum = 0;
+        for (int i = 0; i < count_; ++i)
+            sum += values[i];
+        mean_ = sum / count_;
+        m2_ = 0;
+        for (int i = 0; i < count_; ++i) {
+            const double delta = values[i] - mean_;
+            m2_ += delta * delta;
+        }
+    }
+
+    // Deque of ring buffer positions in a ring of `window` ints.
+    struct MonotonicQueue
+    {
+        Storage<int> positions;
+        int head = 0, size = 0;
+
+        void clear() { head = size = 0; }
+
+        double front(const Storage<double>& values) const
+        {
+            return size > 0 ? values[positions[head]] : NAN;
+        }
+
+        void pop_front_if(int p, int window)
+        {
+            if (size > 0 && positions[head] == p) {
+                if (++head == window)
+                    head = 0;
+                --size;
+            }
+        }
+
+        // Removes the positions of the values `dominated(value, d)` by `d`
+        // from the back, then adds `p`.
+        template <class Dominated>
+        void push_back(const Storage<double>& values,
+                       int p,
+                       int window,
+                       Dominated dominated)
+        {
+            const double d = values[p];
+            while (size > 0) {
+                int back = head + size - 1;
+                if (back >= window)
+                    back -= window;
+                if (!dominated(values[positions[back]], d))
+                    break;
+                --size;
+            }
+            int tail = head + size;
+            if (tail >= window)
+                tail -= window;
+            positions[tail] = p;
+            ++size;
+        }
+    };
+
+    int window_;
+    int count_;
+    int pos;  // next position in `values`
+    double mean_, m2_;
+    Storage<double> values;
+    MonotonicQueue min_queue, max_queue;
+};
+
+}  // namespace ul